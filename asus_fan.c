@@ -12,11 +12,49 @@
 #include <linux/hwmon-sysfs.h>
 #include <linux/err.h>
 #include <linux/device.h>
+#include <linux/fs.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/platform_profile.h>
+#include <linux/pm.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/thermal.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#include <linux/workqueue.h>
 
 #include <linux/acpi.h>
 #include <linux/dmi.h>
 #include <linux/platform_device.h>
 
+#define CREATE_TRACE_POINTS
+#include "asus_fan_trace.h"
+#include "asus_fan_uapi.h"
+
+// the thermal zone uses thermal_zone_device_register_with_trips() without the
+// trip mask, older kernels only get the cooling devices
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 9, 0)
+#define ASUS_FAN_THERMAL_ZONE 1
+#endif
+
+// without a reachable platform_profile core the fans are still ours, only the
+// profile handler is left out
+#if IS_REACHABLE(CONFIG_ACPI_PLATFORM_PROFILE)
+#define ASUS_FAN_PROFILE 1
+#endif
+
 MODULE_AUTHOR("Felipe Contreras <felipe.contreras@gmail.com>");
 MODULE_AUTHOR("Markus Meissner <coder@safemailbox.de>");
 MODULE_AUTHOR("Bernd Kast <kastbernd@gmx.de>");
@@ -32,146 +70,857 @@ MODULE_LICENSE("GPL");
 #define DRIVER_NAME "asus_fan"
 #define ASUS_FAN_VERSION "#MODULE_VERSION#"
 
+// critical temperature in degree celsius, the same on all known models
 #define TEMP1_CRIT 105
+// reported as the minimal speed of each fan (fanX_min)
+#define FAN_MIN 10
 #define TEMP1_LABEL "gfx_temp"
 
+// sensor sampler interval (ms) - default and accepted range
+#define UPDATE_INTERVAL_DEFAULT 1000
+#define UPDATE_INTERVAL_MIN 100
+#define UPDATE_INTERVAL_MAX 60000
+// sampler goes idle after this many intervals without any reader
+#define SAMPLER_IDLE_INTERVALS 10
+
+// debugfs 'history' - max number of records and min sampling period (ms)
+#define HISTORY_SIZE_MAX 65536
+// debugfs 'record' - max number of records
+#define RECORD_SIZE_MAX 1048576
+#define HISTORY_INTERVAL_MIN 10
+
+// thermal zone: passive trip this many degrees below temp1_crit, polling
+// intervals in ms (passive: while above the passive trip)
+#define THERMAL_PASSIVE_OFFSET 30
+#define THERMAL_PASSIVE_DELAY 1000
+#define THERMAL_POLLING_DELAY 2000
+
+// 'asus_fan_sample.alarms' bits (temp1_crit_alarm, fanX_alarm)
+#define ALARM_TEMP_CRIT 0
+#define ALARM_FAN(fan) (1 + (fan))
+
+// pwmX_enable values
+#define FAN_MODE_AUTO 0
+#define FAN_MODE_MANUAL 1
+#define FAN_MODE_CURVE 3
+// number of pwmX_auto_pointN_{pwm,temp} points of the included controller
+#define CURVE_POINTS 5
+
+// buckets of the acpi latency histograms: bucket 0 is < 1 us, bucket i
+// covers [2^(i-1), 2^i) us and the last one everything above
+#define ACPI_HIST_BUCKETS 20
+
+// max number of (pwm, rpm) points of a calibration table
+#define CALIB_POINTS_MAX 32
+// rpm -> pwm lookup covers 0..CALIB_RPM_MAX in steps of 1 << CALIB_RPM_SHIFT
+#define CALIB_RPM_MAX 8191
+#define CALIB_RPM_SHIFT 4
+// binary 'fanX_calibration' format: header followed by 'count' points
+#define CALIB_MAGIC 0x54434641  // "AFCT"
+#define CALIB_VERSION 1
+#define CALIB_BLOB_SIZE                   \
+  (sizeof(struct asus_fan_calib_header) + \
+   CALIB_POINTS_MAX * sizeof(struct asus_fan_calib_point))
+
 struct asus_fan_driver {
   const char *name;
   struct module *owner;
 
   int (*probe)(struct platform_device *device);
+  // model data found by fan_init, handed to probe
+  const struct asus_fan_quirk *quirk;
+  // start and duration of fan_init, the probe runs asynchronously afterwards
+  ktime_t init_start;
+  s64 init_us;
 
   struct platform_driver platform_driver;
   struct platform_device *platform_device;
 };
 
+struct asus_fan_calib_header {
+  __le32 magic;
+  u8 version;
+  u8 count;
+  __le16 reserved;
+} __packed;
+
+struct asus_fan_calib_point {
+  __le16 pwm;
+  __le16 rpm;
+} __packed;
+
+// calibration table of one fan, lookup tables are built once on load
+struct asus_fan_calib {
+  int count;
+  u16 pwm[CALIB_POINTS_MAX];
+  u16 rpm[CALIB_POINTS_MAX];
+
+  u16 pwm_to_rpm[256];
+  u8 rpm_to_pwm[(CALIB_RPM_MAX >> CALIB_RPM_SHIFT) + 1];
+};
+
+// state of the calibration sweep ('calibrate' in debugfs)
+enum calib_state {
+  CALIB_IDLE,
+  CALIB_RUNNING,
+  CALIB_DONE,
+  CALIB_ABORTED,
+  CALIB_FAILED
+};
+
+// acpi methods used by the driver, resolved to handles once at load
+enum asus_fan_method {
+  METHOD_SFNV,  // set fan speed / auto-mode
+  METHOD_TACH,  // fan speed readout
+  METHOD_TH1R,  // gfx temperature readout
+  METHOD_ST98,  // max fan speed
+  METHOD_QMOD,  // quiet mode (max fan speed reset)
+  METHOD_COUNT,
+  // no method - tach register reads (ec_read), timed like one
+  LATENCY_EC = METHOD_COUNT,
+  LATENCY_COUNT
+};
+
+// tach counts of both fans in the ec (lsb, msb), see misc/calc_fan_relation.py
+#define EC_TACH_REG(fan) (0x93 + 2 * (fan))
+#define EC_TACH_RPM(raw) (0x0041CDB4 / ((raw) * 2))
+
+// steps of the probe, timed for debugfs 'init_timing'
+enum asus_fan_init_step {
+  INIT_QUEUED,   // from module_init until the probe started
+  INIT_METHODS,  // acpi namespace lookups
+  INIT_EC,       // verification call, max speed reset (trial calls on
+                 // unknown models)
+  INIT_SYSFS,    // platform attributes
+  INIT_HWMON,    // first sensor sample and hwmon registration
+  INIT_STEP_COUNT
+};
+
+// mode and speed of one fan
+struct asus_fan_state {
+  int pwm;      // last manually set speed, -1 in auto-mode
+  bool manual;  // manually controlled
+  bool curve;   // driven by the included controller (implies 'manual')
+};
+
+// snapshot of all fan speeds and the temperature, only written by the sampler
+struct asus_fan_sample {
+  int rpm[2];
+  unsigned long long temp;
+  // 'ALARM_*' bits
+  unsigned int alarms;
+};
+
+// one record of debugfs 'history' (native endianness, 32 bytes)
+struct asus_fan_history_rec {
+  u64 time_ns;    // ktime_get_ns() after the readout
+  u32 seq;        // record number, gaps show overruns
+  s32 rpm[2];     // -1: unreadable
+  s16 pwm[2];     // last manually set speed, -1 in auto-mode
+  s16 temp;       // TH1R in degree celsius, -1: unreadable
+  u16 max_speed;  // ST98
+  u8 mode[2];     // pwmX_enable
+  u8 reserved[2];
+};
+
+// read position of one opened debugfs 'history' or 'record'
+struct asus_fan_history_reader {
+  struct asus_fan *asus;
+  u64 pos;  // next record to read
+};
+
+// one fan as thermal cooling device
+struct asus_fan_cooling {
+  struct asus_fan *asus;
+  int fan;
+  struct thermal_cooling_device *cdev;
+  // level set by the thermal core, 0: the fan is not driven by it
+  unsigned long state;
+  // released by the thermal core, but kept in manual mode until the other
+  // fan can go back to auto-mode as well (under 'lock')
+  bool waiting;
+};
+
+// what is known about a model, so probe does not have to find it out
+// through trial calls - 'fans' is 0 for unknown models, which are probed
+struct asus_fan_quirk {
+  int fans;
+  // fan speeds are read from the ec registers (EC_TACH_REG) instead of TACH
+  bool tach_ec;
+};
+
+// one batch of pwm, mode and max speed requests, -1 (false): none
+struct asus_fan_write {
+  bool set_auto;
+  int pwm[2];
+  int mode[2];
+  // 256 resets the max speed
+  int max_speed;
+};
+#define WRITE_NONE \
+  { .set_auto = false, .pwm = {-1, -1}, .mode = {-1, -1}, .max_speed = -1 }
+
+// progress and result of a calibration sweep
+struct asus_fan_calib_run {
+  enum calib_state state;
+  const char *reason;
+  int fan;
+  int count;   // number of points to measure
+  int step;    // point currently measured
+  int sample;  // sample of the current point, -1: pwm not yet set
+  int rpm_sum;
+  int rpm_valid;
+  u16 pwm[CALIB_POINTS_MAX];
+  u16 rpm[CALIB_POINTS_MAX];
+};
+
 struct asus_fan {
   struct platform_device *platform_device;
+  struct device *hwmon_dev;
+  struct dentry *debugfs;
 
   struct asus_fan_driver *driver;
   struct asus_fan_driver *driver_gfx;
+
+  // model data from the dmi table
+  const struct asus_fan_quirk *quirk;
+  // 'true' - if the model has a second (gfx) fan, or it answered at probe
+  bool has_gfx_fan;
+  // 'true' - fan speeds come from the ec registers, in every mode
+  bool tach_ec;
+
+  //// acpi methods
+  // resolved handles, only valid if the method's bit is set in 'method_caps'
+  acpi_handle method_handles[METHOD_COUNT];
+  // capability mask - bit 'METHOD_*' is set if the method exists
+  unsigned long method_caps;
+  // number of namespace lookups done (once per method at probe)
+  unsigned int method_lookups;
+  // number of evaluations per method (each one saved a namespace lookup)
+  atomic_long_t method_calls[METHOD_COUNT];
+  // evaluation time per method and of the ec register reads
+  // (debugfs 'acpi_latency', resettable there)
+  atomic_long_t method_hist[LATENCY_COUNT][ACPI_HIST_BUCKETS];
+  atomic64_t method_ns[LATENCY_COUNT];
+  atomic64_t method_max_ns[LATENCY_COUNT];
+  atomic_long_t method_errors[LATENCY_COUNT];
+
+  //// fan modes and speeds
+  // serializes all ec writes (SFNV, ST98, QMOD) together with the state they
+  // change - readers never take it, so they never wait for a slow SFNV
+  struct mutex lock;
+  // lets readers copy 'state' without 'lock', only written under 'lock'
+  seqlock_t state_lock;
+  struct asus_fan_state state[2];
+  // user-defined max speed (ST98), written under 'lock'
+  int max_speed;
+
+  //// sensor sampler
+  struct asus_fan_sample sample;
+  // protects 'sample', readers never block the sampler (and vice versa)
+  seqlock_t sample_lock;
+  // sampler refresh interval in ms (hwmon 'update_interval')
+  unsigned int update_interval;
+  // jiffies of the last snapshot read, used to idle the sampler
+  unsigned long sample_last_read;
+  // bit 0 set while the sampler work is armed at 'update_interval'
+  unsigned long sampler_running;
+  struct delayed_work sampler_work;
+  // values last announced to poll()ing readers (sampler context only)
+  struct asus_fan_sample notified;
+  // 'true' while 'hwmon_dev' may be notified
+  bool notify;
+
+  //// pwm <-> rpm conversion
+  // active table per fan, swapped as a whole (rcu) on (re-)load
+  struct asus_fan_calib __rcu *calib[2];
+  // serializes calibration loads
+  struct mutex calib_lock;
+
+  //// pwm write coalescing (under 'lock')
+  // jiffies of the last SFNV call per fan
+  unsigned long pwm_last_write[2];
+  // bit 'fan' set while a coalesced write is waiting for its turn
+  unsigned long pwm_pending;
+  struct delayed_work pwm_flush_work;
+  // pwm write counters per fan (debugfs 'pwm_stats')
+  atomic_long_t pwm_received[2];
+  atomic_long_t pwm_deduplicated[2];
+  atomic_long_t pwm_coalesced[2];
+  atomic_long_t pwm_ec_writes[2];
+
+  //// pwm ramp (under 'lock')
+  // pwm last written to the ec per fan, -1 while in auto-mode
+  int pwm_applied[2];
+  // moves 'pwm_applied' towards the requested pwm, one step per tick
+  struct delayed_work pwm_ramp_work;
+
+  //// asynchronous writes of pwmX, pwmX_enable and fan1_speed_max
+  // applies the latest requests in order, off the writer's context
+  struct workqueue_struct *wq;
+  struct work_struct write_work;
+  // requests not yet applied, -1: none (under 'write_lock', never 'lock')
+  spinlock_t write_lock;
+  bool write_auto;
+  int write_pwm[2];
+  int write_mode[2];
+  // 256 resets the max speed
+  int write_max_speed;
+  // outcome of the last applied requests, 0 or -errno ('write_error')
+  int write_error;
+  // request counters (debugfs 'write_stats')
+  atomic_long_t write_queued;
+  atomic_long_t write_superseded;
+  atomic_long_t write_applied;
+  atomic_long_t write_failed;
+
+  //// included fan controller (under 'lock')
+  // curve points (temperature in millidegree celsius -> pwm) for each fan
+  int curve_temp[2][CURVE_POINTS];
+  int curve_pwm[2][CURVE_POINTS];
+  // temperature the currently applied pwm was derived from (hysteresis)
+  int curve_temp_ref[2];
+  struct delayed_work curve_work;
+
+  //// calibration sweep
+  struct asus_fan_calib_run calib_run;
+  // serializes the sweep against its debugfs control, taken before 'lock'
+  struct mutex calib_run_lock;
+  struct delayed_work calib_work;
+
+  //// suspend / resume
+  // restores the firmware state after a resume, off the resume path
+  struct work_struct resume_work;
+
+  //// load time instrumentation
+  // duration of each probe step in us
+  s64 init_us[INIT_STEP_COUNT];
+
+  //// thermal framework (NULL if not registered)
+  struct asus_fan_cooling cooling[2];
+  struct thermal_zone_device *tzd;
+#ifdef ASUS_FAN_THERMAL_ZONE
+  struct thermal_trip trips[2];
+#endif
+
+  //// manual mode watchdog
+  struct delayed_work watchdog_work;
+  // jiffies of the last user write to pwmX / pwmX_enable
+  unsigned long watchdog_refresh;
+  // jiffies a fan was first seen standing, 0: turning (watchdog work only)
+  unsigned long watchdog_stall[2];
+  // fallbacks to auto-mode and why the last one happened (debugfs 'watchdog')
+  atomic_long_t watchdog_trips;
+  const char *watchdog_reason;
+
+  //// /dev/asus_fan
+  struct miscdevice miscdev;
+  // 'true' while 'miscdev' is registered
+  bool miscdev_registered;
+  // mmap()ed values, NULL without the device
+  struct asus_fan_status_page *status_page;
+  // serializes the updates of 'status_page'
+  spinlock_t status_lock;
+  // open files, the sampler does not idle while there are any
+  atomic_t dev_users;
+
+#ifdef ASUS_FAN_PROFILE
+  //// platform profile (under 'lock')
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+  // class device of the profile core, NULL if not registered
+  struct device *profile_dev;
+#else
+  struct platform_profile_handler profile_handler;
+#endif
+  enum platform_profile_option profile;
+  // 'true' while we are registered with the profile core
+  bool profile_registered;
+#endif
+
+  //// sample history (debugfs 'history')
+  // ring of 'history_len' (power of two) records, NULL if disabled
+  struct asus_fan_history_rec *history;
+  unsigned int history_len;
+  // number of records ever written, the newest one is at 'history_head - 1'
+  u64 history_head;
+  // records overwritten before a reader got them
+  atomic_long_t history_overruns;
+  // protects 'history' and 'history_head', only held for memory copies
+  spinlock_t history_lock;
+  struct delayed_work history_work;
+
+  //// ec call recording (debugfs 'record')
+  // ring of 'record_len' (power of two) records, NULL if disabled
+  struct asus_fan_acpi_rec *record;
+  unsigned int record_len;
+  // number of records ever written, the newest one is at 'record_head - 1'
+  u64 record_head;
+  // records lost to readers too slow (all readers together)
+  atomic_long_t record_overruns;
+  // protects 'record' and 'record_head', only held for memory copies
+  spinlock_t record_lock;
 };
 
 //////
 ////// GLOBALS
 //////
 
-// 'fan_states' save last (manually) set fan state/speed
-static int fan_states[2] = {-1, -1};
-// 'fan_manual_mode' keeps whether this fan is manually controlled
-static bool fan_manual_mode[2] = {false, false};
-
-// 'true' - if current system was identified and thus a second fan is available
-static bool has_gfx_fan;
+//// acpi methods
+static const char *const method_names[LATENCY_COUNT] = {
+    [METHOD_SFNV] = "SFNV", [METHOD_TACH] = "TACH", [METHOD_TH1R] = "TH1R",
+    [METHOD_ST98] = "ST98", [METHOD_QMOD] = "QMOD", [LATENCY_EC] = "EC",
+};
+static const char *const method_paths[METHOD_COUNT] = {
+    [METHOD_SFNV] = "\\_SB.PCI0.LPCB.EC0.SFNV",
+    [METHOD_TACH] = "\\_SB.PCI0.LPCB.EC0.TACH",
+    [METHOD_TH1R] = "\\_SB.PCI0.LPCB.EC0.TH1R",
+    [METHOD_ST98] = "\\_SB.PCI0.LPCB.EC0.ST98",
+    [METHOD_QMOD] = "\\_SB.ATKD.QMOD",
+};
 
-// params struct used frequently for acpi-call-construction
-static struct acpi_object_list params;
+//// load time instrumentation
+static const char *const init_step_names[INIT_STEP_COUNT] = {
+    [INIT_QUEUED] = "queued", [INIT_METHODS] = "methods",
+    [INIT_EC] = "ec",         [INIT_SYSFS] = "sysfs",
+    [INIT_HWMON] = "hwmon",
+};
 
 // max fan speed default
 static int max_fan_speed_default = 255;
-// ... user-defined max value
-static int max_fan_speed_setting = 255;
 
-//// fan "name"
-// regular fan name
-static char *fan_desc = "CPU Fan";
-// gfx-card fan name
-static char *gfx_fan_desc = "GFX Fan";
+//// hwmon channels
+// fan labels, indexed by fan
+static const char *const fan_labels[2] = {"CPU Fan", "GFX Fan"};
+
+//// thermal framework
+static const char *const cooling_types[2] = {"asus_fan_cpu", "asus_fan_gfx"};
+
+//// supported models
+static const struct asus_fan_quirk quirk_single = {.fans = 1};
+static const struct asus_fan_quirk quirk_dual = {.fans = 2};
+// tach registers located on this one (misc/calc_fan_relation.py)
+static const struct asus_fan_quirk quirk_dual_ec = {.fans = 2, .tach_ec = true};
+// unknown models, the fans are probed
+static const struct asus_fan_quirk quirk_probe = {.fans = 0};
+
+#define ASUS_FAN_MODEL(model, quirk)                               \
+  {                                                                \
+    .ident = model,                                                \
+    .matches = {DMI_MATCH(DMI_SYS_VENDOR, "ASUSTeK COMPUTER INC."), \
+                DMI_MATCH(DMI_PRODUCT_NAME, model)},               \
+    .driver_data = (void *)&quirk                                  \
+  }
 
-// this speed will be reported as the minimal speed for the fans
-static int fan_minimum = 10;
-static int fan_minimum_gfx = 10;
+static const struct dmi_system_id asus_fan_dmi_table[] = {
+    // single fan
+    ASUS_FAN_MODEL("UX21E", quirk_single),
+    ASUS_FAN_MODEL("UX31E", quirk_single),
+    ASUS_FAN_MODEL("UX21A", quirk_single),
+    ASUS_FAN_MODEL("UX31A", quirk_single),
+    ASUS_FAN_MODEL("UX32A", quirk_single),
+    ASUS_FAN_MODEL("UX301LA", quirk_single),
+    ASUS_FAN_MODEL("UX302LA", quirk_single),
+    ASUS_FAN_MODEL("N551JK", quirk_single),
+    ASUS_FAN_MODEL("N56JN", quirk_single),
+    // two fans (nvidia)
+    ASUS_FAN_MODEL("UX32VD", quirk_dual_ec),
+    ASUS_FAN_MODEL("UX42VS", quirk_dual),
+    ASUS_FAN_MODEL("UX52VS", quirk_dual),
+    ASUS_FAN_MODEL("U500VZ", quirk_dual),
+    ASUS_FAN_MODEL("NX500", quirk_dual),
+    ASUS_FAN_MODEL("UX32LN", quirk_dual),
+    ASUS_FAN_MODEL("UX303LB", quirk_dual),
+    {}};
+MODULE_DEVICE_TABLE(dmi, asus_fan_dmi_table);
+
+static int tach_ec = -1;
+module_param(tach_ec, int, 0444);
+MODULE_PARM_DESC(tach_ec, "Read the fan speeds from the ec registers instead "
+                          "of TACH (default: -1 = per model, 0: no, 1: yes)");
+
+static bool probe_unknown;
+module_param(probe_unknown, bool, 0444);
+MODULE_PARM_DESC(probe_unknown,
+                 "Load on ASUS models missing in the dmi table and probe "
+                 "the fans through trial calls (default: false)");
+
+//// sensor sampler
+// sampler interval in ms at probe, see 'update_interval' for the runtime one
+static unsigned int update_interval = UPDATE_INTERVAL_DEFAULT;
+module_param(update_interval, uint, 0444);
+MODULE_PARM_DESC(update_interval,
+                 "Sensor sampling interval in ms (default: 1000)");
+
+//// change notification (poll() on the hwmon attributes)
+// sampler interval in ms while nobody reads, so changes are still noticed
+static unsigned int notify_interval = 5000;
+module_param(notify_interval, uint, 0444);
+MODULE_PARM_DESC(notify_interval,
+                 "Sensor sampling interval in ms without readers, to notify "
+                 "poll()ing ones (default: 5000, 0 disables)");
+static unsigned int notify_temp_delta = 2000;
+module_param(notify_temp_delta, uint, 0644);
+MODULE_PARM_DESC(notify_temp_delta,
+                 "Notify temp1_input after it changed by this many "
+                 "millidegree celsius (default: 2000, 0 disables)");
+static unsigned int notify_rpm_delta = 200;
+module_param(notify_rpm_delta, uint, 0644);
+MODULE_PARM_DESC(notify_rpm_delta,
+                 "Notify fanX_input after it changed by this many rpm "
+                 "(default: 200, 0 disables)");
+
+//// thermal framework
+static bool thermal = true;
+module_param(thermal, bool, 0444);
+MODULE_PARM_DESC(thermal,
+                 "Register the fans as thermal cooling devices and TH1R as "
+                 "thermal zone (default: true)");
+static unsigned int cooling_levels = 10;
+module_param(cooling_levels, uint, 0444);
+MODULE_PARM_DESC(cooling_levels,
+                 "Number of cooling states per fan, spread evenly over the "
+                 "pwm range (1-255, default: 10)");
+static bool thermal_crit;
+module_param(thermal_crit, bool, 0444);
+MODULE_PARM_DESC(thermal_crit,
+                 "Make temp1_crit a critical trip, the thermal core shuts "
+                 "the machine down once it is reached (default: false, a "
+                 "hot trip)");
+
+//// sample history
+static unsigned int history_size;
+module_param(history_size, uint, 0444);
+MODULE_PARM_DESC(history_size,
+                 "Number of records kept in debugfs 'history', rounded up to "
+                 "a power of two (max: 65536, default: 0 = disabled)");
+static unsigned int history_interval = 100;
+module_param(history_interval, uint, 0644);
+MODULE_PARM_DESC(history_interval,
+                 "Sampling period of debugfs 'history' in ms (min: 10, "
+                 "default: 100)");
+
+//// ec call recording
+static unsigned int record_size;
+module_param(record_size, uint, 0444);
+MODULE_PARM_DESC(record_size,
+                 "Number of ec calls kept in debugfs 'record', rounded up to "
+                 "a power of two (max: 1048576, default: 0 = disabled)");
+
+//// pwm <-> rpm conversion
+// default calibration, measured on a UX32VD:
+// => heat up the notebook
+// => reduce maximum fan speed
+// => rpms are still updated and you know the pwm value => Mapping Table
+// (255 is extrapolated, as the fan can not be capped to that)
+static const u16 calib_default_pwm[] = {0,   40,  45,  50,  60,  70,
+                                        80,  90,  100, 110, 120, 130,
+                                        140, 150, 160, 170, 180, 190,
+                                        255};
+static const u16 calib_default_rpm[] = {0,    790,  950,  1110, 1410, 1660,
+                                        1890, 2090, 2290, 2470, 2640, 2800,
+                                        2960, 3110, 3240, 3370, 3500, 3640,
+                                        3910};
+// shared by all fans without a table of their own
+static struct asus_fan_calib calib_default;
+
+//// pwm write coalescing
+// ec writes closer than this (ms) are coalesced, the last written pwm wins
+static unsigned int pwm_min_interval = 100;
+module_param(pwm_min_interval, uint, 0644);
+MODULE_PARM_DESC(pwm_min_interval,
+                 "Minimum interval between two SFNV calls per fan in ms, "
+                 "writes in between are coalesced (default: 100, 0: off)");
+
+//// pwm ramp
+// manually set speeds are approached by at most 'pwm_ramp_step' per tick
+static unsigned int pwm_ramp_step;
+module_param(pwm_ramp_step, uint, 0644);
+MODULE_PARM_DESC(pwm_ramp_step,
+                 "Max pwm change per ramp tick (default: 0, written at once)");
+static unsigned int pwm_ramp_interval = 200;
+module_param(pwm_ramp_interval, uint, 0644);
+MODULE_PARM_DESC(pwm_ramp_interval, "Ramp tick in ms (default: 200)");
+static unsigned int pwm_deadband;
+module_param(pwm_deadband, uint, 0644);
+MODULE_PARM_DESC(pwm_deadband,
+                 "While ramping, pwm changes up to this are not written to "
+                 "the ec at all (default: 0)");
+
+//// asynchronous writes
+// 'true': writes block until the ec took them, as they always used to
+static bool sync_writes;
+module_param(sync_writes, bool, 0644);
+MODULE_PARM_DESC(sync_writes,
+                 "Apply pwm, mode and max speed writes before returning "
+                 "(default: false, queued)");
+
+//// calibration sweep
+static unsigned int calib_step = 16;
+module_param(calib_step, uint, 0644);
+MODULE_PARM_DESC(calib_step, "Calibration sweep pwm step (default: 16)");
+
+static unsigned int calib_settle_ms = 3000;
+module_param(calib_settle_ms, uint, 0644);
+MODULE_PARM_DESC(calib_settle_ms,
+                 "Calibration settle time after each pwm step in ms "
+                 "(default: 3000)");
+
+static unsigned int calib_samples = 5;
+module_param(calib_samples, uint, 0644);
+MODULE_PARM_DESC(calib_samples,
+                 "Calibration rpm samples per pwm step (default: 5)");
+
+static unsigned int calib_temp_margin = 15;
+module_param(calib_temp_margin, uint, 0644);
+MODULE_PARM_DESC(calib_temp_margin,
+                 "Abort calibration this many degree celsius below the "
+                 "critical temperature (default: 15)");
+
+//// included fan controller
+// default curve points (temperature in millidegree celsius -> pwm)
+static const int curve_temp_default[CURVE_POINTS] = {40000, 50000, 60000,
+                                                     70000, 80000};
+static const int curve_pwm_default[CURVE_POINTS] = {50, 80, 120, 180, 255};
+
+static unsigned int curve_interval = 1000;
+module_param(curve_interval, uint, 0644);
+MODULE_PARM_DESC(curve_interval,
+                 "Included fan controller period in ms (default: 1000)");
+
+static unsigned int curve_hysteresis = 3;
+module_param(curve_hysteresis, uint, 0644);
+MODULE_PARM_DESC(curve_hysteresis,
+                 "Temperature drop in degree celsius before the included "
+                 "fan controller lowers the speed (default: 3)");
+
+//// manual mode watchdog
+static unsigned int watchdog_interval = 500;
+module_param(watchdog_interval, uint, 0644);
+MODULE_PARM_DESC(watchdog_interval,
+                 "Check interval in ms while any fan is in manual mode "
+                 "(default: 500, 0: off)");
+static unsigned int watchdog_temp_margin = 5;
+module_param(watchdog_temp_margin, uint, 0644);
+MODULE_PARM_DESC(watchdog_temp_margin,
+                 "Back to auto-mode this many degree celsius below the "
+                 "critical temperature (default: 5)");
+static unsigned int watchdog_stall_ms = 3000;
+module_param(watchdog_stall_ms, uint, 0644);
+MODULE_PARM_DESC(watchdog_stall_ms,
+                 "Back to auto-mode once a fan stands still this long in ms "
+                 "despite its pwm, ec tach only (default: 3000, 0: off)");
+static unsigned int watchdog_timeout;
+module_param(watchdog_timeout, uint, 0644);
+MODULE_PARM_DESC(watchdog_timeout,
+                 "Back to auto-mode if pwmX/pwmX_enable were not written "
+                 "for this long in ms (default: 0, off)");
+
+//// /dev/asus_fan
+static bool chardev = true;
+module_param(chardev, bool, 0444);
+MODULE_PARM_DESC(chardev, "Create /dev/asus_fan (default: true)");
+
+//// platform profile
+static bool platform_profile = true;
+module_param(platform_profile, bool, 0444);
+MODULE_PARM_DESC(platform_profile,
+                 "Register as the platform_profile handler (default: true)");
+static unsigned int profile_quiet_max = 160;
+module_param(profile_quiet_max, uint, 0644);
+MODULE_PARM_DESC(profile_quiet_max,
+                 "Max fan speed of the quiet profile (default: 160)");
+static unsigned int profile_balanced_max = 255;
+module_param(profile_balanced_max, uint, 0644);
+MODULE_PARM_DESC(profile_balanced_max,
+                 "Max fan speed of the balanced profile (default: 255), "
+                 "performance always resets it to the firmware's default");
+static bool profile_curves = true;
+module_param(profile_curves, bool, 0644);
+MODULE_PARM_DESC(profile_curves,
+                 "Switching the profile also replaces the curve points of "
+                 "the included fan controller (default: true)");
+
+#ifdef ASUS_FAN_PROFILE
+// curve points per profile, balanced is the default curve
+static const int profile_curve_temp[][CURVE_POINTS] = {
+    [PLATFORM_PROFILE_QUIET] = {45000, 55000, 65000, 75000, 85000},
+    [PLATFORM_PROFILE_BALANCED] = {40000, 50000, 60000, 70000, 80000},
+    [PLATFORM_PROFILE_PERFORMANCE] = {35000, 45000, 55000, 65000, 75000},
+};
+static const int profile_curve_pwm[][CURVE_POINTS] = {
+    [PLATFORM_PROFILE_QUIET] = {30, 50, 80, 140, 255},
+    [PLATFORM_PROFILE_BALANCED] = {50, 80, 120, 180, 255},
+    [PLATFORM_PROFILE_PERFORMANCE] = {80, 120, 170, 220, 255},
+};
+#endif
 
 static struct asus_fan_driver asus_fan_driver = {
     .name = DRIVER_NAME, .owner = THIS_MODULE,
 };
 bool used;
 
-static struct attribute *platform_attributes[] = {NULL};
-static struct attribute_group platform_attribute_group = {
-    .attrs = platform_attributes};
-
 //////
 ////// FUNCTION PROTOTYPES
 //////
 
 // hidden fan api funcs used for both (wrap into them)
-static int __fan_get_cur_state(int fan, unsigned long *state);
-static int __fan_set_cur_state(int fan, unsigned long state);
-
-// get current mode (auto, manual, perhaps auto mode of module in future)
-static int __fan_get_cur_control_state(int fan, int *state);
-// switch between modes (auto, manual, perhaps auto mode of module in future)
-static int __fan_set_cur_control_state(int fan, int state);
-
-// regular fan api funcs
-static ssize_t fan_get_cur_state(struct device *dev,
-                                 struct device_attribute *attr, char *buf);
-static ssize_t fan_set_cur_state(struct device *dev,
-                                 struct device_attribute *attr, const char *buf,
-                                 size_t count);
-
-// gfx fan api funcs
-static ssize_t fan_get_cur_state_gfx(struct device *dev,
-                                     struct device_attribute *attr, char *buf);
-static ssize_t fan_set_cur_state_gfx(struct device *dev,
+// - the setters expect 'asus->lock' to be held, the getters never block on it
+static int __fan_get_cur_state(struct asus_fan *asus, int fan,
+                               unsigned long *state);
+// 'curve': set by the included controller, which keeps running afterwards
+static int __fan_set_cur_state(struct asus_fan *asus, int fan,
+                               unsigned long state, bool curve);
+// straight to the ec, past ramp and coalescing ('sync_writes')
+static int __fan_set_cur_state_now(struct asus_fan *asus, int fan,
+                                   unsigned long state);
+
+// get current mode (auto, manual, included controller)
+static int __fan_get_cur_control_state(struct asus_fan *asus, int fan,
+                                       int *state);
+// switch between modes (auto, manual, included controller)
+static int __fan_set_cur_control_state(struct asus_fan *asus, int fan,
+                                       int state);
+
+// consistent copy of the mode and speed of 'fan', lockless
+static void fan_state_get(struct asus_fan *asus, int fan,
+                          struct asus_fan_state *st);
+// change the mode and speed of 'fan' (caller holds 'asus->lock')
+static void fan_state_set(struct asus_fan *asus, int fan, int pwm, bool manual,
+                          bool curve);
+
+// linear interpolation of 'x' over the points (xs, ys), xs ascending
+static int calib_interp(int x, const u16 *xs, const u16 *ys, int count);
+// fill the lookup tables from the points of 'calib'
+static void calib_build(struct asus_fan_calib *calib);
+// validate and activate a new calibration table for 'fan'
+static int calib_load(struct asus_fan *asus, int fan, const u16 *pwm,
+                      const u16 *rpm, int count);
+// table lookups, O(1)
+static int calib_pwm_to_rpm(struct asus_fan *asus, int fan, int pwm);
+static int calib_rpm_to_pwm(struct asus_fan *asus, int fan, int rpm);
+
+// binary 'fanX_calibration' attribute (attr->private: fan index)
+static ssize_t calib_read(struct file *filp, struct kobject *kobj,
+                          struct bin_attribute *attr, char *buf, loff_t off,
+                          size_t count);
+static ssize_t calib_write(struct file *filp, struct kobject *kobj,
+                           struct bin_attribute *attr, char *buf, loff_t off,
+                           size_t count);
+
+// start a calibration sweep of 'fan' / abort the running one
+static int calib_sweep_start(struct asus_fan *asus, int fan);
+static void calib_sweep_abort(struct asus_fan *asus, const char *reason);
+// one step of the sweep: set pwm, settle, sample tach, next pwm
+static void calib_work_fn(struct work_struct *work);
+
+// pwm for the temperature 'temp' (millidegree) from the curve of 'fan'
+static int curve_eval(struct asus_fan *asus, int fan, int temp);
+// included fan controller, re-arms itself while any fan is in curve mode
+static void curve_work_fn(struct work_struct *work);
+
+// curve point api funcs (nr: fan, index: point)
+static ssize_t curve_point_pwm_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf);
+static ssize_t curve_point_pwm_store(struct device *dev,
                                      struct device_attribute *attr,
                                      const char *buf, size_t count);
-
-// regular fan api funcs
-static ssize_t fan_get_cur_control_state(struct device *dev,
-                                         struct device_attribute *attr,
-                                         char *buf);
-static ssize_t fan_set_cur_control_state(struct device *dev,
-                                         struct device_attribute *attr,
-                                         const char *buf, size_t count);
-
-// gfx fan api funcs
-static ssize_t fan_get_cur_control_state_gfx(struct device *dev,
-                                             struct device_attribute *attr,
-                                             char *buf);
-static ssize_t fan_set_cur_control_state_gfx(struct device *dev,
-                                             struct device_attribute *attr,
-                                             const char *buf, size_t count);
+static ssize_t curve_point_temp_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf);
+static ssize_t curve_point_temp_store(struct device *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count);
 
 // generic fan func (no sense as long as auto-mode is bound to both or none of
 // the fans...
 // - force 'reset' of max-speed (if reset == true) and change to auto-mode
-static int fan_set_max_speed(unsigned long state, bool reset);
+static int fan_set_max_speed(struct asus_fan *asus, unsigned long state,
+                             bool reset);
+static int __fan_set_max_speed(struct asus_fan *asus, unsigned long state,
+                               bool reset);
 // acpi-readout
-static int fan_get_max_speed(unsigned long *state);
+static int fan_get_max_speed(struct asus_fan *asus, unsigned long *state);
 
-// set fan(s) to automatic mode
-static int fan_set_auto(void);
+// set fan(s) to automatic mode, __fan_set_auto() with 'asus->lock' held
+static int fan_set_auto(struct asus_fan *asus);
+static int __fan_set_auto(struct asus_fan *asus);
 
 // set fan with index 'fan' to 'speed'
 // - includes manual mode activation
-static int fan_set_speed(int fan, int speed);
+static int fan_set_speed(struct asus_fan *asus, int fan, int speed);
+// fan_set_speed() plus write accounting for the coalescing
+static int __fan_apply_speed(struct asus_fan *asus, int fan, int speed);
+// writes coalesced pwm values, once their minimum interval passed
+static void pwm_flush_work_fn(struct work_struct *work);
+// 'true' if a new pwm of 'fan' is ramped to instead of written at once
+static bool pwm_ramp_active(struct asus_fan *asus, int fan);
+// one ramp step of each manual fan, re-arms itself until all are there
+static void pwm_ramp_work_fn(struct work_struct *work);
+// pwm the fan really runs at (pwmX_applied, nr: fan)
+static ssize_t pwm_applied_show(struct device *dev,
+                                struct device_attribute *attr, char *buf);
+
+// record a user request, then queue it - with 'sync_writes' it is applied
+// alone once the queue is empty, so the writer only gets its own error
+static int write_submit(struct asus_fan *asus,
+                        const struct asus_fan_write *req);
+static int write_request_pwm(struct asus_fan *asus, int fan, int pwm);
+// one request for several fans ('pwm' < 0: unchanged)
+static int write_request_pwms(struct asus_fan *asus, const int *pwm);
+static int write_request_mode(struct asus_fan *asus, int fan, int mode);
+static int write_request_max_speed(struct asus_fan *asus, int max_speed);
+// apply all queued requests to the ec, returns the first error
+static int write_apply(struct asus_fan *asus);
+// apply one batch to the ec, returns its first error - 'sync': the pwm
+// reaches the ec before this returns, no ramp and no coalescing
+static int write_apply_batch(struct asus_fan *asus,
+                             const struct asus_fan_write *req, bool sync);
+static void write_work_fn(struct work_struct *work);
+// error of the last applied requests (write_error)
+static ssize_t write_error_show(struct device *dev,
+                                struct device_attribute *attr, char *buf);
+
+// resolve all acpi methods into handles and fill 'method_caps'
+static void asus_fan_resolve_methods(struct asus_fan *asus);
+// evaluate a resolved acpi method, fails with AE_NOT_FOUND if unavailable
+static acpi_status asus_fan_eval(struct asus_fan *asus,
+                                 enum asus_fan_method method,
+                                 struct acpi_object_list *args,
+                                 unsigned long long *value);
+// account one evaluation in the latency statistics
+static void asus_fan_eval_account(struct asus_fan *asus,
+                                  enum asus_fan_method method, u64 ns,
+                                  acpi_status status);
+// find the fans and bring them into a sane state (auto-mode)
+static int asus_fan_hw_init(struct asus_fan *asus);
+// pick the fan speed readout (TACH or ec registers), after the fans are known
+static void asus_fan_tach_ec_init(struct asus_fan *asus);
 
 // reports current speed of the fan (unit:RPM)
-static int __fan_rpm(int fan);
-
-// Writes RPMs of fan0 (CPU fan) to buf => needed for hwmon device
-static ssize_t fan_rpm(struct device *dev, struct device_attribute *attr,
-                       char *buf);
-
-// Writes RPMs of fan1 (GPU fan) to buf => needed for hwmon device
-static ssize_t fan_rpm_gfx(struct device *dev, struct device_attribute *attr,
-                           char *buf);
-// Writes Label of fan0 (CPU fan) to buf => needed for hwmon device
-static ssize_t fan_label(struct device *dev, struct device_attribute *attr,
-                         char *buf);
-
-// Writes Label of fan1 (GPU fan) to buf => needed for hwmon device
-static ssize_t fan_label_gfx(struct device *dev, struct device_attribute *attr,
-                             char *buf);
-// Writes Minimal speed of fan0 (CPU fan) to buf => needed for hwmon device
-static ssize_t fan_min(struct device *dev, struct device_attribute *attr,
-                       char *buf);
-
-// Writes Minimal speed of fan1 (GPU fan) to buf => needed for hwmon device
-static ssize_t fan_min_gfx(struct device *dev, struct device_attribute *attr,
-                           char *buf);
+static int __fan_rpm(struct asus_fan *asus, int fan);
+// readout of the fan speed, TACH does not report in manual mode
+static int __fan_tach(struct asus_fan *asus, int fan, int *rpm);
+// readout of the tach registers, reports in all modes without any aml
+static int __fan_tach_ec(struct asus_fan *asus, int fan, int *rpm);
+
+// acpi-readout of the temperature (unit: degree celsius)
+static int __temp1_read(struct asus_fan *asus, unsigned long long *temp);
+
+// refresh the sensor snapshot from acpi (sampler context only)
+static void sample_refresh(struct asus_fan *asus);
+// sysfs_notify() the attributes that changed noticeably since the last call
+static void sample_notify(struct asus_fan *asus,
+                          const struct asus_fan_sample *s);
+// copy the sensor snapshot, (re)starts the sampler if it was idle - never
+// blocks, the first read after idling gets the last (old) sample
+static void sample_get(struct asus_fan *asus, struct asus_fan_sample *s);
+// copy the sensor snapshot as it is, without counting as a reader
+static void sample_peek(struct asus_fan *asus, struct asus_fan_sample *s);
+// periodic sampler, re-arms itself until nobody reads anymore - then only
+// every sampler_idle_interval() ms
+static void sampler_work_fn(struct work_struct *work);
+// 'notify_interval', or the zone's polling delay if only the thermal zone
+// needs the idle sampler, 0: none
+static unsigned int sampler_idle_interval(struct asus_fan *asus);
 
 // sets maximal speed for auto and manual mode => needed for hwmon device
 static ssize_t set_max_speed(struct device *dev, struct device_attribute *attr,
@@ -182,19 +931,23 @@ static ssize_t set_max_speed(struct device *dev, struct device_attribute *attr,
 static ssize_t get_max_speed(struct device *dev, struct device_attribute *attr,
                              char *buf);
 
-// GFX temperature
-static ssize_t temp1_input(struct device *dev, struct device_attribute *attr,
-                           char *buf);
-// GFX label
-static ssize_t temp1_crit(struct device *dev, struct device_attribute *attr,
-                           char *buf);
-// GFX crit
-static ssize_t temp1_label(struct device *dev, struct device_attribute *attr,
-                           char *buf);
-
-// is the hwmon interface visible?
-static umode_t asus_hwmon_sysfs_is_visible(struct kobject *kobj,
-                                           struct attribute *attr, int idx);
+// hwmon core callbacks, one dispatcher for all channels
+static umode_t asus_fan_hwmon_is_visible(const void *data,
+                                         enum hwmon_sensor_types type,
+                                         u32 attr, int channel);
+static int asus_fan_hwmon_read(struct device *dev,
+                               enum hwmon_sensor_types type, u32 attr,
+                               int channel, long *val);
+static int asus_fan_hwmon_read_string(struct device *dev,
+                                      enum hwmon_sensor_types type, u32 attr,
+                                      int channel, const char **str);
+static int asus_fan_hwmon_write(struct device *dev,
+                                enum hwmon_sensor_types type, u32 attr,
+                                int channel, long val);
+
+// are the non-standard hwmon attributes (max speed, curve) visible?
+static umode_t asus_fan_extra_is_visible(struct kobject *kobj,
+                                         struct attribute *attr, int idx);
 
 // initialization of hwmon interface
 static int asus_fan_hwmon_init(struct asus_fan *asus);
@@ -202,13 +955,111 @@ static int asus_fan_hwmon_init(struct asus_fan *asus);
 // remove "asus_fan" subfolder from /sys/devices/platform
 static void asus_fan_sysfs_exit(struct platform_device *device);
 
+// thermal cooling device callbacks (devdata: struct asus_fan_cooling)
+static int asus_fan_cooling_get_max_state(struct thermal_cooling_device *cdev,
+                                          unsigned long *state);
+static int asus_fan_cooling_get_cur_state(struct thermal_cooling_device *cdev,
+                                          unsigned long *state);
+static int asus_fan_cooling_set_cur_state(struct thermal_cooling_device *cdev,
+                                          unsigned long state);
+#ifdef ASUS_FAN_THERMAL_ZONE
+// thermal zone callbacks (TH1R)
+static int asus_fan_tz_get_temp(struct thermal_zone_device *tz, int *temp);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+static bool asus_fan_tz_should_bind(struct thermal_zone_device *tz,
+                                    const struct thermal_trip *trip,
+                                    struct thermal_cooling_device *cdev,
+                                    struct cooling_spec *c);
+#else
+static int asus_fan_tz_bind(struct thermal_zone_device *tz,
+                            struct thermal_cooling_device *cdev);
+static int asus_fan_tz_unbind(struct thermal_zone_device *tz,
+                              struct thermal_cooling_device *cdev);
+#endif
+#endif
+// register/unregister the cooling devices and the thermal zone
+static void asus_fan_thermal_init(struct asus_fan *asus);
+static void asus_fan_thermal_exit(struct asus_fan *asus);
+
+// (re-)start the watchdog, which runs as long as any fan is manual
+static void watchdog_arm(struct asus_fan *asus);
+// temperature, stall and refresh checks, falls back to auto-mode
+static void watchdog_work_fn(struct work_struct *work);
+
+// all values for ASUS_FAN_IOC_STATUS / the status page, from the snapshot 's'
+static void status_fill(struct asus_fan *asus,
+                        const struct asus_fan_sample *s,
+                        struct asus_fan_status *out);
+// refresh the mmap()ed status page (any context but irq)
+static void status_page_update(struct asus_fan *asus);
+// /dev/asus_fan file operations
+static int asus_fan_dev_open(struct inode *inode, struct file *file);
+static int asus_fan_dev_release(struct inode *inode, struct file *file);
+static long asus_fan_dev_ioctl(struct file *file, unsigned int cmd,
+                               unsigned long arg);
+static int asus_fan_dev_mmap(struct file *file, struct vm_area_struct *vma);
+// register/deregister /dev/asus_fan, failing only costs the device
+static void asus_fan_dev_init(struct asus_fan *asus);
+static void asus_fan_dev_exit(struct asus_fan *asus);
+
+// register as the platform_profile handler (if enabled and possible)
+static void asus_fan_profile_init(struct asus_fan *asus);
+static void asus_fan_profile_exit(struct asus_fan *asus);
+#ifdef ASUS_FAN_PROFILE
+// a profile switch sets max speed and curve in one go
+static int __profile_set(struct asus_fan *asus,
+                         enum platform_profile_option profile);
+// platform_profile callbacks (the ops of 6.14 or the handler before)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+static int profile_probe(void *drvdata, unsigned long *choices);
+static int profile_get(struct device *dev,
+                       enum platform_profile_option *profile);
+static int profile_set(struct device *dev,
+                       enum platform_profile_option profile);
+#else
+static int profile_get(struct platform_profile_handler *pprof,
+                       enum platform_profile_option *profile);
+static int profile_set(struct platform_profile_handler *pprof,
+                       enum platform_profile_option profile);
+#endif
+#endif
+
+// allocate the sample history and start filling it (if enabled)
+static void asus_fan_history_init(struct asus_fan *asus);
+// allocate the ec call recording (if enabled), before the first call
+static void asus_fan_record_init(struct asus_fan *asus);
+// append one ec call to the recording (any context but irq)
+static void record_call(struct asus_fan *asus, enum asus_fan_method method,
+                        int nargs, const u64 *arg, acpi_status status,
+                        u64 result, u64 start, u64 ns);
+// append one record to the sample history, re-arms itself
+static void history_work_fn(struct work_struct *work);
+
+// create/remove the "asus_fan" debugfs directory
+static void asus_fan_debugfs_init(struct asus_fan *asus);
+static void asus_fan_debugfs_exit(struct asus_fan *asus);
+
+// time one probe step, 't' is advanced to now
+static void asus_fan_init_step(struct asus_fan *asus,
+                               enum asus_fan_init_step step, ktime_t *t);
+
 // set up platform device and call hwmon init
 static int asus_fan_probe(struct platform_device *pdev);
 
 // do anything needed to remove platform device
-static int asus_fan_remove(struct platform_device *device);
-
-// prepare platform device and let it create
+static void asus_fan_remove(struct platform_device *device);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 11, 0)
+// the same, for the int returning callback of older kernels
+static int asus_fan_remove_legacy(struct platform_device *device);
+#endif
+
+// stop everything that calls into the ec / queue the replay of the state
+static int asus_fan_suspend(struct device *dev);
+static int asus_fan_resume(struct device *dev);
+// write mode, pwm and max speed back to the firmware (after a resume)
+static void resume_work_fn(struct work_struct *work);
+
+// register the (asynchronously probed) driver and its platform device
 int __init_or_module asus_fan_register_driver(struct asus_fan_driver *driver);
 
 // remove the driver
@@ -218,226 +1069,1918 @@ void asus_fan_unregister_driver(struct asus_fan_driver *driver);
 static void __exit fan_exit(void);
 static int __init fan_init(void);
 
-//////
-////// IMPLEMENTATIONS
-//////
-static int __fan_get_cur_state(int fan, unsigned long *state) {
-
-  /* very nasty, but (by now) the only idea I had to calculate the pwm value
-from the measured pwms
-   * => heat up the notebook
-   * => reduce maxumum fan speed
-   * => rpms are still updated and you know the pwm value => Mapping Table
-   * => do a regression
-   * => =RPM*RPM*0,0000095+0,01028*RPM+26,5
-RPMs	PWM
-3640	190
-3500	180
-3370	170
-3240	160
-3110	150
-2960	140
-2800	130
-2640	120
-2470	110
-2290	100
-2090	90
-1890	80
-1660	70
-1410	60
-1110	50
-950	45
-790	40
-*/
-  int rpm = __fan_rpm(fan);
-
-  if (fan_manual_mode[fan]) {
-    *state = fan_states[fan];
-  } else {
-    if (rpm == 0) {
-      *state = 0;
-      return 0;
+//////
+////// IMPLEMENTATIONS
+//////
+static void fan_state_get(struct asus_fan *asus, int fan,
+                          struct asus_fan_state *st) {
+  unsigned int seq;
+
+  do {
+    seq = read_seqbegin(&asus->state_lock);
+    *st = asus->state[fan];
+  } while (read_seqretry(&asus->state_lock, seq));
+}
+
+static void fan_state_set(struct asus_fan *asus, int fan, int pwm, bool manual,
+                          bool curve) {
+  lockdep_assert_held(&asus->lock);
+
+  write_seqlock(&asus->state_lock);
+  asus->state[fan].pwm = pwm;
+  asus->state[fan].manual = manual;
+  asus->state[fan].curve = curve;
+  write_sequnlock(&asus->state_lock);
+  status_page_update(asus);
+  if (manual)
+    watchdog_arm(asus);
+}
+
+static int __fan_get_cur_state(struct asus_fan *asus, int fan,
+                               unsigned long *state) {
+  struct asus_fan_sample s;
+  struct asus_fan_state st;
+
+  fan_state_get(asus, fan, &st);
+  if (st.manual) {
+    *state = st.pwm;
+  } else {
+    // there is no pwm readout, so map the measured rpms back to a pwm
+    // using the calibration table of this fan
+    sample_get(asus, &s);
+    *state = calib_rpm_to_pwm(asus, fan, s.rpm[fan]);
+  }
+  return 0;
+}
+
+static int __fan_set_cur_state(struct asus_fan *asus, int fan,
+                               unsigned long state, bool curve) {
+  struct asus_fan_state st;
+  unsigned long interval;
+
+  lockdep_assert_held(&asus->lock);
+
+  // catch illegal state set
+  if (state > 255) {
+    printk(KERN_INFO "asus-fan (set pwm%d) - illegal value provided: %d \n",
+           fan, (unsigned int) state);
+    return 1;
+  }
+  atomic_long_inc(&asus->pwm_received[fan]);
+
+  // nothing changes (or is already queued), do not bother the ec - the
+  // request is not enough, after a failed write the same value is the retry
+  // (and restarts a ramp that stopped at a failed step)
+  fan_state_get(asus, fan, &st);
+  if (st.manual && st.pwm == state &&
+      (asus->pwm_applied[fan] == (int)state ||
+       test_bit(fan, &asus->pwm_pending))) {
+    atomic_long_inc(&asus->pwm_deduplicated[fan]);
+    if (st.curve != curve)
+      fan_state_set(asus, fan, state, true, curve);
+    return 0;
+  }
+
+  fan_state_set(asus, fan, state, true, curve);
+
+  // the ramp gets there on its own, at the latest one tick after the last step
+  if (pwm_ramp_active(asus, fan)) {
+    interval = msecs_to_jiffies(max(READ_ONCE(pwm_ramp_interval), 1U));
+    if (time_before(jiffies, asus->pwm_last_write[fan] + interval))
+      interval = asus->pwm_last_write[fan] + interval - jiffies;
+    else
+      interval = 0;
+    schedule_delayed_work(&asus->pwm_ramp_work, interval);
+    return 0;
+  }
+
+  // too close to the last write, queue it - a later write replaces it
+  interval = msecs_to_jiffies(READ_ONCE(pwm_min_interval));
+  if (interval &&
+      (test_bit(fan, &asus->pwm_pending) ||
+       time_before(jiffies, asus->pwm_last_write[fan] + interval))) {
+    atomic_long_inc(&asus->pwm_coalesced[fan]);
+    if (!test_and_set_bit(fan, &asus->pwm_pending))
+      schedule_delayed_work(&asus->pwm_flush_work,
+                            asus->pwm_last_write[fan] + interval - jiffies);
+    return 0;
+  }
+  return __fan_apply_speed(asus, fan, state);
+}
+
+static int __fan_set_cur_state_now(struct asus_fan *asus, int fan,
+                                   unsigned long state) {
+  lockdep_assert_held(&asus->lock);
+
+  atomic_long_inc(&asus->pwm_received[fan]);
+  fan_state_set(asus, fan, state, true, false);
+  // a coalesced write still waiting is replaced by this one, a running ramp
+  // finds itself at the target
+  clear_bit(fan, &asus->pwm_pending);
+  if (asus->pwm_applied[fan] == (int)state) {
+    atomic_long_inc(&asus->pwm_deduplicated[fan]);
+    return 0;
+  }
+  return __fan_apply_speed(asus, fan, state);
+}
+
+static int __fan_apply_speed(struct asus_fan *asus, int fan, int speed) {
+  int ret;
+
+  atomic_long_inc(&asus->pwm_ec_writes[fan]);
+  asus->pwm_last_write[fan] = jiffies;
+  ret = fan_set_speed(asus, fan, speed);
+  if (!ret)
+    WRITE_ONCE(asus->pwm_applied[fan], speed);
+  return ret;
+}
+
+static void pwm_flush_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, pwm_flush_work);
+  unsigned long interval = msecs_to_jiffies(READ_ONCE(pwm_min_interval));
+  struct asus_fan_state st;
+  unsigned long due;
+  int fan;
+
+  mutex_lock(&asus->lock);
+  for (fan = 0; fan < 2; fan++) {
+    if (!test_bit(fan, &asus->pwm_pending))
+      continue;
+    // the other fan's write may not be due yet
+    due = asus->pwm_last_write[fan] + interval;
+    if (time_before(jiffies, due)) {
+      schedule_delayed_work(&asus->pwm_flush_work, due - jiffies);
+      continue;
+    }
+    clear_bit(fan, &asus->pwm_pending);
+    // back in auto-mode meanwhile, nothing to write anymore
+    fan_state_get(asus, fan, &st);
+    if (!st.manual)
+      continue;
+    if (__fan_apply_speed(asus, fan, st.pwm))
+      printk(KERN_INFO "asus-fan (set pwm%d) - coalesced write failed\n",
+             fan + 1);
+  }
+  mutex_unlock(&asus->lock);
+}
+
+static bool pwm_ramp_active(struct asus_fan *asus, int fan) {
+  // the calibration sweep needs each of its pwm steps right away
+  if (READ_ONCE(asus->calib_run.state) == CALIB_RUNNING &&
+      READ_ONCE(asus->calib_run.fan) == fan)
+    return false;
+  return READ_ONCE(pwm_ramp_step) > 0;
+}
+
+static void pwm_ramp_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, pwm_ramp_work);
+  unsigned int step = READ_ONCE(pwm_ramp_step);
+  struct asus_fan_sample s;
+  struct asus_fan_state st;
+  bool more = false;
+  int fan, from, next;
+
+  mutex_lock(&asus->lock);
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1); fan++) {
+    // back in auto-mode meanwhile, nothing to ramp anymore
+    fan_state_get(asus, fan, &st);
+    if (!st.manual)
+      continue;
+    from = asus->pwm_applied[fan];
+    if (from < 0) {
+      // coming from auto-mode, start where the firmware left the fan
+      sample_get(asus, &s);
+      from = calib_rpm_to_pwm(asus, fan, s.rpm[fan]);
+    } else if (abs(st.pwm - from) <= READ_ONCE(pwm_deadband)) {
+      continue;
+    }
+    // ramp switched off meanwhile, go there at once
+    next = st.pwm;
+    if (step && pwm_ramp_active(asus, fan))
+      next = clamp_val(st.pwm, from - (int)step, from + (int)step);
+    if (__fan_apply_speed(asus, fan, next)) {
+      printk(KERN_INFO "asus-fan (set pwm%d) - ramp step failed\n", fan + 1);
+      continue;
+    }
+    if (next != st.pwm)
+      more = true;
+  }
+  if (more)
+    schedule_delayed_work(
+        &asus->pwm_ramp_work,
+        msecs_to_jiffies(max(READ_ONCE(pwm_ramp_interval), 1U)));
+  mutex_unlock(&asus->lock);
+}
+
+static int __fan_get_cur_control_state(struct asus_fan *asus, int fan,
+                                       int *state) {
+  struct asus_fan_state st;
+
+  fan_state_get(asus, fan, &st);
+  if (st.curve)
+    *state = FAN_MODE_CURVE;
+  else
+    *state = st.manual;
+  return 0;
+}
+
+static int __fan_set_cur_control_state(struct asus_fan *asus, int fan,
+                                       int state) {
+  struct asus_fan_state st;
+
+  lockdep_assert_held(&asus->lock);
+
+  fan_state_get(asus, fan, &st);
+  switch (state) {
+    case FAN_MODE_AUTO:
+      return __fan_set_auto(asus);
+    case FAN_MODE_MANUAL:
+      // leaving the controller keeps the last speed it has set
+      fan_state_set(asus, fan, st.pwm, st.manual, false);
+      return 0;
+    case FAN_MODE_CURVE:
+      if (!test_bit(METHOD_TH1R, &asus->method_caps))
+        return -ENODEV;
+      // start from the current temperature, not from any old reference
+      asus->curve_temp_ref[fan] = 0;
+      fan_state_set(asus, fan, st.pwm, st.manual, true);
+      mod_delayed_work(system_wq, &asus->curve_work, 0);
+      return 0;
+  }
+  return -EINVAL;
+}
+
+static int calib_interp(int x, const u16 *xs, const u16 *ys, int count) {
+  int i;
+
+  if (x <= xs[0])
+    return ys[0];
+  for (i = 1; i < count; i++) {
+    if (x >= xs[i])
+      continue;
+    if (xs[i] == xs[i - 1])
+      return ys[i];
+    return ys[i - 1] +
+           ((int)ys[i] - ys[i - 1]) * (x - xs[i - 1]) / (xs[i] - xs[i - 1]);
+  }
+  return ys[count - 1];
+}
+
+static void calib_build(struct asus_fan_calib *calib) {
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE(calib->pwm_to_rpm); i++)
+    calib->pwm_to_rpm[i] =
+        calib_interp(i, calib->pwm, calib->rpm, calib->count);
+  // a stopped fan is always reported as pwm 0
+  calib->rpm_to_pwm[0] = 0;
+  for (i = 1; i < ARRAY_SIZE(calib->rpm_to_pwm); i++)
+    calib->rpm_to_pwm[i] = calib_interp(i << CALIB_RPM_SHIFT, calib->rpm,
+                                        calib->pwm, calib->count);
+}
+
+static int calib_load(struct asus_fan *asus, int fan, const u16 *pwm,
+                      const u16 *rpm, int count) {
+  struct asus_fan_calib *calib, *old;
+  int i;
+
+  if (count < 2 || count > CALIB_POINTS_MAX)
+    return -EINVAL;
+  // both directions are looked up, so pwm has to be strictly ascending and
+  // rpm must not go down
+  for (i = 0; i < count; i++) {
+    if (pwm[i] > 255 || rpm[i] > CALIB_RPM_MAX)
+      return -EINVAL;
+    if (i > 0 && (pwm[i] <= pwm[i - 1] || rpm[i] < rpm[i - 1]))
+      return -EINVAL;
+  }
+
+  calib = kzalloc(sizeof(*calib), GFP_KERNEL);
+  if (!calib)
+    return -ENOMEM;
+  calib->count = count;
+  memcpy(calib->pwm, pwm, count * sizeof(*pwm));
+  memcpy(calib->rpm, rpm, count * sizeof(*rpm));
+  calib_build(calib);
+
+  mutex_lock(&asus->calib_lock);
+  old = rcu_dereference_protected(asus->calib[fan],
+                                  lockdep_is_held(&asus->calib_lock));
+  rcu_assign_pointer(asus->calib[fan], calib);
+  mutex_unlock(&asus->calib_lock);
+
+  synchronize_rcu();
+  if (old != &calib_default)
+    kfree(old);
+  return 0;
+}
+
+static int calib_pwm_to_rpm(struct asus_fan *asus, int fan, int pwm) {
+  int rpm;
+
+  rcu_read_lock();
+  rpm = rcu_dereference(asus->calib[fan])->pwm_to_rpm[clamp_val(pwm, 0, 255)];
+  rcu_read_unlock();
+  return rpm;
+}
+
+static int calib_rpm_to_pwm(struct asus_fan *asus, int fan, int rpm) {
+  int pwm;
+
+  if (rpm <= 0)
+    return 0;
+  rpm = min(rpm, CALIB_RPM_MAX);
+  rcu_read_lock();
+  pwm = rcu_dereference(asus->calib[fan])->rpm_to_pwm[rpm >> CALIB_RPM_SHIFT];
+  rcu_read_unlock();
+  return pwm;
+}
+
+static ssize_t calib_read(struct file *filp, struct kobject *kobj,
+                          struct bin_attribute *attr, char *buf, loff_t off,
+                          size_t count) {
+  struct asus_fan *asus = dev_get_drvdata(kobj_to_dev(kobj));
+  char blob[CALIB_BLOB_SIZE];
+  struct asus_fan_calib_header *hdr = (void *)blob;
+  struct asus_fan_calib_point *pts = (void *)(hdr + 1);
+  struct asus_fan_calib *calib;
+  int fan = (long)attr->private;
+  size_t size;
+  int i;
+
+  rcu_read_lock();
+  calib = rcu_dereference(asus->calib[fan]);
+  hdr->magic = cpu_to_le32(CALIB_MAGIC);
+  hdr->version = CALIB_VERSION;
+  hdr->count = calib->count;
+  hdr->reserved = 0;
+  for (i = 0; i < calib->count; i++) {
+    pts[i].pwm = cpu_to_le16(calib->pwm[i]);
+    pts[i].rpm = cpu_to_le16(calib->rpm[i]);
+  }
+  size = sizeof(*hdr) + calib->count * sizeof(*pts);
+  rcu_read_unlock();
+
+  return memory_read_from_buffer(buf, count, &off, blob, size);
+}
+
+static ssize_t calib_write(struct file *filp, struct kobject *kobj,
+                           struct bin_attribute *attr, char *buf, loff_t off,
+                           size_t count) {
+  struct asus_fan *asus = dev_get_drvdata(kobj_to_dev(kobj));
+  struct asus_fan_calib_header *hdr = (void *)buf;
+  struct asus_fan_calib_point *pts = (void *)(hdr + 1);
+  u16 pwm[CALIB_POINTS_MAX], rpm[CALIB_POINTS_MAX];
+  int fan = (long)attr->private;
+  int i, err;
+
+  // the whole table has to be written at once
+  if (off != 0 || count < sizeof(*hdr))
+    return -EINVAL;
+  if (le32_to_cpu(hdr->magic) != CALIB_MAGIC || hdr->version != CALIB_VERSION)
+    return -EINVAL;
+  if (hdr->count > CALIB_POINTS_MAX ||
+      count != sizeof(*hdr) + hdr->count * sizeof(*pts))
+    return -EINVAL;
+
+  for (i = 0; i < hdr->count; i++) {
+    pwm[i] = le16_to_cpu(pts[i].pwm);
+    rpm[i] = le16_to_cpu(pts[i].rpm);
+  }
+  err = calib_load(asus, fan, pwm, rpm, hdr->count);
+  if (err)
+    return err;
+  return count;
+}
+
+static int calib_sweep_start(struct asus_fan *asus, int fan) {
+  struct asus_fan_calib_run *run = &asus->calib_run;
+  unsigned int step = clamp_val(calib_step, 10, 255);
+  struct asus_fan_state st;
+  int i;
+
+  if (fan > 0 && !asus->has_gfx_fan)
+    return -ENODEV;
+  // no sweep without overheat protection
+  if (!test_bit(METHOD_TH1R, &asus->method_caps))
+    return -ENODEV;
+  // TACH reads 0 in manual mode, only the ec registers see the sweep
+  if (!asus->tach_ec)
+    return -EOPNOTSUPP;
+
+  mutex_lock(&asus->calib_run_lock);
+  if (run->state == CALIB_RUNNING) {
+    mutex_unlock(&asus->calib_run_lock);
+    return -EBUSY;
+  }
+  // point 0 is 'stopped', it is not measured to not stall the fan
+  run->count = 1;
+  run->pwm[0] = 0;
+  run->rpm[0] = 0;
+  for (i = step; i < 255; i += step)
+    run->pwm[run->count++] = i;
+  run->pwm[run->count++] = 255;
+
+  run->state = CALIB_RUNNING;
+  run->reason = NULL;
+  run->fan = fan;
+  run->step = 1;
+  run->sample = -1;
+
+  mutex_lock(&asus->lock);
+  fan_state_get(asus, fan, &st);
+  fan_state_set(asus, fan, st.pwm, st.manual, false);
+  mutex_unlock(&asus->lock);
+  mutex_unlock(&asus->calib_run_lock);
+
+  printk(KERN_INFO "asus-fan (calibrate) - starting sweep of fan%d\n",
+         fan + 1);
+  mod_delayed_work(system_wq, &asus->calib_work, 0);
+  return 0;
+}
+
+static void calib_sweep_abort(struct asus_fan *asus, const char *reason) {
+  bool running;
+
+  mutex_lock(&asus->calib_run_lock);
+  running = asus->calib_run.state == CALIB_RUNNING;
+  if (running) {
+    asus->calib_run.state = CALIB_ABORTED;
+    asus->calib_run.reason = reason;
+  }
+  mutex_unlock(&asus->calib_run_lock);
+
+  if (running) {
+    cancel_delayed_work_sync(&asus->calib_work);
+    fan_set_auto(asus);
+  }
+}
+
+static void calib_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, calib_work);
+  struct asus_fan_calib_run *run = &asus->calib_run;
+  unsigned long long temp;
+  unsigned int delay = 0;
+  int fan, rpm, i, err;
+
+  mutex_lock(&asus->calib_run_lock);
+  if (run->state != CALIB_RUNNING)
+    goto out;
+  fan = run->fan;
+
+  // safety first - stop long before things get critical
+  if (__temp1_read(asus, &temp) || temp + calib_temp_margin >= TEMP1_CRIT) {
+    run->state = CALIB_ABORTED;
+    run->reason = "temperature";
+    printk(KERN_INFO "asus-fan (calibrate) - temperature too high, "
+                     "fallback to auto-mode\n");
+    fan_set_auto(asus);
+    goto out;
+  }
+
+  if (run->sample < 0) {
+    // next point: set the speed and let the fan settle
+    mutex_lock(&asus->lock);
+    err = __fan_set_cur_state(asus, fan, run->pwm[run->step], false);
+    mutex_unlock(&asus->lock);
+    if (err) {
+      run->state = CALIB_FAILED;
+      run->reason = "SFNV failed";
+      fan_set_auto(asus);
+      goto out;
+    }
+    run->sample = 0;
+    run->rpm_sum = 0;
+    run->rpm_valid = 0;
+    delay = calib_settle_ms;
+  } else {
+    if (!__fan_tach(asus, fan, &rpm) && rpm >= 0) {
+      run->rpm_sum += rpm;
+      run->rpm_valid++;
+    }
+    if (++run->sample < max(calib_samples, 1U)) {
+      delay = 200;
+    } else {
+      // point done - average, but never let the rpm go down (noise)
+      if (!run->rpm_valid) {
+        run->state = CALIB_FAILED;
+        run->reason = "TACH failed";
+        fan_set_auto(asus);
+        goto out;
+      }
+      i = run->step;
+      run->rpm[i] = min(run->rpm_sum / run->rpm_valid, CALIB_RPM_MAX);
+      run->rpm[i] = max(run->rpm[i], run->rpm[i - 1]);
+      run->sample = -1;
+
+      if (++run->step == run->count) {
+        fan_set_auto(asus);
+        // full speed without any rpm, the registers are not the tach
+        if (!run->rpm[i]) {
+          run->state = CALIB_FAILED;
+          run->reason = "no rpm at full speed";
+          goto out;
+        }
+        err = calib_load(asus, fan, run->pwm, run->rpm, run->count);
+        run->state = err ? CALIB_FAILED : CALIB_DONE;
+        run->reason = err ? "invalid table" : NULL;
+        printk(KERN_INFO "asus-fan (calibrate) - sweep of fan%d %s\n",
+               fan + 1, err ? "failed" : "done");
+        goto out;
+      }
+    }
+  }
+  schedule_delayed_work(&asus->calib_work, msecs_to_jiffies(delay));
+
+out:
+  mutex_unlock(&asus->calib_run_lock);
+}
+
+static int curve_eval(struct asus_fan *asus, int fan, int temp) {
+  int *t = asus->curve_temp[fan];
+  int *p = asus->curve_pwm[fan];
+  int *ref = &asus->curve_temp_ref[fan];
+  int i;
+
+  // only go down again once the temperature dropped by the hysteresis
+  if (temp >= *ref || *ref - temp >= curve_hysteresis * 1000)
+    *ref = temp;
+  temp = *ref;
+
+  if (temp <= t[0])
+    return p[0];
+  for (i = 1; i < CURVE_POINTS; i++) {
+    if (temp >= t[i])
+      continue;
+    // piecewise-linear between point 'i - 1' and 'i'
+    if (t[i] <= t[i - 1])
+      return p[i];
+    return p[i - 1] + (p[i] - p[i - 1]) * (temp - t[i - 1]) / (t[i] - t[i - 1]);
+  }
+  return p[CURVE_POINTS - 1];
+}
+
+static void curve_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, curve_work);
+  struct asus_fan_state st;
+  unsigned long long temp;
+  bool active = false;
+  int fan, pwm, err;
+
+  err = __temp1_read(asus, &temp);
+
+  // the mode is checked under the lock, a concurrent manual write wins
+  mutex_lock(&asus->lock);
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1); fan++) {
+    fan_state_get(asus, fan, &st);
+    if (!st.curve)
+      continue;
+    active = true;
+    if (err) {
+      printk(KERN_INFO "asus-fan (curve) - reading temperature failed, "
+                       "fallback to auto-mode\n");
+      __fan_set_auto(asus);
+      mutex_unlock(&asus->lock);
+      return;
+    }
+    // unchanged values never reach the ec
+    pwm = curve_eval(asus, fan, temp * 1000);
+    if (__fan_set_cur_state(asus, fan, pwm, true)) {
+      printk(KERN_INFO "asus-fan (curve) - setting pwm%d failed, "
+                       "fallback to auto-mode\n",
+             fan + 1);
+      __fan_set_auto(asus);
+      mutex_unlock(&asus->lock);
+      return;
+    }
+  }
+  mutex_unlock(&asus->lock);
+
+  if (active)
+    schedule_delayed_work(&asus->curve_work,
+                          msecs_to_jiffies(READ_ONCE(curve_interval)));
+}
+
+static void asus_fan_resolve_methods(struct asus_fan *asus) {
+  acpi_status ret;
+  int i;
+
+  for (i = 0; i < METHOD_COUNT; i++) {
+    asus->method_lookups++;
+    ret = acpi_get_handle(NULL, (acpi_string)method_paths[i],
+                          &asus->method_handles[i]);
+    if (ACPI_SUCCESS(ret))
+      set_bit(i, &asus->method_caps);
+    else
+      printk(KERN_INFO "asus-fan (init) - acpi method %s not available\n",
+             method_paths[i]);
+  }
+}
+
+static acpi_status asus_fan_eval(struct asus_fan *asus,
+                                 enum asus_fan_method method,
+                                 struct acpi_object_list *args,
+                                 unsigned long long *value) {
+  u64 arg[2] = {0, 0}, start, ns;
+  acpi_status ret;
+  int i, nargs;
+
+  if (!test_bit(method, &asus->method_caps))
+    return AE_NOT_FOUND;
+  atomic_long_inc(&asus->method_calls[method]);
+  start = ktime_get_ns();
+  ret = acpi_evaluate_integer(asus->method_handles[method], NULL, args,
+                              value);
+  ns = ktime_get_ns() - start;
+  asus_fan_eval_account(asus, method, ns, ret);
+
+  if (trace_asus_fan_acpi_call_enabled() || asus->record) {
+    nargs = args ? args->count : 0;
+    for (i = 0; i < min_t(int, nargs, ARRAY_SIZE(arg)); i++)
+      if (args->pointer[i].type == ACPI_TYPE_INTEGER)
+        arg[i] = args->pointer[i].integer.value;
+    trace_asus_fan_acpi_call(method_names[method], nargs, arg[0], arg[1], ret,
+                             ret == AE_OK ? *value : 0, ns);
+    record_call(asus, method, nargs, arg, ret, ret == AE_OK ? *value : 0,
+                start, ns);
+  }
+  return ret;
+}
+
+static void asus_fan_eval_account(struct asus_fan *asus,
+                                  enum asus_fan_method method, u64 ns,
+                                  acpi_status status) {
+  u64 us = div_u64(ns, NSEC_PER_USEC);
+  s64 max = atomic64_read(&asus->method_max_ns[method]);
+  s64 prev;
+  int bucket;
+
+  bucket = us ? min_t(int, ilog2(us) + 1, ACPI_HIST_BUCKETS - 1) : 0;
+  atomic_long_inc(&asus->method_hist[method][bucket]);
+  atomic64_add(ns, &asus->method_ns[method]);
+  while ((s64)ns > max) {
+    prev = atomic64_cmpxchg(&asus->method_max_ns[method], max, ns);
+    if (prev == max)
+      break;
+    max = prev;
+  }
+  if (status != AE_OK)
+    atomic_long_inc(&asus->method_errors[method]);
+}
+
+static int asus_fan_hw_init(struct asus_fan *asus) {
+  acpi_status ret;
+  int rpm;
+
+  // without these methods there is nothing to control
+  if (!test_bit(METHOD_SFNV, &asus->method_caps) ||
+      !test_bit(METHOD_TACH, &asus->method_caps)) {
+    printk(KERN_INFO "asus-fan (init) - SFNV/TACH not found, no fan?\n");
+    return -ENODEV;
+  }
+
+  // does the ec answer at all?
+  rpm = __fan_rpm(asus, 0);
+  if (rpm == -1)
+    return -ENODEV;
+
+  // a max speed (or the quiet profile) outlives rmmod in the ec, start from
+  // what 'max_speed' says - without ST98 there is just no max speed control
+  // (see is_visible)
+  if (test_bit(METHOD_ST98, &asus->method_caps)) {
+    ret = fan_set_max_speed(asus, max_fan_speed_default, false);
+    if (ret != AE_OK) {
+      printk(KERN_INFO
+             "asus-fan (init) - set max speed to: '%d' failed! errcode: %d",
+             max_fan_speed_default, ret);
+      return -ENODEV;
+    }
+  }
+
+  if (asus->quirk->fans) {
+    asus->has_gfx_fan = asus->quirk->fans > 1;
+    asus_fan_tach_ec_init(asus);
+    return 0;
+  }
+
+  // unknown model, find out what works by trying it
+  rpm = __fan_rpm(asus, 1);
+  if (rpm == -1)
+    asus->has_gfx_fan = false;
+  else
+    asus->has_gfx_fan = true;
+
+  // force sane enviroment / init with automatic fan controlling
+  if ((ret = fan_set_auto(asus)) != AE_OK) {
+    printk(KERN_INFO
+           "asus-fan (init) - set auto-mode speed to active, failed! "
+           "errcode: %d",
+           ret);
+    return -ENODEV;
+  }
+  asus_fan_tach_ec_init(asus);
+  return 0;
+}
+
+static void asus_fan_tach_ec_init(struct asus_fan *asus) {
+  int rpm;
+
+  // tach registers if the model has them, or if forced to
+  asus->tach_ec = tach_ec < 0 ? asus->quirk->tach_ec : tach_ec;
+  if (asus->tach_ec && __fan_tach_ec(asus, 0, &rpm)) {
+    printk(KERN_INFO "asus-fan (init) - ec registers not readable, "
+                     "using TACH\n");
+    asus->tach_ec = false;
+  }
+}
+
+static int fan_set_speed(struct asus_fan *asus, int fan, int speed) {
+  struct acpi_object_list params;
+  union acpi_object args[2];
+  unsigned long long value;
+
+  // set speed to 'speed' for given 'fan'-index
+  // -> automatically switch to manual mode!
+  params.count = ARRAY_SIZE(args);
+  params.pointer = args;
+  // Args:
+  // fan index
+  // - add '1' to index as '0' has a special meaning (auto-mode)
+  args[0].type = ACPI_TYPE_INTEGER;
+  args[0].integer.value = fan + 1;
+  // target fan speed
+  // - between 0x00 and MAX (0 - MAX)
+  //   - 'MAX' is usually 0xFF (255)
+  //   - should be getable with fan_get_max_speed()
+  args[1].type = ACPI_TYPE_INTEGER;
+  args[1].integer.value = speed;
+  // acpi call
+  return asus_fan_eval(asus, METHOD_SFNV, &params, &value);
+}
+
+static int __fan_rpm(struct asus_fan *asus, int fan) {
+  struct asus_fan_state st;
+  int rpm;
+
+  // TACH does not report during manual speed setting - so fake it!
+  fan_state_get(asus, fan, &st);
+  if (st.manual && !asus->tach_ec)
+    return calib_pwm_to_rpm(asus, fan, st.pwm);
+
+  if (__fan_tach(asus, fan, &rpm))
+    return -1;
+  return rpm;
+}
+
+static int __fan_tach(struct asus_fan *asus, int fan, int *rpm) {
+  struct acpi_object_list params;
+  union acpi_object args[1];
+  unsigned long long value;
+  acpi_status ret;
+
+  if (asus->tach_ec)
+    return __fan_tach_ec(asus, fan, rpm);
+
+  // getting current fan 'speed' as 'state',
+  params.count = ARRAY_SIZE(args);
+  params.pointer = args;
+  // Args:
+  // - get speed from the fan with index 'fan'
+  args[0].type = ACPI_TYPE_INTEGER;
+  args[0].integer.value = fan;
+
+  // acpi call
+  ret = asus_fan_eval(asus, METHOD_TACH, &params, &value);
+  if (ret != AE_OK)
+    return -1;
+  *rpm = (int)value;
+  return 0;
+}
+
+static int __fan_tach_ec(struct asus_fan *asus, int fan, int *rpm) {
+  u8 lsb = 0, msb = 0;
+  u64 start, ns, arg[2];
+  unsigned int raw, val;
+  int ret;
+
+  start = ktime_get_ns();
+  ret = ec_read(EC_TACH_REG(fan), &lsb);
+  if (!ret)
+    ret = ec_read(EC_TACH_REG(fan) + 1, &msb);
+  ns = ktime_get_ns() - start;
+  asus_fan_eval_account(asus, LATENCY_EC, ns, ret ? AE_ERROR : AE_OK);
+  raw = msb << 8 | lsb;
+  trace_asus_fan_acpi_call(method_names[LATENCY_EC], 1, EC_TACH_REG(fan), 0,
+                           ret ? AE_ERROR : AE_OK, raw, ns);
+  // the period counter overflows (0xffff) on a standing fan
+  val = !ret && raw && raw != 0xffff ? EC_TACH_RPM(raw) : 0;
+  // recorded converted, a replay has no idea of the register layout
+  arg[0] = EC_TACH_REG(fan);
+  arg[1] = fan;
+  record_call(asus, LATENCY_EC, 2, arg, ret ? AE_ERROR : AE_OK, val, start,
+              ns);
+  if (ret)
+    return -1;
+  *rpm = val;
+  return 0;
+}
+
+static int __temp1_read(struct asus_fan *asus, unsigned long long *temp) {
+  acpi_status ret;
+
+  // acpi call
+  ret = asus_fan_eval(asus, METHOD_TH1R, NULL, temp);
+  if (ret != AE_OK)
+    return -1;
+  return 0;
+}
+
+static void sample_refresh(struct asus_fan *asus) {
+  struct asus_fan_sample s;
+  struct asus_fan_state st;
+  int fan;
+
+  // all acpi calls are done before taking the lock, so readers only ever
+  // have to retry for the duration of a struct copy
+  s.rpm[0] = __fan_rpm(asus, 0);
+  s.rpm[1] = asus->has_gfx_fan ? __fan_rpm(asus, 1) : 0;
+  if (__temp1_read(asus, &s.temp))
+    s.temp = asus->sample.temp;
+
+  s.alarms = 0;
+  if (s.temp >= TEMP1_CRIT)
+    s.alarms |= BIT(ALARM_TEMP_CRIT);
+  for (fan = 0; fan < 1 + asus->has_gfx_fan; fan++) {
+    // unreadable, or driven by us and still below fanX_min - in auto-mode
+    // the firmware idles the fans at 0 rpm on its own
+    fan_state_get(asus, fan, &st);
+    if (s.rpm[fan] < 0 ||
+        (st.manual && READ_ONCE(asus->pwm_applied[fan]) > 0 &&
+         s.rpm[fan] < FAN_MIN))
+      s.alarms |= BIT(ALARM_FAN(fan));
+  }
+
+  write_seqlock(&asus->sample_lock);
+  asus->sample = s;
+  write_sequnlock(&asus->sample_lock);
+  status_page_update(asus);
+
+  sample_notify(asus, &s);
+}
+
+static void sample_notify(struct asus_fan *asus,
+                          const struct asus_fan_sample *s) {
+  struct asus_fan_sample *last = &asus->notified;
+  unsigned int temp_delta = READ_ONCE(notify_temp_delta);
+  unsigned int rpm_delta = READ_ONCE(notify_rpm_delta);
+  unsigned int changed = s->alarms ^ last->alarms;
+  int fan;
+
+  // before registration (and while removing) the values are only recorded
+  if (!READ_ONCE(asus->notify)) {
+    *last = *s;
+    return;
+  }
+
+  if (temp_delta &&
+      abs((long long)s->temp - (long long)last->temp) * 1000 >= temp_delta) {
+    hwmon_notify_event(asus->hwmon_dev, hwmon_temp, hwmon_temp_input, 0);
+    last->temp = s->temp;
+  }
+  if (changed & BIT(ALARM_TEMP_CRIT))
+    hwmon_notify_event(asus->hwmon_dev, hwmon_temp, hwmon_temp_crit_alarm, 0);
+
+  for (fan = 0; fan < 1 + asus->has_gfx_fan; fan++) {
+    if (rpm_delta && abs(s->rpm[fan] - last->rpm[fan]) >= rpm_delta) {
+      hwmon_notify_event(asus->hwmon_dev, hwmon_fan, hwmon_fan_input, fan);
+      last->rpm[fan] = s->rpm[fan];
+    }
+    if (changed & BIT(ALARM_FAN(fan)))
+      hwmon_notify_event(asus->hwmon_dev, hwmon_fan, hwmon_fan_alarm, fan);
+  }
+  last->alarms = s->alarms;
+}
+
+static void sample_get(struct asus_fan *asus, struct asus_fan_sample *s) {
+  WRITE_ONCE(asus->sample_last_read, jiffies);
+  smp_mb();
+  // the sampler went idle, thus the snapshot is outdated - restart it, but
+  // never wait for acpi here: this read gets the last sample, the following
+  // ones the fresh ones
+  if (!test_and_set_bit(0, &asus->sampler_running))
+    mod_delayed_work(system_wq, &asus->sampler_work, 0);
+  sample_peek(asus, s);
+}
+
+static void sample_peek(struct asus_fan *asus, struct asus_fan_sample *s) {
+  unsigned int seq;
+
+  do {
+    seq = read_seqbegin(&asus->sample_lock);
+    *s = asus->sample;
+  } while (read_seqretry(&asus->sample_lock, seq));
+}
+
+static void sampler_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, sampler_work);
+  unsigned long interval =
+      msecs_to_jiffies(READ_ONCE(asus->update_interval));
+
+  sample_refresh(asus);
+
+  // nobody is reading anymore - go idle, but re-check for a reader that
+  // raced with us, which would otherwise not restart the sampler
+  // (an open /dev/asus_fan counts as reading, its page has to stay current)
+  if (!atomic_read(&asus->dev_users) &&
+      time_after(jiffies, READ_ONCE(asus->sample_last_read) +
+                              interval * SAMPLER_IDLE_INTERVALS)) {
+    clear_bit(0, &asus->sampler_running);
+    smp_mb__after_atomic();
+    if (!time_after(jiffies, READ_ONCE(asus->sample_last_read) +
+                                 interval * SAMPLER_IDLE_INTERVALS) &&
+        !test_and_set_bit(0, &asus->sampler_running)) {
+      schedule_delayed_work(&asus->sampler_work, interval);
+      return;
+    }
+    // keep watching at a low rate for poll()ing readers and the thermal
+    // zone, the next read pulls this one in (see sample_get())
+    if (sampler_idle_interval(asus))
+      schedule_delayed_work(
+          &asus->sampler_work,
+          max(interval, msecs_to_jiffies(sampler_idle_interval(asus))));
+    return;
+  }
+  schedule_delayed_work(&asus->sampler_work, interval);
+}
+
+static unsigned int sampler_idle_interval(struct asus_fan *asus) {
+  if (notify_interval)
+    return notify_interval;
+  return asus->tzd ? THERMAL_POLLING_DELAY : 0;
+}
+
+static int asus_fan_cooling_get_max_state(struct thermal_cooling_device *cdev,
+                                          unsigned long *state) {
+  *state = clamp_val(cooling_levels, 1, 255);
+  return 0;
+}
+
+static int asus_fan_cooling_get_cur_state(struct thermal_cooling_device *cdev,
+                                          unsigned long *state) {
+  struct asus_fan_cooling *c = cdev->devdata;
+
+  *state = READ_ONCE(c->state);
+  return 0;
+}
+
+static int asus_fan_cooling_set_cur_state(struct thermal_cooling_device *cdev,
+                                          unsigned long state) {
+  struct asus_fan_cooling *c = cdev->devdata;
+  struct asus_fan *asus = c->asus;
+  unsigned long levels = clamp_val(cooling_levels, 1, 255);
+  struct asus_fan_state other;
+  int ret = 0;
+
+  if (state > levels)
+    return -EINVAL;
+
+  mutex_lock(&asus->lock);
+  if (state) {
+    c->waiting = false;
+    if (__fan_set_cur_state(asus, c->fan, DIV_ROUND_UP(state * 255, levels),
+                            false))
+      ret = -EIO;
+  } else if (c->state) {
+    // hand the fan back to the firmware - auto-mode is only available for
+    // all fans at once, so wait while the other one is still driven by
+    // the thermal core or the user
+    fan_state_get(asus, !c->fan, &other);
+    if (!asus->has_gfx_fan || !other.manual || asus->cooling[!c->fan].waiting) {
+      ret = __fan_set_auto(asus);
+      asus->cooling[0].waiting = asus->cooling[1].waiting = false;
+    } else {
+      c->waiting = true;
+    }
+  }
+  if (!ret)
+    WRITE_ONCE(c->state, state);
+  mutex_unlock(&asus->lock);
+  return ret;
+}
+
+static const struct thermal_cooling_device_ops asus_fan_cooling_ops = {
+    .get_max_state = asus_fan_cooling_get_max_state,
+    .get_cur_state = asus_fan_cooling_get_cur_state,
+    .set_cur_state = asus_fan_cooling_set_cur_state,
+};
+
+#ifdef ASUS_FAN_THERMAL_ZONE
+static int asus_fan_tz_get_temp(struct thermal_zone_device *tz, int *temp) {
+  struct asus_fan *asus = thermal_zone_device_priv(tz);
+  struct asus_fan_sample s;
+
+  // the zone polls forever, as a reader it would keep the sampler from
+  // ever going idle - the idle sampler keeps the snapshot moving
+  sample_peek(asus, &s);
+  *temp = s.temp * 1000;
+  return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+// only our own fans cool the gfx zone, through the passive trip
+static bool asus_fan_tz_should_bind(struct thermal_zone_device *tz,
+                                    const struct thermal_trip *trip,
+                                    struct thermal_cooling_device *cdev,
+                                    struct cooling_spec *c) {
+  struct asus_fan *asus = thermal_zone_device_priv(tz);
+  int fan;
+
+  if (trip->type != THERMAL_TRIP_PASSIVE)
+    return false;
+  for (fan = 0; fan < 2; fan++)
+    if (cdev == asus->cooling[fan].cdev)
+      return true;
+  return false;
+}
+#else
+// only our own fans cool the gfx zone, through the passive trip
+static int asus_fan_tz_bind(struct thermal_zone_device *tz,
+                            struct thermal_cooling_device *cdev) {
+  struct asus_fan *asus = thermal_zone_device_priv(tz);
+  int fan;
+
+  for (fan = 0; fan < 2; fan++)
+    if (cdev == asus->cooling[fan].cdev)
+      return thermal_zone_bind_cooling_device(tz, 0, cdev, THERMAL_NO_LIMIT,
+                                              THERMAL_NO_LIMIT,
+                                              THERMAL_WEIGHT_DEFAULT);
+  return 0;
+}
+
+static int asus_fan_tz_unbind(struct thermal_zone_device *tz,
+                              struct thermal_cooling_device *cdev) {
+  struct asus_fan *asus = thermal_zone_device_priv(tz);
+  int fan;
+
+  for (fan = 0; fan < 2; fan++)
+    if (cdev == asus->cooling[fan].cdev)
+      return thermal_zone_unbind_cooling_device(tz, 0, cdev);
+  return 0;
+}
+#endif
+
+static const struct thermal_zone_device_ops asus_fan_tz_ops = {
+    .get_temp = asus_fan_tz_get_temp,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+    .should_bind = asus_fan_tz_should_bind,
+#else
+    .bind = asus_fan_tz_bind,
+    .unbind = asus_fan_tz_unbind,
+#endif
+};
+#endif
+
+static void asus_fan_thermal_init(struct asus_fan *asus) {
+  struct thermal_cooling_device *cdev;
+#ifdef ASUS_FAN_THERMAL_ZONE
+  struct thermal_zone_device *tzd;
+  int temp_crit = TEMP1_CRIT * 1000;
+  int err;
+#endif
+  int fan;
+
+  if (!thermal)
+    return;
+
+  // the cooling devices first, registering the zone binds them
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1); fan++) {
+    asus->cooling[fan].asus = asus;
+    asus->cooling[fan].fan = fan;
+    cdev = thermal_cooling_device_register(cooling_types[fan],
+                                           &asus->cooling[fan],
+                                           &asus_fan_cooling_ops);
+    if (IS_ERR(cdev)) {
+      printk(KERN_INFO "asus-fan (thermal) - registering cooling device %s "
+                       "failed! errcode: %ld\n",
+             cooling_types[fan], PTR_ERR(cdev));
+      continue;
+    }
+    asus->cooling[fan].cdev = cdev;
+  }
+
+#ifdef ASUS_FAN_THERMAL_ZONE
+  if (!test_bit(METHOD_TH1R, &asus->method_caps))
+    return;
+  asus->trips[0] = (struct thermal_trip){
+      .temperature = temp_crit - THERMAL_PASSIVE_OFFSET * 1000,
+      .hysteresis = 2000,
+      .type = THERMAL_TRIP_PASSIVE,
+  };
+  // a fan driver does not power the machine off unless asked to
+  asus->trips[1] = (struct thermal_trip){
+      .temperature = temp_crit,
+      .type = thermal_crit ? THERMAL_TRIP_CRITICAL : THERMAL_TRIP_HOT,
+  };
+  tzd = thermal_zone_device_register_with_trips(
+      "asus_gfx", asus->trips, ARRAY_SIZE(asus->trips), asus,
+      &asus_fan_tz_ops, NULL, THERMAL_PASSIVE_DELAY, THERMAL_POLLING_DELAY);
+  if (IS_ERR(tzd)) {
+    printk(KERN_INFO "asus-fan (thermal) - registering thermal zone failed! "
+                     "errcode: %ld\n",
+           PTR_ERR(tzd));
+    return;
+  }
+  err = thermal_zone_device_enable(tzd);
+  if (err) {
+    printk(KERN_INFO "asus-fan (thermal) - enabling thermal zone failed! "
+                     "errcode: %d\n",
+           err);
+    thermal_zone_device_unregister(tzd);
+    return;
+  }
+  asus->tzd = tzd;
+  // without notify_interval the idle sampler only runs for the zone
+  if (!notify_interval)
+    schedule_delayed_work(&asus->sampler_work,
+                          msecs_to_jiffies(THERMAL_POLLING_DELAY));
+#endif
+}
+
+static void asus_fan_thermal_exit(struct asus_fan *asus) {
+  int fan;
+
+  if (asus->tzd)
+    thermal_zone_device_unregister(asus->tzd);
+  asus->tzd = NULL;
+  for (fan = 0; fan < 2; fan++) {
+    if (asus->cooling[fan].cdev)
+      thermal_cooling_device_unregister(asus->cooling[fan].cdev);
+    asus->cooling[fan].cdev = NULL;
+  }
+}
+
+static void watchdog_arm(struct asus_fan *asus) {
+  unsigned int interval = READ_ONCE(watchdog_interval);
+
+  // no-op while armed, the work re-arms itself as long as it is needed
+  if (interval)
+    schedule_delayed_work(&asus->watchdog_work, msecs_to_jiffies(interval));
+}
+
+static void watchdog_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, watchdog_work);
+  unsigned int interval = READ_ONCE(watchdog_interval);
+  unsigned int timeout = READ_ONCE(watchdog_timeout);
+  unsigned int stall_ms = READ_ONCE(watchdog_stall_ms);
+  struct asus_fan_state st;
+  unsigned long long temp;
+  const char *reason = NULL;
+  bool manual = false, calibrating;
+  int fan, rpm, applied;
+
+  calibrating = READ_ONCE(asus->calib_run.state) == CALIB_RUNNING;
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1); fan++) {
+    fan_state_get(asus, fan, &st);
+    if (!st.manual) {
+      asus->watchdog_stall[fan] = 0;
+      continue;
+    }
+    manual = true;
+    // the sweep, the included controller and the thermal core are no
+    // process that could die
+    if (timeout && !st.curve && !calibrating &&
+        !READ_ONCE(asus->cooling[fan].state) &&
+        time_after(jiffies, READ_ONCE(asus->watchdog_refresh) +
+                                msecs_to_jiffies(timeout)))
+      reason = "pwm not refreshed";
+    // standing (below fanX_min), but the calibration says it should turn
+    // (only the ec registers report in manual mode)
+    applied = READ_ONCE(asus->pwm_applied[fan]);
+    if (stall_ms && asus->tach_ec && applied > 0 &&
+        !(calibrating && READ_ONCE(asus->calib_run.fan) == fan) &&
+        calib_pwm_to_rpm(asus, fan, applied) >= FAN_MIN &&
+        !__fan_tach(asus, fan, &rpm) &&
+        rpm < FAN_MIN) {
+      if (!asus->watchdog_stall[fan])
+        asus->watchdog_stall[fan] = jiffies ?: 1;
+      else if (time_after(jiffies, asus->watchdog_stall[fan] +
+                                       msecs_to_jiffies(stall_ms)))
+        reason = "fan stalled";
+    } else {
+      asus->watchdog_stall[fan] = 0;
+    }
+  }
+  // back in the firmware's hands, the next manual write re-arms it
+  if (!manual || !interval)
+    return;
+  if (test_bit(METHOD_TH1R, &asus->method_caps) &&
+      !__temp1_read(asus, &temp) &&
+      temp + READ_ONCE(watchdog_temp_margin) >= TEMP1_CRIT)
+    reason = "temperature near critical";
+
+  if (!reason) {
+    schedule_delayed_work(&asus->watchdog_work, msecs_to_jiffies(interval));
+    return;
+  }
+  atomic_long_inc(&asus->watchdog_trips);
+  WRITE_ONCE(asus->watchdog_reason, reason);
+  printk(KERN_INFO "asus-fan (watchdog) - %s, fallback to auto-mode!\n",
+         reason);
+  calib_sweep_abort(asus, "watchdog");
+  fan_set_auto(asus);
+  for (fan = 0; fan < 2; fan++)
+    asus->watchdog_stall[fan] = 0;
+}
+
+static void status_fill(struct asus_fan *asus,
+                        const struct asus_fan_sample *s,
+                        struct asus_fan_status *out) {
+  struct asus_fan_state st;
+  int fan;
+
+  memset(out, 0, sizeof(*out));
+  out->time_ns = ktime_get_ns();
+  out->fans = asus->has_gfx_fan ? 2 : 1;
+  for (fan = 0; fan < out->fans; fan++) {
+    fan_state_get(asus, fan, &st);
+    out->rpm[fan] = s->rpm[fan];
+    // as pwmX: the set speed, or the estimate in auto-mode
+    out->pwm[fan] =
+        st.manual ? st.pwm : calib_rpm_to_pwm(asus, fan, s->rpm[fan]);
+    out->mode[fan] = st.curve ? FAN_MODE_CURVE : st.manual;
+  }
+  out->max_speed = READ_ONCE(asus->max_speed);
+  out->temp =
+      test_bit(METHOD_TH1R, &asus->method_caps) ? (s32)s->temp * 1000 : -1;
+  out->alarms = s->alarms;
+}
+
+static void status_page_update(struct asus_fan *asus) {
+  struct asus_fan_status_page *page = READ_ONCE(asus->status_page);
+  struct asus_fan_status status;
+  struct asus_fan_sample s;
+
+  if (!page)
+    return;
+  // the snapshot as it is, sample_get() would restart the sampler
+  sample_peek(asus, &s);
+  status_fill(asus, &s, &status);
+
+  spin_lock(&asus->status_lock);
+  WRITE_ONCE(page->seq, page->seq + 1);
+  smp_wmb();
+  page->status = status;
+  smp_wmb();
+  WRITE_ONCE(page->seq, page->seq + 1);
+  spin_unlock(&asus->status_lock);
+}
+
+static int asus_fan_dev_open(struct inode *inode, struct file *file) {
+  struct asus_fan *asus =
+      container_of(file->private_data, struct asus_fan, miscdev);
+  struct asus_fan_sample s;
+
+  atomic_inc(&asus->dev_users);
+  // (re-)starts the sampler, which keeps the page current from now on
+  sample_get(asus, &s);
+  return 0;
+}
+
+static int asus_fan_dev_release(struct inode *inode, struct file *file) {
+  struct asus_fan *asus =
+      container_of(file->private_data, struct asus_fan, miscdev);
+
+  atomic_dec(&asus->dev_users);
+  return 0;
+}
+
+static long asus_fan_dev_ioctl(struct file *file, unsigned int cmd,
+                               unsigned long arg) {
+  struct asus_fan *asus =
+      container_of(file->private_data, struct asus_fan, miscdev);
+  void __user *argp = (void __user *)arg;
+  struct asus_fan_status status;
+  struct asus_fan_sample s;
+  struct asus_fan_pwm req;
+  int pwm[2] = {-1, -1};
+  int fan;
+
+  switch (cmd) {
+    case ASUS_FAN_IOC_STATUS:
+      sample_get(asus, &s);
+      status_fill(asus, &s, &status);
+      if (copy_to_user(argp, &status, sizeof(status)))
+        return -EFAULT;
+      return 0;
+    case ASUS_FAN_IOC_SET_PWM:
+      if (!(file->f_mode & FMODE_WRITE))
+        return -EBADF;
+      if (copy_from_user(&req, argp, sizeof(req)))
+        return -EFAULT;
+      // all or nothing, like the single pwmX writes
+      if (!req.fans || req.fans & ~(asus->has_gfx_fan ? 3U : 1U))
+        return -EINVAL;
+      for (fan = 0; fan < 2; fan++) {
+        if (!(req.fans & BIT(fan)))
+          continue;
+        if (req.pwm[fan] > 255)
+          return -EINVAL;
+        pwm[fan] = req.pwm[fan];
+      }
+      return write_request_pwms(asus, pwm);
+  }
+  return -ENOTTY;
+}
+
+static int asus_fan_dev_mmap(struct file *file, struct vm_area_struct *vma) {
+  struct asus_fan *asus =
+      container_of(file->private_data, struct asus_fan, miscdev);
+
+  if (vma->vm_pgoff || vma->vm_end - vma->vm_start != PAGE_SIZE)
+    return -EINVAL;
+  // read-only, also after an mprotect()
+  if (vma->vm_flags & VM_WRITE)
+    return -EPERM;
+  vm_flags_clear(vma, VM_MAYWRITE);
+  // takes its own page reference, a mapping may outlive the device
+  return vm_insert_page(vma, vma->vm_start, virt_to_page(asus->status_page));
+}
+
+static const struct file_operations asus_fan_dev_fops = {
+    .owner = THIS_MODULE,
+    .open = asus_fan_dev_open,
+    .release = asus_fan_dev_release,
+    .unlocked_ioctl = asus_fan_dev_ioctl,
+    .compat_ioctl = compat_ptr_ioctl,
+    .mmap = asus_fan_dev_mmap,
+    .llseek = noop_llseek,
+};
+
+static void asus_fan_dev_init(struct asus_fan *asus) {
+  struct asus_fan_status_page *page;
+  int err;
+
+  if (!chardev)
+    return;
+  BUILD_BUG_ON(sizeof(struct asus_fan_status_page) > PAGE_SIZE);
+  page = (struct asus_fan_status_page *)get_zeroed_page(GFP_KERNEL);
+  if (!page) {
+    printk(KERN_INFO "asus-fan (dev) - no memory for the status page, "
+                     "/dev/" DRIVER_NAME " disabled\n");
+    return;
+  }
+  WRITE_ONCE(asus->status_page, page);
+  status_page_update(asus);
+
+  asus->miscdev.minor = MISC_DYNAMIC_MINOR;
+  asus->miscdev.name = DRIVER_NAME;
+  asus->miscdev.fops = &asus_fan_dev_fops;
+  asus->miscdev.parent = &asus->platform_device->dev;
+  // reading for everybody, ASUS_FAN_IOC_SET_PWM as root (like pwmX)
+  asus->miscdev.mode = 0644;
+  err = misc_register(&asus->miscdev);
+  if (err) {
+    printk(KERN_INFO "asus-fan (dev) - registering /dev/" DRIVER_NAME
+                     " failed! errcode: %d\n",
+           err);
+    return;
+  }
+  asus->miscdev_registered = true;
+}
+
+static void asus_fan_dev_exit(struct asus_fan *asus) {
+  if (asus->miscdev_registered)
+    misc_deregister(&asus->miscdev);
+  asus->miscdev_registered = false;
+}
+
+#ifdef ASUS_FAN_PROFILE
+static int __profile_set(struct asus_fan *asus,
+                         enum platform_profile_option profile) {
+  struct asus_fan_state st;
+  bool curve = false;
+  int fan;
+  acpi_status ret;
+
+  mutex_lock(&asus->lock);
+  // the ceiling first, nothing else changes if the firmware refuses it
+  switch (profile) {
+    case PLATFORM_PROFILE_QUIET:
+      ret = __fan_set_max_speed(asus, min(profile_quiet_max, 255U), false);
+      break;
+    case PLATFORM_PROFILE_BALANCED:
+      ret = __fan_set_max_speed(asus, min(profile_balanced_max, 255U), false);
+      break;
+    case PLATFORM_PROFILE_PERFORMANCE:
+      ret = __fan_set_max_speed(asus, 255,
+                                test_bit(METHOD_QMOD, &asus->method_caps));
+      break;
+    default:
+      mutex_unlock(&asus->lock);
+      return -EOPNOTSUPP;
+  }
+  if (ret) {
+    mutex_unlock(&asus->lock);
+    return -EIO;
+  }
+  if (READ_ONCE(profile_curves)) {
+    for (fan = 0; fan < 2; fan++) {
+      memcpy(asus->curve_temp[fan], profile_curve_temp[profile],
+             sizeof(asus->curve_temp[fan]));
+      memcpy(asus->curve_pwm[fan], profile_curve_pwm[profile],
+             sizeof(asus->curve_pwm[fan]));
+      // the new curve applies at once, not after the hysteresis
+      asus->curve_temp_ref[fan] = 0;
+      fan_state_get(asus, fan, &st);
+      curve |= st.curve;
+    }
+    if (curve)
+      mod_delayed_work(system_wq, &asus->curve_work, 0);
+  }
+  WRITE_ONCE(asus->profile, profile);
+  mutex_unlock(&asus->lock);
+  return 0;
+}
+
+static void profile_choices(unsigned long *choices) {
+  set_bit(PLATFORM_PROFILE_QUIET, choices);
+  set_bit(PLATFORM_PROFILE_BALANCED, choices);
+  set_bit(PLATFORM_PROFILE_PERFORMANCE, choices);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+static int profile_probe(void *drvdata, unsigned long *choices) {
+  profile_choices(choices);
+  return 0;
+}
+
+static int profile_get(struct device *dev,
+                       enum platform_profile_option *profile) {
+  struct asus_fan *asus = dev_get_drvdata(dev);
+
+  *profile = READ_ONCE(asus->profile);
+  return 0;
+}
+
+static int profile_set(struct device *dev,
+                       enum platform_profile_option profile) {
+  return __profile_set(dev_get_drvdata(dev), profile);
+}
+
+static const struct platform_profile_ops asus_fan_profile_ops = {
+    .probe = profile_probe,
+    .profile_get = profile_get,
+    .profile_set = profile_set,
+};
+#else
+static int profile_get(struct platform_profile_handler *pprof,
+                       enum platform_profile_option *profile) {
+  struct asus_fan *asus =
+      container_of(pprof, struct asus_fan, profile_handler);
+
+  *profile = READ_ONCE(asus->profile);
+  return 0;
+}
+
+static int profile_set(struct platform_profile_handler *pprof,
+                       enum platform_profile_option profile) {
+  return __profile_set(container_of(pprof, struct asus_fan, profile_handler),
+                       profile);
+}
+#endif
+
+static void asus_fan_profile_init(struct asus_fan *asus) {
+  int err = 0;
+
+  // a profile is a ceiling first of all
+  if (!platform_profile || !test_bit(METHOD_ST98, &asus->method_caps))
+    return;
+  // what probe left behind: default max speed and curve
+  asus->profile = PLATFORM_PROFILE_BALANCED;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+  // not devm: remove must drop it before 'asus' is freed
+  asus->profile_dev =
+      platform_profile_register(&asus->platform_device->dev, DRIVER_NAME,
+                                asus, &asus_fan_profile_ops);
+  if (IS_ERR(asus->profile_dev)) {
+    err = PTR_ERR(asus->profile_dev);
+    asus->profile_dev = NULL;
+  }
+#else
+  profile_choices(asus->profile_handler.choices);
+  asus->profile_handler.profile_get = profile_get;
+  asus->profile_handler.profile_set = profile_set;
+  // there is only one handler system wide (asus-wmi may have it already)
+  err = platform_profile_register(&asus->profile_handler);
+#endif
+  if (err) {
+    printk(KERN_INFO "asus-fan (profile) - registering the platform profile "
+                     "handler failed! errcode: %d\n",
+           err);
+    return;
+  }
+  asus->profile_registered = true;
+}
+
+static void asus_fan_profile_exit(struct asus_fan *asus) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+  if (asus->profile_registered)
+    platform_profile_remove(asus->profile_dev);
+  asus->profile_dev = NULL;
+#else
+  if (asus->profile_registered)
+    platform_profile_remove();
+#endif
+  asus->profile_registered = false;
+}
+#else
+static void asus_fan_profile_init(struct asus_fan *asus) {}
+
+static void asus_fan_profile_exit(struct asus_fan *asus) {}
+#endif
+
+static void asus_fan_history_init(struct asus_fan *asus) {
+  unsigned int len;
+
+  if (!history_size)
+    return;
+  len = roundup_pow_of_two(min_t(unsigned int, history_size,
+                                 HISTORY_SIZE_MAX));
+  asus->history = kcalloc(len, sizeof(*asus->history), GFP_KERNEL);
+  if (!asus->history) {
+    printk(KERN_INFO "asus-fan (history) - no memory for %u records, "
+                     "history disabled\n",
+           len);
+    return;
+  }
+  asus->history_len = len;
+  schedule_delayed_work(&asus->history_work, 0);
+}
+
+static void history_work_fn(struct work_struct *work) {
+  struct asus_fan *asus =
+      container_of(to_delayed_work(work), struct asus_fan, history_work);
+  struct asus_fan_history_rec rec = {};
+  struct asus_fan_state st;
+  unsigned long long temp;
+  int fan;
+
+  // all acpi calls are done before taking the lock, readers only ever
+  // wait for memory copies
+  for (fan = 0; fan < 2; fan++) {
+    rec.rpm[fan] = -1;
+    rec.pwm[fan] = -1;
+    if (fan > 0 && !asus->has_gfx_fan)
+      continue;
+    fan_state_get(asus, fan, &st);
+    rec.rpm[fan] = __fan_rpm(asus, fan);
+    rec.pwm[fan] = st.pwm;
+    rec.mode[fan] = st.curve ? FAN_MODE_CURVE
+                    : st.manual ? FAN_MODE_MANUAL
+                                : FAN_MODE_AUTO;
+  }
+  rec.temp = __temp1_read(asus, &temp) ? -1 : temp;
+  rec.max_speed = READ_ONCE(asus->max_speed);
+  rec.time_ns = ktime_get_ns();
+
+  spin_lock(&asus->history_lock);
+  rec.seq = asus->history_head;
+  asus->history[asus->history_head & (asus->history_len - 1)] = rec;
+  asus->history_head++;
+  spin_unlock(&asus->history_lock);
+
+  schedule_delayed_work(
+      &asus->history_work,
+      msecs_to_jiffies(max(READ_ONCE(history_interval), HISTORY_INTERVAL_MIN)));
+}
+
+static void asus_fan_record_init(struct asus_fan *asus) {
+  unsigned int len;
+
+  if (!record_size)
+    return;
+  // the values are shared with userspace by number
+  BUILD_BUG_ON(METHOD_SFNV != ASUS_FAN_REC_SFNV ||
+               METHOD_TACH != ASUS_FAN_REC_TACH ||
+               METHOD_TH1R != ASUS_FAN_REC_TH1R ||
+               METHOD_ST98 != ASUS_FAN_REC_ST98 ||
+               METHOD_QMOD != ASUS_FAN_REC_QMOD ||
+               LATENCY_EC != ASUS_FAN_REC_EC);
+  len = roundup_pow_of_two(min_t(unsigned int, record_size, RECORD_SIZE_MAX));
+  asus->record = kvcalloc(len, sizeof(*asus->record), GFP_KERNEL);
+  if (!asus->record) {
+    printk(KERN_INFO "asus-fan (record) - no memory for %u records, "
+                     "recording disabled\n",
+           len);
+    return;
+  }
+  asus->record_len = len;
+}
+
+static void record_call(struct asus_fan *asus, enum asus_fan_method method,
+                        int nargs, const u64 *arg, acpi_status status,
+                        u64 result, u64 start, u64 ns) {
+  struct asus_fan_acpi_rec rec = {};
+
+  if (!asus->record)
+    return;
+  rec.time_ns = start;
+  rec.result = result;
+  rec.duration_ns = min_t(u64, ns, U32_MAX);
+  rec.arg[0] = arg[0];
+  rec.arg[1] = arg[1];
+  rec.status = status;
+  rec.method = method;
+  rec.nargs = nargs;
+
+  spin_lock(&asus->record_lock);
+  rec.seq = asus->record_head;
+  asus->record[asus->record_head & (asus->record_len - 1)] = rec;
+  asus->record_head++;
+  spin_unlock(&asus->record_lock);
+}
+
+static ssize_t pwm_applied_show(struct device *dev,
+                                struct device_attribute *attr, char *buf) {
+  int fan = to_sensor_dev_attr_2(attr)->nr;
+  struct asus_fan *asus = dev_get_drvdata(dev);
+  int applied = READ_ONCE(asus->pwm_applied[fan]);
+  struct asus_fan_sample s;
+
+  // still (or again) in the firmware's hands, same estimate as pwmX
+  if (applied < 0) {
+    sample_get(asus, &s);
+    applied = calib_rpm_to_pwm(asus, fan, s.rpm[fan]);
+  }
+  return sprintf(buf, "%d\n", applied);
+}
+
+static int write_submit(struct asus_fan *asus,
+                        const struct asus_fan_write *req) {
+  int fan;
+
+  atomic_long_inc(&asus->write_queued);
+  if (READ_ONCE(sync_writes)) {
+    // what was queued before still goes first, with its own error
+    flush_work(&asus->write_work);
+    return write_apply_batch(asus, req, true);
+  }
+
+  spin_lock(&asus->write_lock);
+  if (req->set_auto) {
+    // auto-mode always applies to all fans, nothing before it matters
+    for (fan = 0; fan < 2; fan++) {
+      if (asus->write_pwm[fan] >= 0)
+        atomic_long_inc(&asus->write_superseded);
+      if (asus->write_mode[fan] >= 0)
+        atomic_long_inc(&asus->write_superseded);
+      asus->write_pwm[fan] = -1;
+      asus->write_mode[fan] = -1;
+    }
+    if (asus->write_auto)
+      atomic_long_inc(&asus->write_superseded);
+    asus->write_auto = true;
+  }
+  for (fan = 0; fan < 2; fan++) {
+    // the new speed leaves manual mode or the controller anyway
+    if (req->pwm[fan] >= 0) {
+      if (asus->write_pwm[fan] >= 0)
+        atomic_long_inc(&asus->write_superseded);
+      if (asus->write_mode[fan] >= 0)
+        atomic_long_inc(&asus->write_superseded);
+      asus->write_pwm[fan] = req->pwm[fan];
+      asus->write_mode[fan] = -1;
     }
-    *state = rpm *rpm * 100 / 10526316 + rpm * 1000 / 97276 + 26;
-    // ensure state is within a valid range
-    if (*state > 255) {
-      *state = 0;
+    // a pending pwm is applied first, the mode then keeps it
+    if (req->mode[fan] >= 0) {
+      if (asus->write_mode[fan] >= 0)
+        atomic_long_inc(&asus->write_superseded);
+      asus->write_mode[fan] = req->mode[fan];
     }
   }
+  if (req->max_speed >= 0) {
+    if (asus->write_max_speed >= 0)
+      atomic_long_inc(&asus->write_superseded);
+    asus->write_max_speed = req->max_speed;
+  }
+  spin_unlock(&asus->write_lock);
+  queue_work(asus->wq, &asus->write_work);
   return 0;
 }
 
-static int __fan_set_cur_state(int fan, unsigned long state) {
+static int write_request_pwm(struct asus_fan *asus, int fan, int pwm) {
+  int pwms[2] = {-1, -1};
 
-  // catch illegal state set
-  if (state > 255) {
-    printk(KERN_INFO "asus-fan (set pwm%d) - illegal value provided: %d \n",
-           fan, (unsigned int) state);
-    return 1;
-  }
-
-  fan_states[fan] = state;
-  fan_manual_mode[fan] = true;
-  return fan_set_speed(fan, state);
+  pwms[fan] = pwm;
+  return write_request_pwms(asus, pwms);
 }
 
-static int __fan_get_cur_control_state(int fan, int *state) {
-  *state = fan_manual_mode[fan];
-  return 0;
-}
+static int write_request_pwms(struct asus_fan *asus, const int *pwm) {
+  struct asus_fan_write req = WRITE_NONE;
 
-static int __fan_set_cur_control_state(int fan, int state) {
-  if (state == 0) {
-    return fan_set_auto();
-  }
-  return 0;
+  WRITE_ONCE(asus->watchdog_refresh, jiffies);
+  req.pwm[0] = pwm[0];
+  req.pwm[1] = pwm[1];
+  return write_submit(asus, &req);
 }
 
-static int fan_set_speed(int fan, int speed) {
-  // struct acpi_object_list params;
-  union acpi_object args[2];
-  unsigned long long value;
+static int write_request_mode(struct asus_fan *asus, int fan, int mode) {
+  struct asus_fan_write req = WRITE_NONE;
 
-  // set speed to 'speed' for given 'fan'-index
-  // -> automatically switch to manual mode!
-  params.count = ARRAY_SIZE(args);
-  params.pointer = args;
-  // Args:
-  // fan index
-  // - add '1' to index as '0' has a special meaning (auto-mode)
-  args[0].type = ACPI_TYPE_INTEGER;
-  args[0].integer.value = fan + 1;
-  // target fan speed
-  // - between 0x00 and MAX (0 - MAX)
-  //   - 'MAX' is usually 0xFF (255)
-  //   - should be getable with fan_get_max_speed()
-  args[1].type = ACPI_TYPE_INTEGER;
-  args[1].integer.value = speed;
-  // acpi call
-  return acpi_evaluate_integer(NULL, "\\_SB.PCI0.LPCB.EC0.SFNV", &params,
-                               &value);
+  WRITE_ONCE(asus->watchdog_refresh, jiffies);
+  if (mode == FAN_MODE_AUTO)
+    req.set_auto = true;
+  else
+    req.mode[fan] = mode;
+  return write_submit(asus, &req);
 }
 
-static int __fan_rpm(int fan) {
-  struct acpi_object_list params;
-  union acpi_object args[1];
-  unsigned long long value;
-  acpi_status ret;
-
-  // fan does not report during manual speed setting - so fake it!
-  if (fan_manual_mode[fan]) {
-    value = fan_states[fan] * fan_states[fan] * 1000 / -16054 +
-            fan_states[fan] * 32648 / 1000 - 365;
-    if (value > 10000)
-      return 0;
-  } else {
+static int write_request_max_speed(struct asus_fan *asus, int max_speed) {
+  struct asus_fan_write req = WRITE_NONE;
 
-    // getting current fan 'speed' as 'state',
-    params.count = ARRAY_SIZE(args);
-    params.pointer = args;
-    // Args:
-    // - get speed from the fan with index 'fan'
-    args[0].type = ACPI_TYPE_INTEGER;
-    args[0].integer.value = fan;
+  req.max_speed = max_speed;
+  return write_submit(asus, &req);
+}
 
-    // acpi call
-    ret = acpi_evaluate_integer(NULL, "\\_SB.PCI0.LPCB.EC0.TACH", &params,
-                                &value);
-    if (ret != AE_OK)
-      return -1;
+static int write_apply(struct asus_fan *asus) {
+  struct asus_fan_write req;
+  int fan;
+
+  spin_lock(&asus->write_lock);
+  req.set_auto = asus->write_auto;
+  req.max_speed = asus->write_max_speed;
+  asus->write_auto = false;
+  asus->write_max_speed = -1;
+  for (fan = 0; fan < 2; fan++) {
+    req.pwm[fan] = asus->write_pwm[fan];
+    req.mode[fan] = asus->write_mode[fan];
+    asus->write_pwm[fan] = -1;
+    asus->write_mode[fan] = -1;
   }
-  return (int)value;
+  spin_unlock(&asus->write_lock);
+  // taken by an earlier run already
+  if (!req.set_auto && req.max_speed < 0 && req.pwm[0] < 0 &&
+      req.pwm[1] < 0 && req.mode[0] < 0 && req.mode[1] < 0)
+    return 0;
+  return write_apply_batch(asus, &req, false);
 }
-static ssize_t fan_rpm(struct device *dev, struct device_attribute *attr,
-                       char *buf) {
-  return sprintf(buf, "%d\n", __fan_rpm(0));
+
+static int write_apply_batch(struct asus_fan *asus,
+                             const struct asus_fan_write *req, bool sync) {
+  bool release[2] = {false, false};
+  int fan, ret, err = 0;
+
+  mutex_lock(&asus->lock);
+  if (req->set_auto) {
+    if (__fan_set_auto(asus))
+      err = -EIO;
+    release[0] = release[1] = true;
+  }
+  for (fan = 0; fan < 2; fan++) {
+    // a manually set speed overrides the included controller
+    if (req->pwm[fan] >= 0) {
+      if (sync)
+        ret = __fan_set_cur_state_now(asus, fan, req->pwm[fan]);
+      else
+        ret = __fan_set_cur_state(asus, fan, req->pwm[fan], false);
+      if (ret && !err)
+        err = -EIO;
+      release[fan] = true;
+    }
+    if (req->mode[fan] >= 0) {
+      ret = __fan_set_cur_control_state(asus, fan, req->mode[fan]);
+      if (ret < 0 && !err)
+        err = ret;
+      release[fan] = true;
+    }
+  }
+  if (req->max_speed >= 0 &&
+      __fan_set_max_speed(asus, req->max_speed, req->max_speed == 256) &&
+      !err)
+    err = -EIO;
+  // the user takes over from the thermal core
+  for (fan = 0; fan < 2; fan++) {
+    if (!release[fan])
+      continue;
+    WRITE_ONCE(asus->cooling[fan].state, 0);
+    asus->cooling[fan].waiting = false;
+  }
+  mutex_unlock(&asus->lock);
+
+  atomic_long_inc(&asus->write_applied);
+  if (err) {
+    atomic_long_inc(&asus->write_failed);
+    printk(KERN_INFO "asus-fan (write) - applying a pwm, mode or max speed "
+                     "write failed! errcode: %d\n",
+           err);
+  }
+  WRITE_ONCE(asus->write_error, err);
+  return err;
 }
-static ssize_t fan_rpm_gfx(struct device *dev, struct device_attribute *attr,
-                           char *buf) {
-  return sprintf(buf, "%d\n", __fan_rpm(1));
+
+static void write_work_fn(struct work_struct *work) {
+  struct asus_fan *asus = container_of(work, struct asus_fan, write_work);
+
+  write_apply(asus);
 }
 
-static ssize_t fan_get_cur_state(struct device *dev,
-                                 struct device_attribute *attr, char *buf) {
-  unsigned long state = 0;
-  __fan_get_cur_state(0, &state);
-  return sprintf(buf, "%lu\n", state);
+static ssize_t write_error_show(struct device *dev,
+                                struct device_attribute *attr, char *buf) {
+  struct asus_fan *asus = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%d\n", READ_ONCE(asus->write_error));
 }
 
-static ssize_t fan_get_cur_state_gfx(struct device *dev,
-                                     struct device_attribute *attr, char *buf) {
-  unsigned long state = 0;
-  __fan_get_cur_state(1, &state);
-  return sprintf(buf, "%lu\n", state);
+static ssize_t curve_point_pwm_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf) {
+  struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+  struct asus_fan *asus = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%d\n",
+                 READ_ONCE(asus->curve_pwm[sattr->nr][sattr->index]));
 }
 
-static ssize_t fan_set_cur_state_gfx(struct device *dev,
+static ssize_t curve_point_pwm_store(struct device *dev,
                                      struct device_attribute *attr,
                                      const char *buf, size_t count) {
-  int state;
-  kstrtouint(buf, 10, &state);
-  __fan_set_cur_state(1, state);
-  return count;
-}
+  struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+  struct asus_fan *asus = dev_get_drvdata(dev);
+  unsigned int pwm;
+  int err;
 
-static ssize_t fan_set_cur_state(struct device *dev,
-                                 struct device_attribute *attr, const char *buf,
-                                 size_t count) {
-  int state;
-  kstrtouint(buf, 10, &state);
-  __fan_set_cur_state(0, state);
+  err = kstrtouint(buf, 10, &pwm);
+  if (err)
+    return err;
+  if (pwm > 255)
+    return -EINVAL;
+  mutex_lock(&asus->lock);
+  WRITE_ONCE(asus->curve_pwm[sattr->nr][sattr->index], pwm);
+  mutex_unlock(&asus->lock);
   return count;
 }
 
-static ssize_t fan_get_cur_control_state(struct device *dev,
-                                         struct device_attribute *attr,
-                                         char *buf) {
-  int state = 0;
-  __fan_get_cur_control_state(0, &state);
-  return sprintf(buf, "%d\n", state);
-}
+static ssize_t curve_point_temp_show(struct device *dev,
+                                     struct device_attribute *attr, char *buf) {
+  struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+  struct asus_fan *asus = dev_get_drvdata(dev);
 
-static ssize_t fan_get_cur_control_state_gfx(struct device *dev,
-                                             struct device_attribute *attr,
-                                             char *buf) {
-  int state = 0;
-  __fan_get_cur_control_state(1, &state);
-  return sprintf(buf, "%d\n", state);
+  return sprintf(buf, "%d\n",
+                 READ_ONCE(asus->curve_temp[sattr->nr][sattr->index]));
 }
 
-static ssize_t fan_set_cur_control_state_gfx(struct device *dev,
-                                             struct device_attribute *attr,
-                                             const char *buf, size_t count) {
-  int state;
-  kstrtouint(buf, 10, &state);
-  __fan_set_cur_control_state(1, state);
-  return count;
-}
+static ssize_t curve_point_temp_store(struct device *dev,
+                                      struct device_attribute *attr,
+                                      const char *buf, size_t count) {
+  struct sensor_device_attribute_2 *sattr = to_sensor_dev_attr_2(attr);
+  struct asus_fan *asus = dev_get_drvdata(dev);
+  unsigned int temp;
+  int err;
 
-static ssize_t fan_set_cur_control_state(struct device *dev,
-                                         struct device_attribute *attr,
-                                         const char *buf, size_t count) {
-  int state;
-  kstrtouint(buf, 10, &state);
-  __fan_set_cur_control_state(0, state);
+  err = kstrtouint(buf, 10, &temp);
+  if (err)
+    return err;
+  if (temp > TEMP1_CRIT * 1000)
+    return -EINVAL;
+  mutex_lock(&asus->lock);
+  WRITE_ONCE(asus->curve_temp[sattr->nr][sattr->index], temp);
+  mutex_unlock(&asus->lock);
   return count;
 }
 
 // Reading the correct max fan speed does not work!
 // Setting a max value has the obvious effect, thus we 'fake'
 // the 'get_max' function
-static int fan_get_max_speed(unsigned long *state) {
+static int fan_get_max_speed(struct asus_fan *asus, unsigned long *state) {
 
-  *state = max_fan_speed_setting;
+  *state = READ_ONCE(asus->max_speed);
   return 0;
 }
 
-static int fan_set_max_speed(unsigned long state, bool reset) {
+static int fan_set_max_speed(struct asus_fan *asus, unsigned long state,
+                             bool reset) {
+  int ret;
+
+  mutex_lock(&asus->lock);
+  ret = __fan_set_max_speed(asus, state, reset);
+  mutex_unlock(&asus->lock);
+  return ret;
+}
+
+static int __fan_set_max_speed(struct asus_fan *asus, unsigned long state,
+                               bool reset) {
+  struct acpi_object_list params;
   union acpi_object args[1];
   unsigned long long value;
   acpi_status ret;
   int arg_qmod = 1;
 
+  lockdep_assert_held(&asus->lock);
   // if reset is 'true' ignore anything else and reset to
   // -> auto-mode with max-speed
   // -> use "SB.ARKD.QMOD" _without_ "SB.QFAN",
@@ -457,7 +3000,7 @@ static int fan_set_max_speed(unsigned long state, bool reset) {
     args[0].integer.value = arg_qmod;
 
     // acpi call
-    ret = acpi_evaluate_integer(NULL, "\\_SB.ATKD.QMOD", &params, &value);
+    ret = asus_fan_eval(asus, METHOD_QMOD, &params, &value);
     if (ret != AE_OK) {
       printk(KERN_INFO
              "asus-fan (set_max_speed) - set max fan speed(s) failed (force "
@@ -479,8 +3022,7 @@ static int fan_set_max_speed(unsigned long state, bool reset) {
     args[0].integer.value = state;
 
     // acpi call
-    ret = acpi_evaluate_integer(NULL, "\\_SB.PCI0.LPCB.EC0.ST98", &params,
-                                &value);
+    ret = asus_fan_eval(asus, METHOD_ST98, &params, &value);
     if (ret != AE_OK) {
       printk(KERN_INFO
              "asus-fan (set_max_speed) - set max fan speed(s) failed (no "
@@ -491,22 +3033,34 @@ static int fan_set_max_speed(unsigned long state, bool reset) {
   }
 
   // keep set max fan speed for the get_max
-  max_fan_speed_setting = state;
+  WRITE_ONCE(asus->max_speed, state);
+  status_page_update(asus);
+  return ret;
+}
+
+static int fan_set_auto(struct asus_fan *asus) {
+  int ret;
 
+  mutex_lock(&asus->lock);
+  ret = __fan_set_auto(asus);
+  mutex_unlock(&asus->lock);
   return ret;
 }
 
-static int fan_set_auto() {
+static int __fan_set_auto(struct asus_fan *asus) {
+  struct acpi_object_list params;
   union acpi_object args[2];
   unsigned long long value;
   acpi_status ret;
+  int fan;
+
+  lockdep_assert_held(&asus->lock);
 
   // setting (both) to auto-mode simultanously
-  fan_manual_mode[0] = false;
-  fan_states[0] = -1;
-  if (has_gfx_fan) {
-    fan_states[1] = -1;
-    fan_manual_mode[1] = false;
+  // - the included controller stops on its own without curve mode
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1); fan++) {
+    fan_state_set(asus, fan, -1, false, false);
+    WRITE_ONCE(asus->pwm_applied[fan], -1);
   }
 
   // acpi call to call auto-mode for all fans!
@@ -520,8 +3074,7 @@ static int fan_set_auto() {
   args[1].integer.value = 0;
 
   // acpi call
-  ret =
-      acpi_evaluate_integer(NULL, "\\_SB.PCI0.LPCB.EC0.SFNV", &params, &value);
+  ret = asus_fan_eval(asus, METHOD_SFNV, &params, &value);
   if (ret != AE_OK) {
     printk(KERN_INFO
            "asus-fan (set_auto) - failed reseting fan(s) to auto-mode! "
@@ -533,260 +3086,1091 @@ static int fan_set_auto() {
   return ret;
 }
 
-static ssize_t fan_label(struct device *dev, struct device_attribute *attr,
-                         char *buf) {
-  return sprintf(buf, "%s\n", fan_desc);
+static ssize_t set_max_speed(struct device *dev, struct device_attribute *attr,
+                             const char *buf, size_t count) {
+  unsigned int state;
+  int ret;
+
+  ret = kstrtouint(buf, 10, &state);
+  if (ret)
+    return ret;
+  // 256 - reset to the firmware's max speed
+  if (state > 256)
+    return -EINVAL;
+  ret = write_request_max_speed(dev_get_drvdata(dev), state);
+  return ret ? ret : count;
 }
 
-static ssize_t fan_label_gfx(struct device *dev, struct device_attribute *attr,
+static ssize_t get_max_speed(struct device *dev, struct device_attribute *attr,
                              char *buf) {
-  return sprintf(buf, "%s\n", gfx_fan_desc);
+  unsigned long state = 0;
+  fan_get_max_speed(dev_get_drvdata(dev), &state);
+  return sprintf(buf, "%lu\n", state);
 }
 
-static ssize_t fan_min(struct device *dev, struct device_attribute *attr,
-                       char *buf) {
-  return sprintf(buf, "%d\n", fan_minimum);
+static umode_t asus_fan_hwmon_is_visible(const void *data,
+                                         enum hwmon_sensor_types type,
+                                         u32 attr, int channel) {
+  const struct asus_fan *asus = data;
+
+  switch (type) {
+    case hwmon_chip:
+      return S_IWUSR | S_IRUGO;
+    case hwmon_temp:
+      // hide what the firmware can not provide
+      if (!test_bit(METHOD_TH1R, &asus->method_caps))
+        return 0;
+      return S_IRUGO;
+    case hwmon_fan:
+      if (channel > 0 && !asus->has_gfx_fan)
+        return 0;
+      return S_IRUGO;
+    case hwmon_pwm:
+      if (channel > 0 && !asus->has_gfx_fan)
+        return 0;
+      return S_IWUSR | S_IRUGO;
+    default:
+      return 0;
+  }
 }
 
-static ssize_t fan_min_gfx(struct device *dev, struct device_attribute *attr,
-                           char *buf) {
-  return sprintf(buf, "%d\n", fan_minimum_gfx);
+static int asus_fan_hwmon_read(struct device *dev,
+                               enum hwmon_sensor_types type, u32 attr,
+                               int channel, long *val) {
+  struct asus_fan *asus = dev_get_drvdata(dev);
+  struct asus_fan_sample s;
+  unsigned long state;
+  int mode;
+
+  switch (type) {
+    case hwmon_chip:
+      if (attr != hwmon_chip_update_interval)
+        break;
+      *val = READ_ONCE(asus->update_interval);
+      return 0;
+    case hwmon_temp:
+      if (attr == hwmon_temp_input) {
+        sample_get(asus, &s);
+        *val = s.temp * 1000;
+        return 0;
+      }
+      if (attr == hwmon_temp_crit) {
+        *val = TEMP1_CRIT * 1000;
+        return 0;
+      }
+      if (attr == hwmon_temp_crit_alarm) {
+        sample_get(asus, &s);
+        *val = !!(s.alarms & BIT(ALARM_TEMP_CRIT));
+        return 0;
+      }
+      break;
+    case hwmon_fan:
+      if (attr == hwmon_fan_input) {
+        sample_get(asus, &s);
+        *val = s.rpm[channel];
+        return 0;
+      }
+      if (attr == hwmon_fan_min) {
+        *val = FAN_MIN;
+        return 0;
+      }
+      if (attr == hwmon_fan_alarm) {
+        sample_get(asus, &s);
+        *val = !!(s.alarms & BIT(ALARM_FAN(channel)));
+        return 0;
+      }
+      break;
+    case hwmon_pwm:
+      if (attr == hwmon_pwm_input) {
+        __fan_get_cur_state(asus, channel, &state);
+        *val = state;
+        return 0;
+      }
+      if (attr == hwmon_pwm_enable) {
+        __fan_get_cur_control_state(asus, channel, &mode);
+        *val = mode;
+        return 0;
+      }
+      break;
+    default:
+      break;
+  }
+  return -EOPNOTSUPP;
 }
 
-static ssize_t set_max_speed(struct device *dev, struct device_attribute *attr,
-                             const char *buf, size_t count) {
-  int state;
-  bool reset = false;
-  kstrtouint(buf, 10, &state);
-  if (state == 256) {
-    reset = true;
+static int asus_fan_hwmon_read_string(struct device *dev,
+                                      enum hwmon_sensor_types type, u32 attr,
+                                      int channel, const char **str) {
+  if (type == hwmon_temp && attr == hwmon_temp_label) {
+    *str = TEMP1_LABEL;
+    return 0;
   }
-  fan_set_max_speed(state, reset);
-  return count;
+  if (type == hwmon_fan && attr == hwmon_fan_label) {
+    *str = fan_labels[channel];
+    return 0;
+  }
+  return -EOPNOTSUPP;
 }
 
-static ssize_t get_max_speed(struct device *dev, struct device_attribute *attr,
-                             char *buf) {
-  unsigned long state = 0;
-  fan_get_max_speed(&state);
-  return sprintf(buf, "%lu\n", state);
+static int asus_fan_hwmon_write(struct device *dev,
+                                enum hwmon_sensor_types type, u32 attr,
+                                int channel, long val) {
+  struct asus_fan *asus = dev_get_drvdata(dev);
+  unsigned int interval;
+
+  switch (type) {
+    case hwmon_chip:
+      if (attr != hwmon_chip_update_interval)
+        break;
+      interval = clamp_val(val, UPDATE_INTERVAL_MIN, UPDATE_INTERVAL_MAX);
+      WRITE_ONCE(asus->update_interval, interval);
+      // apply at once, instead of after the (maybe long) pending interval
+      if (test_bit(0, &asus->sampler_running))
+        mod_delayed_work(system_wq, &asus->sampler_work,
+                         msecs_to_jiffies(interval));
+      return 0;
+    case hwmon_pwm:
+      if (attr == hwmon_pwm_input) {
+        if (val < 0 || val > 255)
+          return -EINVAL;
+        return write_request_pwm(asus, channel, val);
+      }
+      if (attr == hwmon_pwm_enable) {
+        // everything the ec could refuse later is checked here already
+        if (val == FAN_MODE_CURVE &&
+            !test_bit(METHOD_TH1R, &asus->method_caps))
+          return -ENODEV;
+        if (val != FAN_MODE_AUTO && val != FAN_MODE_MANUAL &&
+            val != FAN_MODE_CURVE)
+          return -EINVAL;
+        return write_request_mode(asus, channel, val);
+      }
+      break;
+    default:
+      break;
+  }
+  return -EOPNOTSUPP;
 }
 
-static ssize_t temp1_input(struct device *dev, struct device_attribute *attr,
-                           char *buf) {
-    acpi_status ret;
-    unsigned long long int value;
+// standard hwmon channels - the gfx ones are hidden without a gfx fan
+static const struct hwmon_channel_info *const asus_fan_hwmon_info[] = {
+    HWMON_CHANNEL_INFO(chip, HWMON_C_UPDATE_INTERVAL),
+    HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_LABEL | HWMON_T_CRIT |
+                                 HWMON_T_CRIT_ALARM),
+    HWMON_CHANNEL_INFO(fan,
+                       HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN |
+                           HWMON_F_ALARM,
+                       HWMON_F_INPUT | HWMON_F_LABEL | HWMON_F_MIN |
+                           HWMON_F_ALARM),
+    HWMON_CHANNEL_INFO(pwm, HWMON_PWM_INPUT | HWMON_PWM_ENABLE,
+                       HWMON_PWM_INPUT | HWMON_PWM_ENABLE),
+    NULL};
 
-    // acpi call
-    ret = acpi_evaluate_integer(NULL, "\\_SB.PCI0.LPCB.EC0.TH1R", NULL, &value);
+static const struct hwmon_ops asus_fan_hwmon_ops = {
+    .is_visible = asus_fan_hwmon_is_visible,
+    .read = asus_fan_hwmon_read,
+    .read_string = asus_fan_hwmon_read_string,
+    .write = asus_fan_hwmon_write,
+};
 
-    return sprintf(buf, "%llud\n", value*1000);
-}
+static const struct hwmon_chip_info asus_fan_chip_info = {
+    .ops = &asus_fan_hwmon_ops,
+    .info = asus_fan_hwmon_info,
+};
 
-static ssize_t temp1_label(struct device *dev, struct device_attribute *attr,
-                           char *buf) {
-  return sprintf(buf, "%s\n", TEMP1_LABEL);
+// non-standard hwmon attributes
+static DEVICE_ATTR(fan1_speed_max, S_IWUSR | S_IRUGO, get_max_speed,
+                   set_max_speed);
+
+// pwm written to the ec, lags behind pwmX while ramping
+static SENSOR_DEVICE_ATTR_2(pwm1_applied, S_IRUGO, pwm_applied_show, NULL, 0,
+                            0);
+static SENSOR_DEVICE_ATTR_2(pwm2_applied, S_IRUGO, pwm_applied_show, NULL, 1,
+                            0);
+
+// 0 or the error of the last queued pwmX, pwmX_enable or fan1_speed_max write
+static SENSOR_DEVICE_ATTR_2(write_error, S_IRUGO, write_error_show, NULL, 0,
+                            0);
+
+// curve points of the included fan controller
+#define CURVE_POINT_ATTRS(pwm, fan, point)                                  \
+  static SENSOR_DEVICE_ATTR_2(pwm##_auto_point##point##_pwm,                \
+                              S_IWUSR | S_IRUGO, curve_point_pwm_show,      \
+                              curve_point_pwm_store, fan, point - 1);       \
+  static SENSOR_DEVICE_ATTR_2(pwm##_auto_point##point##_temp,               \
+                              S_IWUSR | S_IRUGO, curve_point_temp_show,     \
+                              curve_point_temp_store, fan, point - 1)
+
+CURVE_POINT_ATTRS(pwm1, 0, 1);
+CURVE_POINT_ATTRS(pwm1, 0, 2);
+CURVE_POINT_ATTRS(pwm1, 0, 3);
+CURVE_POINT_ATTRS(pwm1, 0, 4);
+CURVE_POINT_ATTRS(pwm1, 0, 5);
+CURVE_POINT_ATTRS(pwm2, 1, 1);
+CURVE_POINT_ATTRS(pwm2, 1, 2);
+CURVE_POINT_ATTRS(pwm2, 1, 3);
+CURVE_POINT_ATTRS(pwm2, 1, 4);
+CURVE_POINT_ATTRS(pwm2, 1, 5);
+
+#define CURVE_POINT_ATTR_REFS(pwm, point)                                   \
+  &sensor_dev_attr_##pwm##_auto_point##point##_pwm.dev_attr.attr,           \
+      &sensor_dev_attr_##pwm##_auto_point##point##_temp.dev_attr.attr
+
+// max speed, applied pwm, write status and the curve points of the included
+// fan controller
+static struct attribute *hwmon_extra_attributes[] = {
+    &dev_attr_fan1_speed_max.attr,
+    &sensor_dev_attr_pwm1_applied.dev_attr.attr,
+    &sensor_dev_attr_pwm2_applied.dev_attr.attr,
+    &sensor_dev_attr_write_error.dev_attr.attr,
+
+    CURVE_POINT_ATTR_REFS(pwm1, 1),
+    CURVE_POINT_ATTR_REFS(pwm1, 2),
+    CURVE_POINT_ATTR_REFS(pwm1, 3),
+    CURVE_POINT_ATTR_REFS(pwm1, 4),
+    CURVE_POINT_ATTR_REFS(pwm1, 5),
+    CURVE_POINT_ATTR_REFS(pwm2, 1),
+    CURVE_POINT_ATTR_REFS(pwm2, 2),
+    CURVE_POINT_ATTR_REFS(pwm2, 3),
+    CURVE_POINT_ATTR_REFS(pwm2, 4),
+    CURVE_POINT_ATTR_REFS(pwm2, 5),
+    NULL};
+
+// platform device attributes (/sys/devices/platform/asus_fan)
+static struct attribute *platform_attributes[] = {NULL};
+
+static struct bin_attribute bin_attr_fan1_calibration = {
+    .attr = {.name = "fan1_calibration", .mode = S_IWUSR | S_IRUGO},
+    .size = CALIB_BLOB_SIZE,
+    .read = calib_read,
+    .write = calib_write,
+    .private = (void *)0,
+};
+static struct bin_attribute bin_attr_fan2_calibration = {
+    .attr = {.name = "fan2_calibration", .mode = S_IWUSR | S_IRUGO},
+    .size = CALIB_BLOB_SIZE,
+    .read = calib_read,
+    .write = calib_write,
+    .private = (void *)1,
+};
+static struct bin_attribute *platform_bin_attributes[] = {
+    &bin_attr_fan1_calibration, &bin_attr_fan2_calibration, NULL};
+
+// second fan's table only if there is a second fan
+static umode_t platform_bin_is_visible(struct kobject *kobj,
+                                       struct bin_attribute *attr, int idx) {
+  struct asus_fan *asus = dev_get_drvdata(kobj_to_dev(kobj));
+
+  if (attr == &bin_attr_fan2_calibration && !asus->has_gfx_fan)
+    return 0;
+  return attr->attr.mode;
 }
 
-static ssize_t temp1_crit(struct device *dev, struct device_attribute *attr,
-                           char *buf) {
-  return sprintf(buf, "%d\n", TEMP1_CRIT);
+static struct attribute_group platform_attribute_group = {
+    .attrs = platform_attributes,
+    .bin_attrs = platform_bin_attributes,
+    .is_bin_visible = platform_bin_is_visible};
+
+// without ST98 there is no max speed, without gfx fan no second curve
+static umode_t asus_fan_extra_is_visible(struct kobject *kobj,
+                                         struct attribute *attr, int idx) {
+  struct asus_fan *asus = dev_get_drvdata(kobj_to_dev(kobj));
+  struct device_attribute *dattr;
+
+  if (attr == &dev_attr_fan1_speed_max.attr)
+    return test_bit(METHOD_ST98, &asus->method_caps) ? attr->mode : 0;
+  dattr = container_of(attr, struct device_attribute, attr);
+  if (to_sensor_dev_attr_2(dattr)->nr > 0 && !asus->has_gfx_fan)
+    return 0;
+  return attr->mode;
 }
 
+static struct attribute_group hwmon_extra_attribute_group = {
+    .is_visible = asus_fan_extra_is_visible, .attrs = hwmon_extra_attributes};
+__ATTRIBUTE_GROUPS(hwmon_extra_attribute);
 
+static int asus_fan_hwmon_init(struct asus_fan *asus) {
+  struct device *hwmon;
 
-// Makros defining all possible hwmon attributes
-static DEVICE_ATTR(pwm1, S_IWUSR | S_IRUGO, fan_get_cur_state,
-                   fan_set_cur_state);
-static DEVICE_ATTR(pwm1_enable, S_IWUSR | S_IRUGO, fan_get_cur_control_state,
-                   fan_set_cur_control_state);
-static DEVICE_ATTR(fan1_min, S_IRUGO, fan_min, NULL);
-static DEVICE_ATTR(fan1_input, S_IRUGO, fan_rpm, NULL);
-static DEVICE_ATTR(fan1_label, S_IRUGO, fan_label, NULL);
+  // first snapshot, so no reader ever sees an empty one
+  sample_refresh(asus);
 
-static DEVICE_ATTR(fan1_speed_max, S_IWUSR | S_IRUGO, get_max_speed,
-                   set_max_speed);
+  hwmon = hwmon_device_register_with_info(
+      &asus->platform_device->dev, "asus_fan", asus, &asus_fan_chip_info,
+      hwmon_extra_attribute_groups);
+  if (IS_ERR(hwmon)) {
+    pr_err("Could not register asus hwmon device\n");
+    return PTR_ERR(hwmon);
+  }
+  asus->hwmon_dev = hwmon;
 
-static DEVICE_ATTR(pwm2, S_IWUSR | S_IRUGO, fan_get_cur_state_gfx,
-                   fan_set_cur_state_gfx);
-static DEVICE_ATTR(pwm2_enable, S_IWUSR | S_IRUGO,
-                   fan_get_cur_control_state_gfx,
-                   fan_set_cur_control_state_gfx);
-static DEVICE_ATTR(fan2_min, S_IRUGO, fan_min_gfx, NULL);
-static DEVICE_ATTR(fan2_input, S_IRUGO, fan_rpm_gfx, NULL);
-static DEVICE_ATTR(fan2_label, S_IRUGO, fan_label_gfx, NULL);
-
-static DEVICE_ATTR(temp1_input, S_IRUGO, temp1_input, NULL);
-static DEVICE_ATTR(temp1_label, S_IRUGO, temp1_label, NULL);
-static DEVICE_ATTR(temp1_crit, S_IRUGO, temp1_crit, NULL);
-
-// hwmon attributes without second fan
-static struct attribute *hwmon_attributes[] = {
-    &dev_attr_pwm1.attr,           &dev_attr_pwm1_enable.attr,
-    &dev_attr_fan1_min.attr,       &dev_attr_fan1_input.attr,
-    &dev_attr_fan1_label.attr,
+  // from now on changes are announced, even without anybody reading
+  WRITE_ONCE(asus->notify, true);
+  if (sampler_idle_interval(asus))
+    schedule_delayed_work(&asus->sampler_work,
+                          msecs_to_jiffies(sampler_idle_interval(asus)));
+  return 0;
+}
 
-    &dev_attr_fan1_speed_max.attr,
+static void asus_fan_sysfs_exit(struct platform_device *device) {
+  sysfs_remove_group(&device->dev.kobj, &platform_attribute_group);
+}
 
-    &dev_attr_temp1_input.attr,
-    &dev_attr_temp1_label.attr,
-    &dev_attr_temp1_crit.attr,
-    NULL};
+static int methods_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  long calls, total = 0;
+  int i;
+
+  seq_printf(m, "%-6s %-26s %-9s %s\n", "method", "path", "available",
+             "calls");
+  for (i = 0; i < METHOD_COUNT; i++) {
+    calls = atomic_long_read(&asus->method_calls[i]);
+    total += calls;
+    seq_printf(m, "%-6s %-26s %-9d %ld\n", method_names[i],
+               method_paths[i],
+               test_bit(i, &asus->method_caps), calls);
+  }
+  seq_printf(m, "namespace lookups: %u (saved: %ld)\n", asus->method_lookups,
+             total);
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(methods);
+
+static int acpi_latency_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  long hist[ACPI_HIST_BUCKETS], count;
+  int i, b;
+
+  seq_printf(m, "%-6s %-9s %-7s %-9s %s\n", "method", "calls", "errors",
+             "avg_us", "max_us");
+  for (i = 0; i < LATENCY_COUNT; i++) {
+    for (count = 0, b = 0; b < ACPI_HIST_BUCKETS; b++)
+      count += atomic_long_read(&asus->method_hist[i][b]);
+    seq_printf(m, "%-6s %-9ld %-7ld %-9llu %llu\n", method_names[i], count,
+               atomic_long_read(&asus->method_errors[i]),
+               count ? div64_u64(atomic64_read(&asus->method_ns[i]),
+                                 (u64)count * NSEC_PER_USEC)
+                     : 0,
+               div_u64(atomic64_read(&asus->method_max_ns[i]),
+                       NSEC_PER_USEC));
+  }
+
+  // histograms of all called methods, empty buckets left out
+  for (i = 0; i < LATENCY_COUNT; i++) {
+    for (count = 0, b = 0; b < ACPI_HIST_BUCKETS; b++)
+      count += hist[b] = atomic_long_read(&asus->method_hist[i][b]);
+    if (!count)
+      continue;
+    seq_printf(m, "\n%s latency (us):\n", method_names[i]);
+    for (b = 0; b < ACPI_HIST_BUCKETS; b++) {
+      if (!hist[b])
+        continue;
+      if (b == 0)
+        seq_printf(m, "  %8s %-8s %ld\n", "", "< 1", hist[b]);
+      else if (b == ACPI_HIST_BUCKETS - 1)
+        seq_printf(m, "  %8s %-8lu %ld\n", ">=", 1UL << (b - 1), hist[b]);
+      else
+        seq_printf(m, "  %8lu %-8lu %ld\n", 1UL << (b - 1), 1UL << b,
+                   hist[b]);
+    }
+  }
+  return 0;
+}
 
-// hwmon attributes with second fan
-static struct attribute *hwmon_gfx_attributes[] = {
-    &dev_attr_pwm1.attr,           &dev_attr_pwm1_enable.attr,
-    &dev_attr_fan1_min.attr,       &dev_attr_fan1_input.attr,
-    &dev_attr_fan1_label.attr,
+static int acpi_latency_open(struct inode *inode, struct file *file) {
+  return single_open(file, acpi_latency_show, inode->i_private);
+}
 
-    &dev_attr_fan1_speed_max.attr,
+// any write starts all statistics over
+static ssize_t acpi_latency_write(struct file *file, const char __user *ubuf,
+                                  size_t count, loff_t *ppos) {
+  struct asus_fan *asus = ((struct seq_file *)file->private_data)->private;
+  int i, b;
+
+  for (i = 0; i < LATENCY_COUNT; i++) {
+    for (b = 0; b < ACPI_HIST_BUCKETS; b++)
+      atomic_long_set(&asus->method_hist[i][b], 0);
+    atomic64_set(&asus->method_ns[i], 0);
+    atomic64_set(&asus->method_max_ns[i], 0);
+    atomic_long_set(&asus->method_errors[i], 0);
+  }
+  return count;
+}
+
+static const struct file_operations acpi_latency_fops = {
+    .owner = THIS_MODULE,
+    .open = acpi_latency_open,
+    .read = seq_read,
+    .write = acpi_latency_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static int pwm_stats_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  int fan;
+
+  seq_printf(m, "%-4s %-10s %-12s %-10s %s\n", "fan", "received",
+             "deduplicated", "coalesced", "ec_writes");
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1); fan++)
+    seq_printf(m, "%-4d %-10ld %-12ld %-10ld %ld\n", fan + 1,
+               atomic_long_read(&asus->pwm_received[fan]),
+               atomic_long_read(&asus->pwm_deduplicated[fan]),
+               atomic_long_read(&asus->pwm_coalesced[fan]),
+               atomic_long_read(&asus->pwm_ec_writes[fan]));
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(pwm_stats);
+
+static int write_stats_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+
+  seq_printf(m, "%-11s %ld\n", "queued",
+             atomic_long_read(&asus->write_queued));
+  seq_printf(m, "%-11s %ld\n", "superseded",
+             atomic_long_read(&asus->write_superseded));
+  seq_printf(m, "%-11s %ld\n", "applied",
+             atomic_long_read(&asus->write_applied));
+  seq_printf(m, "%-11s %ld\n", "failed",
+             atomic_long_read(&asus->write_failed));
+  seq_printf(m, "%-11s %d\n", "last_error", READ_ONCE(asus->write_error));
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(write_stats);
 
-    &dev_attr_pwm2.attr,           &dev_attr_pwm2_enable.attr,
-    &dev_attr_fan2_min.attr,       &dev_attr_fan2_input.attr,
-    &dev_attr_fan2_label.attr,     
+static int watchdog_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  const char *reason = READ_ONCE(asus->watchdog_reason);
 
-    &dev_attr_temp1_input.attr,
-    &dev_attr_temp1_label.attr,
-    &dev_attr_temp1_crit.attr,
-    NULL};
+  seq_printf(m, "%-7s %ld\n", "trips", atomic_long_read(&asus->watchdog_trips));
+  seq_printf(m, "%-7s %s\n", "last", reason ?: "-");
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(watchdog);
+
+static int init_timing_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  s64 total = 0;
+  int i;
+
+  seq_printf(m, "%-12s %s\n", "step", "us");
+  seq_printf(m, "%-12s %lld\n", "module_init", asus->driver->init_us);
+  for (i = 0; i < INIT_STEP_COUNT; i++) {
+    seq_printf(m, "%-12s %lld\n", init_step_names[i], asus->init_us[i]);
+    if (i != INIT_QUEUED)
+      total += asus->init_us[i];
+  }
+  seq_printf(m, "%-12s %lld\n", "probe", total);
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(init_timing);
+
+static int calibrate_show(struct seq_file *m, void *v) {
+  static const char *const states[] = {
+      [CALIB_IDLE] = "idle", [CALIB_RUNNING] = "running",
+      [CALIB_DONE] = "done", [CALIB_ABORTED] = "aborted",
+      [CALIB_FAILED] = "failed"};
+  struct asus_fan *asus = m->private;
+  struct asus_fan_calib_run *run = &asus->calib_run;
+  int i;
+
+  mutex_lock(&asus->calib_run_lock);
+  seq_printf(m, "state: %s\n", states[run->state]);
+  if (run->state != CALIB_IDLE) {
+    seq_printf(m, "fan: %d\n", run->fan + 1);
+    seq_printf(m, "progress: %d/%d\n", run->step, run->count);
+    if (run->reason)
+      seq_printf(m, "reason: %s\n", run->reason);
+    seq_puts(m, "pwm rpm\n");
+    for (i = 0; i < run->step && i < run->count; i++)
+      seq_printf(m, "%u %u\n", run->pwm[i], run->rpm[i]);
+  }
+  mutex_unlock(&asus->calib_run_lock);
+  return 0;
+}
+
+static int calibrate_open(struct inode *inode, struct file *file) {
+  return single_open(file, calibrate_show, inode->i_private);
+}
 
-// by now sysfs is always visible
-static umode_t asus_hwmon_sysfs_is_visible(struct kobject *kobj,
-                                           struct attribute *attr, int idx) {
-	return attr->mode;
+// "1" / "2" starts a sweep of that fan, "abort" stops it
+static ssize_t calibrate_write(struct file *file, const char __user *ubuf,
+                               size_t count, loff_t *ppos) {
+  struct asus_fan *asus = ((struct seq_file *)file->private_data)->private;
+  char buf[16];
+  unsigned int fan;
+  ssize_t len;
+  int err;
+
+  len = simple_write_to_buffer(buf, sizeof(buf) - 1, ppos, ubuf, count);
+  if (len < 0)
+    return len;
+  buf[len] = '\0';
+
+  if (sysfs_streq(buf, "abort")) {
+    calib_sweep_abort(asus, "user");
+    return count;
+  }
+  err = kstrtouint(strim(buf), 10, &fan);
+  if (err)
+    return err;
+  if (fan < 1 || fan > 2)
+    return -EINVAL;
+  err = calib_sweep_start(asus, fan - 1);
+  if (err)
+    return err;
+  return count;
 }
 
-static struct attribute_group hwmon_attribute_group = {
-    .is_visible = asus_hwmon_sysfs_is_visible, .attrs = hwmon_attributes};
-__ATTRIBUTE_GROUPS(hwmon_attribute);
+static const struct file_operations calibrate_fops = {
+    .owner = THIS_MODULE,
+    .open = calibrate_open,
+    .read = seq_read,
+    .write = calibrate_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
 
-static struct attribute_group hwmon_gfx_attribute_group = {
-    .is_visible = asus_hwmon_sysfs_is_visible, .attrs = hwmon_gfx_attributes};
-__ATTRIBUTE_GROUPS(hwmon_gfx_attribute);
+static int history_open(struct inode *inode, struct file *file) {
+  struct asus_fan *asus = inode->i_private;
+  struct asus_fan_history_reader *r;
 
-static int asus_fan_hwmon_init(struct asus_fan *asus) {
-  struct device *hwmon;
-  if (!has_gfx_fan) {
-    hwmon = hwmon_device_register_with_groups(
-        &asus->platform_device->dev, "asus_fan", asus, hwmon_attribute_groups);
-    if (IS_ERR(hwmon)) {
-      pr_err("Could not register asus hwmon device\n");
-      return PTR_ERR(hwmon);
+  r = kzalloc(sizeof(*r), GFP_KERNEL);
+  if (!r)
+    return -ENOMEM;
+  r->asus = asus;
+  // start with the oldest record still there
+  spin_lock(&asus->history_lock);
+  if (asus->history_head > asus->history_len)
+    r->pos = asus->history_head - asus->history_len;
+  spin_unlock(&asus->history_lock);
+  file->private_data = r;
+  return 0;
+}
+
+// whole records only, returns 0 once this reader caught up
+static ssize_t history_read(struct file *file, char __user *ubuf,
+                            size_t count, loff_t *ppos) {
+  struct asus_fan_history_reader *r = file->private_data;
+  struct asus_fan *asus = r->asus;
+  // bounce buffer, user memory must not be touched under the spinlock
+  struct asus_fan_history_rec buf[8];
+  size_t done = 0;
+  u64 oldest, n, i;
+
+  if (count < sizeof(buf[0]))
+    return -EINVAL;
+  while (count - done >= sizeof(buf[0])) {
+    n = min((count - done) / sizeof(buf[0]), ARRAY_SIZE(buf));
+
+    spin_lock(&asus->history_lock);
+    // the writer lapped this reader, skip to the oldest record left
+    oldest = asus->history_head > asus->history_len
+                 ? asus->history_head - asus->history_len
+                 : 0;
+    if (r->pos < oldest) {
+      atomic_long_add(oldest - r->pos, &asus->history_overruns);
+      r->pos = oldest;
     }
-  } else {
-    hwmon = hwmon_device_register_with_groups(&asus->platform_device->dev,
-                                              "asus_fan", asus,
-                                              hwmon_gfx_attribute_groups);
-    if (IS_ERR(hwmon)) {
-      pr_err("Could not register asus hwmon device\n");
-      return PTR_ERR(hwmon);
+    n = min(n, asus->history_head - r->pos);
+    for (i = 0; i < n; i++)
+      buf[i] = asus->history[(r->pos + i) & (asus->history_len - 1)];
+    r->pos += n;
+    spin_unlock(&asus->history_lock);
+
+    if (!n)
+      break;
+    if (copy_to_user(ubuf + done, buf, n * sizeof(buf[0])))
+      return done ? done : -EFAULT;
+    done += n * sizeof(buf[0]);
+  }
+  *ppos += done;
+  return done;
+}
+
+static int history_release(struct inode *inode, struct file *file) {
+  kfree(file->private_data);
+  return 0;
+}
+
+static const struct file_operations history_fops = {
+    .owner = THIS_MODULE,
+    .open = history_open,
+    .read = history_read,
+    .llseek = noop_llseek,
+    .release = history_release,
+};
+
+static int history_stats_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  u64 head;
+
+  spin_lock(&asus->history_lock);
+  head = asus->history_head;
+  spin_unlock(&asus->history_lock);
+  seq_printf(m, "%-10s %u\n", "size", asus->history_len);
+  seq_printf(m, "%-10s %zu\n", "record", sizeof(struct asus_fan_history_rec));
+  seq_printf(m, "%-10s %u\n", "interval",
+             max(READ_ONCE(history_interval), HISTORY_INTERVAL_MIN));
+  seq_printf(m, "%-10s %llu\n", "written", head);
+  seq_printf(m, "%-10s %ld\n", "overruns",
+             atomic_long_read(&asus->history_overruns));
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(history_stats);
+
+static int record_open(struct inode *inode, struct file *file) {
+  struct asus_fan *asus = inode->i_private;
+  struct asus_fan_history_reader *r;
+
+  r = kzalloc(sizeof(*r), GFP_KERNEL);
+  if (!r)
+    return -ENOMEM;
+  r->asus = asus;
+  // start with the oldest record still there
+  spin_lock(&asus->record_lock);
+  if (asus->record_head > asus->record_len)
+    r->pos = asus->record_head - asus->record_len;
+  spin_unlock(&asus->record_lock);
+  file->private_data = r;
+  return 0;
+}
+
+// whole records only, returns 0 once this reader caught up
+static ssize_t record_read(struct file *file, char __user *ubuf, size_t count,
+                           loff_t *ppos) {
+  struct asus_fan_history_reader *r = file->private_data;
+  struct asus_fan *asus = r->asus;
+  // bounce buffer, user memory must not be touched under the spinlock
+  struct asus_fan_acpi_rec buf[8];
+  size_t done = 0;
+  u64 oldest, n, i;
+
+  if (count < sizeof(buf[0]))
+    return -EINVAL;
+  while (count - done >= sizeof(buf[0])) {
+    n = min((count - done) / sizeof(buf[0]), ARRAY_SIZE(buf));
+
+    spin_lock(&asus->record_lock);
+    // the recording lapped this reader, skip to the oldest record left
+    oldest = asus->record_head > asus->record_len
+                 ? asus->record_head - asus->record_len
+                 : 0;
+    if (r->pos < oldest) {
+      atomic_long_add(oldest - r->pos, &asus->record_overruns);
+      r->pos = oldest;
     }
+    n = min(n, asus->record_head - r->pos);
+    for (i = 0; i < n; i++)
+      buf[i] = asus->record[(r->pos + i) & (asus->record_len - 1)];
+    r->pos += n;
+    spin_unlock(&asus->record_lock);
+
+    if (!n)
+      break;
+    if (copy_to_user(ubuf + done, buf, n * sizeof(buf[0])))
+      return done ? done : -EFAULT;
+    done += n * sizeof(buf[0]);
   }
+  *ppos += done;
+  return done;
+}
+
+static const struct file_operations record_fops = {
+    .owner = THIS_MODULE,
+    .open = record_open,
+    .read = record_read,
+    .llseek = noop_llseek,
+    .release = history_release,
+};
+
+static int record_stats_show(struct seq_file *m, void *v) {
+  struct asus_fan *asus = m->private;
+  u64 head;
+
+  spin_lock(&asus->record_lock);
+  head = asus->record_head;
+  spin_unlock(&asus->record_lock);
+  seq_printf(m, "%-10s %u\n", "size", asus->record_len);
+  seq_printf(m, "%-10s %zu\n", "record", sizeof(struct asus_fan_acpi_rec));
+  seq_printf(m, "%-10s %llu\n", "written", head);
+  seq_printf(m, "%-10s %ld\n", "overruns",
+             atomic_long_read(&asus->record_overruns));
   return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(record_stats);
+
+static void asus_fan_debugfs_init(struct asus_fan *asus) {
+  asus->debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+  debugfs_create_file("methods", 0444, asus->debugfs, asus, &methods_fops);
+  debugfs_create_file("acpi_latency", 0644, asus->debugfs, asus,
+                      &acpi_latency_fops);
+  debugfs_create_file("calibrate", 0644, asus->debugfs, asus,
+                      &calibrate_fops);
+  debugfs_create_file("pwm_stats", 0444, asus->debugfs, asus,
+                      &pwm_stats_fops);
+  debugfs_create_file("write_stats", 0444, asus->debugfs, asus,
+                      &write_stats_fops);
+  debugfs_create_file("watchdog", 0444, asus->debugfs, asus, &watchdog_fops);
+  debugfs_create_file("init_timing", 0444, asus->debugfs, asus,
+                      &init_timing_fops);
+  if (asus->history) {
+    debugfs_create_file("history", 0400, asus->debugfs, asus, &history_fops);
+    debugfs_create_file("history_stats", 0444, asus->debugfs, asus,
+                        &history_stats_fops);
+  }
+  if (asus->record) {
+    debugfs_create_file("record", 0400, asus->debugfs, asus, &record_fops);
+    debugfs_create_file("record_stats", 0444, asus->debugfs, asus,
+                        &record_stats_fops);
+  }
+}
 
-static void asus_fan_sysfs_exit(struct platform_device *device) {
-  sysfs_remove_group(&device->dev.kobj, &platform_attribute_group);
+static void asus_fan_debugfs_exit(struct asus_fan *asus) {
+  debugfs_remove_recursive(asus->debugfs);
+}
+
+static void asus_fan_init_step(struct asus_fan *asus,
+                               enum asus_fan_init_step step, ktime_t *t) {
+  ktime_t now = ktime_get();
+
+  asus->init_us[step] = ktime_us_delta(now, *t);
+  *t = now;
 }
 
 static int asus_fan_probe(struct platform_device *pdev) {
   struct platform_driver *pdrv = to_platform_driver(pdev->dev.driver);
   struct asus_fan_driver *wdrv = to_asus_fan_driver(pdrv);
 
+  struct asus_fan_calib *calib;
   struct asus_fan *asus;
+  ktime_t t, start;
   int err = 0;
+  int fan;
 
   asus = kzalloc(sizeof(struct asus_fan), GFP_KERNEL);
   if (!asus)
     return -ENOMEM;
+  t = wdrv->init_start;
+  asus_fan_init_step(asus, INIT_QUEUED, &t);
+  start = t;
 
   asus->driver = wdrv;
   asus->platform_device = pdev;
-  wdrv->platform_device = pdev;
+  asus->quirk = wdrv->quirk;
+
+  mutex_init(&asus->lock);
+  mutex_init(&asus->calib_lock);
+  mutex_init(&asus->calib_run_lock);
+  seqlock_init(&asus->state_lock);
+  seqlock_init(&asus->sample_lock);
+  INIT_DELAYED_WORK(&asus->sampler_work, sampler_work_fn);
+  INIT_DELAYED_WORK(&asus->pwm_flush_work, pwm_flush_work_fn);
+  INIT_DELAYED_WORK(&asus->pwm_ramp_work, pwm_ramp_work_fn);
+  INIT_DELAYED_WORK(&asus->curve_work, curve_work_fn);
+  INIT_DELAYED_WORK(&asus->calib_work, calib_work_fn);
+  spin_lock_init(&asus->history_lock);
+  INIT_DELAYED_WORK(&asus->history_work, history_work_fn);
+  spin_lock_init(&asus->record_lock);
+  INIT_WORK(&asus->resume_work, resume_work_fn);
+  spin_lock_init(&asus->write_lock);
+  INIT_WORK(&asus->write_work, write_work_fn);
+  INIT_DELAYED_WORK(&asus->watchdog_work, watchdog_work_fn);
+  spin_lock_init(&asus->status_lock);
+  asus->wq = alloc_ordered_workqueue("asus_fan", 0);
+  if (!asus->wq) {
+    err = -ENOMEM;
+    goto fail_wq;
+  }
+
+  asus->max_speed = max_fan_speed_default;
+  asus->write_max_speed = -1;
+  asus->watchdog_refresh = jiffies;
+  asus->update_interval =
+      clamp_val(update_interval, UPDATE_INTERVAL_MIN, UPDATE_INTERVAL_MAX);
+  for (fan = 0; fan < 2; fan++) {
+    asus->state[fan].pwm = -1;
+    asus->pwm_applied[fan] = -1;
+    asus->write_pwm[fan] = -1;
+    asus->write_mode[fan] = -1;
+    memcpy(asus->curve_temp[fan], curve_temp_default,
+           sizeof(curve_temp_default));
+    memcpy(asus->curve_pwm[fan], curve_pwm_default, sizeof(curve_pwm_default));
+    RCU_INIT_POINTER(asus->calib[fan], &calib_default);
+  }
+
+  // resolve all methods once, every call afterwards uses the handles
+  asus_fan_resolve_methods(asus);
+  asus_fan_init_step(asus, INIT_METHODS, &t);
+  asus_fan_record_init(asus);
+  err = asus_fan_hw_init(asus);
+  if (err)
+    goto fail_hw;
+  asus_fan_init_step(asus, INIT_EC, &t);
   platform_set_drvdata(asus->platform_device, asus);
 
   sysfs_create_group(&asus->platform_device->dev.kobj,
                      &platform_attribute_group);
+  asus_fan_init_step(asus, INIT_SYSFS, &t);
 
   err = asus_fan_hwmon_init(asus);
   if (err)
     goto fail_hwmon;
+  asus_fan_init_step(asus, INIT_HWMON, &t);
+  asus_fan_thermal_init(asus);
+  asus_fan_profile_init(asus);
+  asus_fan_dev_init(asus);
+  asus_fan_history_init(asus);
+  asus_fan_debugfs_init(asus);
+  printk(KERN_INFO "asus-fan (probe) - ready after %lld us (module_init: %lld "
+                   "us, queued: %lld us)\n",
+         ktime_us_delta(t, start), wdrv->init_us, asus->init_us[INIT_QUEUED]);
   return 0;
 
 fail_hwmon:
   asus_fan_sysfs_exit(asus->platform_device);
+  cancel_delayed_work_sync(&asus->sampler_work);
+  fan_set_auto(asus);
+  for (fan = 0; fan < 2; fan++) {
+    calib = rcu_dereference_protected(asus->calib[fan], 1);
+    if (calib != &calib_default)
+      kfree(calib);
+  }
+fail_hw:
+  kvfree(asus->record);
+  destroy_workqueue(asus->wq);
+fail_wq:
   kfree(asus);
   return err;
 }
 
-static int asus_fan_remove(struct platform_device *device) {
+static void asus_fan_remove(struct platform_device *device) {
+  struct asus_fan_calib *calib;
+  struct asus_fan_state st;
   struct asus_fan *asus;
+  int fan;
 
   asus = platform_get_drvdata(device);
+  cancel_work_sync(&asus->resume_work);
+  asus_fan_debugfs_exit(asus);
+  cancel_delayed_work_sync(&asus->history_work);
+  // the thermal core must not call in anymore from here on
+  asus_fan_dev_exit(asus);
+  asus_fan_thermal_exit(asus);
+  asus_fan_profile_exit(asus);
+  // the sampler must not notify a device that is going away
+  WRITE_ONCE(asus->notify, false);
+  cancel_delayed_work_sync(&asus->sampler_work);
+  hwmon_device_unregister(asus->hwmon_dev);
+  // the last queued writes still go out, the reset below overrides them
+  destroy_workqueue(asus->wq);
+  // no users left, stop the controller and the sampler for good
+  mutex_lock(&asus->lock);
+  for (fan = 0; fan < 2; fan++) {
+    fan_state_get(asus, fan, &st);
+    fan_state_set(asus, fan, st.pwm, st.manual, false);
+  }
+  mutex_unlock(&asus->lock);
+  cancel_delayed_work_sync(&asus->curve_work);
+  calib_sweep_abort(asus, "unload");
+  cancel_delayed_work_sync(&asus->pwm_flush_work);
+  asus->pwm_pending = 0;
+  cancel_delayed_work_sync(&asus->pwm_ramp_work);
+  cancel_delayed_work_sync(&asus->sampler_work);
+  clear_bit(0, &asus->sampler_running);
+  // nothing is left that could switch back to manual mode
+  fan_set_auto(asus);
+  // last, every worker above may have armed it on its way out
+  cancel_delayed_work_sync(&asus->watchdog_work);
   asus_fan_sysfs_exit(asus->platform_device);
+
+  for (fan = 0; fan < 2; fan++) {
+    calib = rcu_dereference_protected(asus->calib[fan], 1);
+    if (calib != &calib_default)
+      kfree(calib);
+  }
+  kfree(asus->history);
+  kvfree(asus->record);
+  // mappings hold their own reference
+  if (asus->status_page)
+    free_page((unsigned long)asus->status_page);
   kfree(asus);
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 11, 0)
+static int asus_fan_remove_legacy(struct platform_device *device) {
+  asus_fan_remove(device);
+  return 0;
+}
+#endif
+
+static int __maybe_unused asus_fan_suspend(struct device *dev) {
+  struct asus_fan *asus = dev_get_drvdata(dev);
+
+  // mode, pwm and max speed stay as they are in 'asus' (the snapshot the
+  // resume replays), only nothing may touch the ec until then
+  cancel_work_sync(&asus->resume_work);
+  // queued writes belong to that snapshot
+  flush_workqueue(asus->wq);
+  calib_sweep_abort(asus, "suspend");
+  cancel_delayed_work_sync(&asus->curve_work);
+  cancel_delayed_work_sync(&asus->pwm_ramp_work);
+  cancel_delayed_work_sync(&asus->pwm_flush_work);
+  cancel_delayed_work_sync(&asus->history_work);
+  cancel_delayed_work_sync(&asus->sampler_work);
+  clear_bit(0, &asus->sampler_running);
+  // last, the workers above arm it with every manual speed they set
+  cancel_delayed_work_sync(&asus->watchdog_work);
+  // a coalesced write is part of the replay
+  mutex_lock(&asus->lock);
+  asus->pwm_pending = 0;
+  mutex_unlock(&asus->lock);
+  return 0;
+}
+
+static int __maybe_unused asus_fan_resume(struct device *dev) {
+  struct asus_fan *asus = dev_get_drvdata(dev);
+
+  // the acpi calls take a while, do not hold up the whole resume for them
+  schedule_work(&asus->resume_work);
   return 0;
 }
 
+static void resume_work_fn(struct work_struct *work) {
+  struct asus_fan *asus = container_of(work, struct asus_fan, resume_work);
+  unsigned long max_speed = READ_ONCE(asus->max_speed);
+  struct asus_fan_state st;
+  ktime_t start = ktime_get();
+  bool curve = false;
+  int fan, err = 0;
+
+  mutex_lock(&asus->lock);
+  // the firmware is back at its defaults: auto-mode at full max speed
+  for (fan = 0; fan < 2; fan++)
+    WRITE_ONCE(asus->pwm_applied[fan], -1);
+  if (test_bit(METHOD_ST98, &asus->method_caps) && max_speed != 255)
+    err = __fan_set_max_speed(asus, max_speed, false);
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1) && !err; fan++) {
+    fan_state_get(asus, fan, &st);
+    if (!st.manual)
+      continue;
+    if (st.curve) {
+      asus->curve_temp_ref[fan] = 0;
+      curve = true;
+    }
+    if (pwm_ramp_active(asus, fan))
+      schedule_delayed_work(&asus->pwm_ramp_work, 0);
+    else
+      err = __fan_apply_speed(asus, fan, st.pwm);
+  }
+  if (err) {
+    printk(KERN_INFO "asus-fan (resume) - restoring the fan state failed, "
+                     "fallback to auto-mode! errcode: %d\n",
+           err);
+    __fan_set_auto(asus);
+    curve = false;
+  }
+  if (curve)
+    mod_delayed_work(system_wq, &asus->curve_work, 0);
+  // the time asleep does not count against the controlling process
+  WRITE_ONCE(asus->watchdog_refresh, jiffies);
+  for (fan = 0; fan < (asus->has_gfx_fan ? 2 : 1) && !err; fan++) {
+    fan_state_get(asus, fan, &st);
+    if (st.manual)
+      watchdog_arm(asus);
+  }
+  mutex_unlock(&asus->lock);
+
+  if (asus->history_len)
+    schedule_delayed_work(&asus->history_work, 0);
+  if (sampler_idle_interval(asus))
+    schedule_delayed_work(&asus->sampler_work,
+                          msecs_to_jiffies(sampler_idle_interval(asus)));
+  if (!err)
+    printk(KERN_INFO "asus-fan (resume) - fan state restored after %lld us\n",
+           ktime_us_delta(ktime_get(), start));
+}
+
+static SIMPLE_DEV_PM_OPS(asus_fan_pm_ops, asus_fan_suspend, asus_fan_resume);
+
 int __init_or_module asus_fan_register_driver(struct asus_fan_driver *driver) {
   struct platform_driver *platform_driver;
   struct platform_device *platform_device;
+  int err;
 
   if (used) {
     return -EBUSY;
   }
   platform_driver = &driver->platform_driver;
+  platform_driver->probe = asus_fan_probe;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
   platform_driver->remove = asus_fan_remove;
+#else
+  platform_driver->remove = asus_fan_remove_legacy;
+#endif
   platform_driver->driver.owner = driver->owner;
   platform_driver->driver.name = driver->name;
-
+  platform_driver->driver.pm = &asus_fan_pm_ops;
+  // all ec calls happen in probe, keep them off the boot critical path -
+  // the attributes show up once the probe is done
+  platform_driver->driver.probe_type = PROBE_PREFER_ASYNCHRONOUS;
+  // no unbind through sysfs while /dev/asus_fan is open - unloading the
+  // module waits for its files anyway
+  platform_driver->driver.suppress_bind_attrs = true;
+
+  err = platform_driver_register(platform_driver);
+  if (err)
+    return err;
   platform_device =
-      platform_create_bundle(platform_driver, asus_fan_probe, NULL, 0, NULL, 0);
+      platform_device_register_simple(driver->name, -1, NULL, 0);
   if (IS_ERR(platform_device)) {
+    platform_driver_unregister(platform_driver);
     return PTR_ERR(platform_device);
   }
+  driver->platform_device = platform_device;
 
   used = true;
   return 0;
 }
 
 static int __init fan_init(void) {
-  acpi_status ret;
-  int rpm;
-  // identify system/model/platform
-  if (!strcmp(dmi_get_system_info(DMI_SYS_VENDOR), "ASUSTeK COMPUTER INC.")) {
+  const struct dmi_system_id *dmi;
+  const char *vendor;
+  int ret;
 
-    rpm = __fan_rpm(0);
-    if (rpm == -1)
-      return -ENODEV;
-    rpm = __fan_rpm(1);
-    if (rpm == -1)
-      has_gfx_fan = false;
-    else
-      has_gfx_fan = true;
-    // check if reseting fan speeds works
-    ret = fan_set_max_speed(max_fan_speed_default, false);
-    if (ret != AE_OK) {
-      printk(KERN_INFO
-             "asus-fan (init) - set max speed to: '%d' failed! errcode: %d",
-             max_fan_speed_default, ret);
+  asus_fan_driver.init_start = ktime_get();
+  // identify system/model/platform
+  dmi = dmi_first_match(asus_fan_dmi_table);
+  vendor = dmi_get_system_info(DMI_SYS_VENDOR);
+  if (dmi) {
+    printk(KERN_INFO "asus-fan (init) - found %s\n", dmi->ident);
+    asus_fan_driver.quirk = dmi->driver_data;
+  } else if (vendor && !strcmp(vendor, "ASUSTeK COMPUTER INC.")) {
+    if (!probe_unknown) {
+      printk(KERN_INFO "asus-fan (init) - unknown model '%s', load with "
+                       "probe_unknown=1 to try anyway\n",
+             dmi_get_system_info(DMI_PRODUCT_NAME));
       return -ENODEV;
     }
+    asus_fan_driver.quirk = &quirk_probe;
+  }
 
-    // force sane enviroment / init with automatic fan controlling
-    if ((ret = fan_set_auto()) != AE_OK) {
-      printk(KERN_INFO
-             "asus-fan (init) - set auto-mode speed to active, failed! "
-             "errcode: %d",
-             ret);
-      return -ENODEV;
-    }
+  if (asus_fan_driver.quirk) {
+
+    // default pwm <-> rpm conversion for all fans
+    calib_default.count = ARRAY_SIZE(calib_default_pwm);
+    memcpy(calib_default.pwm, calib_default_pwm, sizeof(calib_default_pwm));
+    memcpy(calib_default.rpm, calib_default_rpm, sizeof(calib_default_rpm));
+    calib_build(&calib_default);
 
+    // the fans themselves are set up in probe
     ret = asus_fan_register_driver(&asus_fan_driver);
-    if (ret != AE_OK) {
+    asus_fan_driver.init_us =
+        ktime_us_delta(ktime_get(), asus_fan_driver.init_start);
+    if (ret) {
       printk(KERN_INFO
-             "asus-fan (init) - set max speed to: '%d' failed! errcode: %d",
-             max_fan_speed_default, ret);
+             "asus-fan (init) - registering the driver failed! errcode: %d",
+             ret);
       return ret;
     }
   }
@@ -801,7 +4185,7 @@ void asus_fan_unregister_driver(struct asus_fan_driver *driver) {
 }
 
 static void __exit fan_exit(void) {
-  fan_set_auto();
+  // remove() resets the fans to auto-mode
   asus_fan_unregister_driver(&asus_fan_driver);
   used = false;
 
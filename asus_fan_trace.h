@@ -0,0 +1,55 @@
+/**
+ *  ASUS Fan control module - tracepoints
+ *
+ *  perf list 'asus_fan:*', or /sys/kernel/tracing/events/asus_fan/
+ *
+**/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM asus_fan
+
+#if !defined(_ASUS_FAN_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ASUS_FAN_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// one evaluation of an ec method, 'nargs' of its integer arguments are
+// recorded in 'arg0' / 'arg1'
+TRACE_EVENT(asus_fan_acpi_call,
+  TP_PROTO(const char *method, int nargs, u64 arg0, u64 arg1, u32 status,
+           u64 value, u64 duration_ns),
+  TP_ARGS(method, nargs, arg0, arg1, status, value, duration_ns),
+
+  TP_STRUCT__entry(
+    __array(char, method, 8)
+    __field(int, nargs)
+    __field(u64, arg0)
+    __field(u64, arg1)
+    __field(u32, status)
+    __field(u64, value)
+    __field(u64, duration_ns)
+  ),
+
+  TP_fast_assign(
+    strscpy(__entry->method, method, sizeof(__entry->method));
+    __entry->nargs = nargs;
+    __entry->arg0 = arg0;
+    __entry->arg1 = arg1;
+    __entry->status = status;
+    __entry->value = value;
+    __entry->duration_ns = duration_ns;
+  ),
+
+  TP_printk("%s nargs=%d arg0=%llu arg1=%llu status=0x%x value=%llu "
+            "duration_ns=%llu",
+            __entry->method, __entry->nargs, __entry->arg0, __entry->arg1,
+            __entry->status, __entry->value, __entry->duration_ns)
+);
+
+#endif /* _ASUS_FAN_TRACE_H */
+
+// the header lives next to asus_fan.c, not in include/trace/events
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE asus_fan_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,75 @@
+/**
+ *  ASUS Fan control module - /dev/asus_fan and debugfs 'record'
+ *
+ *  Shared with userspace: one ioctl returns all values at once, another one
+ *  sets the pwm of several fans in one call, and a read-only page mmap()ed
+ *  from offset 0 always holds the latest values (read it like a seqcount:
+ *  retry while 'seq' is odd or changed meanwhile).
+ *
+ *  The records of debugfs 'record' (every ec call) are defined here as
+ *  well, for tools replaying them.
+ *
+**/
+#ifndef _ASUS_FAN_UAPI_H
+#define _ASUS_FAN_UAPI_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+// all values of one moment, the same as their hwmon attributes
+struct asus_fan_status {
+  __u64 time_ns;     // CLOCK_MONOTONIC when the values were taken
+  __s32 rpm[2];      // fanX_input, -1: unreadable
+  __s32 temp;        // temp1_input (millidegree celsius), -1: no TH1R
+  __u32 alarms;      // bit 0: temp1_crit_alarm, bit X: fanX_alarm
+  __s16 pwm[2];      // pwmX
+  __u16 max_speed;   // fan1_speed_max
+  __u8 mode[2];      // pwmX_enable
+  __u8 fans;         // number of fans, the values of the others are 0
+  __u8 reserved[5];
+};
+
+// the mmap()ed page
+struct asus_fan_status_page {
+  __u32 seq;         // odd while the driver updates 'status'
+  __u32 reserved;
+  struct asus_fan_status status;
+};
+
+// pwm of all fans in 'fans' (bit X: fan X + 1), applied like a write to
+// each pwmX (asynchronously unless 'sync_writes' is set)
+struct asus_fan_pwm {
+  __u32 fans;
+  __u32 pwm[2];      // 0 - 255
+};
+
+#define ASUS_FAN_IOC_MAGIC 0xaf
+#define ASUS_FAN_IOC_STATUS _IOR(ASUS_FAN_IOC_MAGIC, 1, struct asus_fan_status)
+// needs the device opened for writing
+#define ASUS_FAN_IOC_SET_PWM _IOW(ASUS_FAN_IOC_MAGIC, 2, struct asus_fan_pwm)
+
+// 'method' of a record, arguments and result as passed to / returned by
+// the AML method: SFNV (fan + 1 or 0 = auto-mode, pwm), TACH (fan; rpm),
+// TH1R (; degree celsius), ST98 (max speed), QMOD (0 - 2)
+#define ASUS_FAN_REC_SFNV 0
+#define ASUS_FAN_REC_TACH 1
+#define ASUS_FAN_REC_TH1R 2
+#define ASUS_FAN_REC_ST98 3
+#define ASUS_FAN_REC_QMOD 4
+// a read of the tach registers (register, fan; rpm)
+#define ASUS_FAN_REC_EC 5
+
+// one record of debugfs 'record' (native endianness, 40 bytes)
+struct asus_fan_acpi_rec {
+  __u64 time_ns;     // CLOCK_MONOTONIC when the call was made
+  __u64 result;      // 0 on failure
+  __u32 seq;         // record number, gaps show overruns
+  __u32 duration_ns; // time the call took (saturated)
+  __u32 arg[2];
+  __u32 status;      // acpi_status, 0: AE_OK
+  __u8 method;       // ASUS_FAN_REC_*
+  __u8 nargs;
+  __u8 reserved[2];
+};
+
+#endif
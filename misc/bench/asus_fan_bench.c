@@ -0,0 +1,431 @@
+/**
+ *  asus-fan-bench - latency of the asus_fan hwmon attributes
+ *
+ *  usage: asus_fan_bench [-d hwmon dir] [-n iterations] [-t threads,...]
+ *                        [-a attr,...] [-w] [-f json|csv]
+ *         asus_fan_bench_sim [-l aml latency (us)] [-p param=value] ...
+ *
+ *  Every attribute is read (and with -w written) 'iterations' times by each
+ *  of 1, 2, ... concurrent threads (-t, default: 1,4), each thread through
+ *  its own open file like independent readers. One result per attribute,
+ *  operation and concurrency is printed as a json line (or csv row): ops,
+ *  ops/s, p50/p99/max latency in us and errors.
+ *
+ *  Writes alternate between two neighbouring values, so none of them is
+ *  dropped as unchanged; pwmX_enable, pwmX and fan1_speed_max are restored
+ *  afterwards. They do switch the fans to manual mode meanwhile, thus -w.
+ *
+ *  asus_fan_bench_sim (built in misc/sim) runs the same suite against the
+ *  module in the simulator with a simulated EC, so results of different
+ *  driver versions can be compared without the hardware: -l sets the AML
+ *  latency per call, -p module parameters (before the load).
+ *
+**/
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef BENCH_SIM
+#include "sim.h"
+#include "sim_ec.h"
+#endif
+
+#define HWMON_GLOB "/sys/devices/platform/asus_fan/hwmon/hwmon*"
+
+#define ATTRS_MAX 16
+#define THREADS_MAX 64
+
+// one benchmark thread, its own handle on the attribute
+struct worker {
+  const char *attr;
+  int fd;
+  bool write;
+  const char *values[2];
+  long iterations;
+  uint64_t *lat;
+  long errors;
+};
+
+static char dir[PATH_MAX];
+static const char *format = "json";
+
+//////
+////// BACKEND (sysfs or simulator)
+//////
+
+#ifdef BENCH_SIM
+static const char *backend = "sim";
+
+static int attr_open(struct worker *w) {
+  (void)w;
+  return 0;
+}
+
+static void attr_close(struct worker *w) { (void)w; }
+
+static ssize_t attr_read(struct worker *w, char *buf, size_t size) {
+  return sim_attr_read(w->attr, buf, size);
+}
+
+static ssize_t attr_write(struct worker *w, const char *value) {
+  return sim_attr_write(w->attr, value);
+}
+#else
+static const char *backend = "sysfs";
+
+static int attr_open(struct worker *w) {
+  char path[sizeof(dir) + NAME_MAX + 2];
+
+  snprintf(path, sizeof(path), "%s/%s", dir, w->attr);
+  w->fd = open(path, (w->write ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  return w->fd < 0 ? -errno : 0;
+}
+
+static void attr_close(struct worker *w) {
+  if (w->fd >= 0)
+    close(w->fd);
+  w->fd = -1;
+}
+
+static ssize_t attr_read(struct worker *w, char *buf, size_t size) {
+  ssize_t ret = pread(w->fd, buf, size - 1, 0);
+
+  if (ret < 0)
+    return -errno;
+  buf[ret] = '\0';
+  return ret;
+}
+
+static ssize_t attr_write(struct worker *w, const char *value) {
+  ssize_t ret = pwrite(w->fd, value, strlen(value), 0);
+
+  return ret < 0 ? -errno : ret;
+}
+#endif
+
+// one-off access by name (probing, saving and restoring values)
+static ssize_t attr_get(const char *attr, char *buf, size_t size) {
+  struct worker w = {.attr = attr, .fd = -1};
+  ssize_t ret;
+
+  ret = attr_open(&w);
+  if (!ret)
+    ret = attr_read(&w, buf, size);
+  attr_close(&w);
+  if (ret > 0 && buf[ret - 1] == '\n')
+    buf[ret - 1] = '\0';
+  return ret;
+}
+
+static ssize_t attr_set(const char *attr, const char *value) {
+  struct worker w = {.attr = attr, .fd = -1, .write = true};
+  ssize_t ret;
+
+  ret = attr_open(&w);
+  if (!ret)
+    ret = attr_write(&w, value);
+  attr_close(&w);
+  return ret;
+}
+
+//////
+////// BENCHMARK
+//////
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void *worker_fn(void *arg) {
+  struct worker *w = arg;
+  char buf[4096];
+  uint64_t start;
+  ssize_t ret;
+  long i;
+
+  for (i = 0; i < w->iterations; i++) {
+    start = now_ns();
+    if (w->write)
+      ret = attr_write(w, w->values[i & 1]);
+    else
+      ret = attr_read(w, buf, sizeof(buf));
+    w->lat[i] = now_ns() - start;
+    if (ret < 0)
+      w->errors++;
+  }
+  return NULL;
+}
+
+static void result_print(const char *attr, bool write, int threads,
+                         long total, uint64_t elapsed, const uint64_t *lat,
+                         long errors) {
+  double ops_s = total / (elapsed / 1e9);
+  double p50 = lat[total / 2] / 1e3;
+  double p99 = lat[total * 99 / 100] / 1e3;
+  double max = lat[total - 1] / 1e3;
+
+  if (!strcmp(format, "csv"))
+    printf("%s,%s,%s,%d,%ld,%.0f,%.1f,%.1f,%.1f,%ld\n", backend, attr,
+           write ? "write" : "read", threads, total, ops_s, p50, p99, max,
+           errors);
+  else
+    printf("{\"backend\": \"%s\", \"attr\": \"%s\", \"op\": \"%s\", "
+           "\"threads\": %d, \"ops\": %ld, \"ops_per_s\": %.0f, "
+           "\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f, "
+           "\"errors\": %ld}\n",
+           backend, attr, write ? "write" : "read", threads, total, ops_s,
+           p50, p99, max, errors);
+  fflush(stdout);
+}
+
+static int bench(const char *attr, bool write, const char *const values[2],
+                 int threads, long iterations) {
+  struct worker w[THREADS_MAX];
+  pthread_t tid[THREADS_MAX];
+  long total = threads * iterations, errors = 0;
+  uint64_t *lat, start, elapsed;
+  int t, ret = 0;
+
+  lat = calloc(total, sizeof(*lat));
+  if (!lat)
+    return -ENOMEM;
+  for (t = 0; t < threads; t++) {
+    w[t] = (struct worker){.attr = attr, .fd = -1, .write = write,
+                           .iterations = iterations,
+                           .lat = lat + t * iterations};
+    if (write) {
+      w[t].values[0] = values[0];
+      w[t].values[1] = values[1];
+    }
+    ret = attr_open(&w[t]);
+    if (ret) {
+      fprintf(stderr, "asus_fan_bench: %s: %s\n", attr, strerror(-ret));
+      while (t--)
+        attr_close(&w[t]);
+      free(lat);
+      return ret;
+    }
+  }
+  start = now_ns();
+  for (t = 0; t < threads; t++)
+    pthread_create(&tid[t], NULL, worker_fn, &w[t]);
+  for (t = 0; t < threads; t++) {
+    pthread_join(tid[t], NULL);
+    errors += w[t].errors;
+    attr_close(&w[t]);
+  }
+  elapsed = now_ns() - start;
+  qsort(lat, total, sizeof(*lat), cmp_u64);
+  result_print(attr, write, threads, total, elapsed, lat, errors);
+  free(lat);
+  return 0;
+}
+
+//////
+////// SUITE
+//////
+
+// the attributes measured by default and their write values
+struct bench_attr {
+  const char *name;
+  const char *values[2];  // NULL: read-only
+  const char *mode;       // switches it into the mode the writes need
+};
+
+static const struct bench_attr bench_attrs[] = {
+    {"pwm1", {"128", "129"}, "pwm1_enable"},
+    {"pwm2", {"128", "129"}, "pwm2_enable"},
+    {"fan1_input", {NULL, NULL}, NULL},
+    {"fan2_input", {NULL, NULL}, NULL},
+    {"temp1_input", {NULL, NULL}, NULL},
+    {"fan1_speed_max", {"254", "255"}, NULL},
+};
+
+static const struct bench_attr *bench_attr_find(const char *name) {
+  size_t i;
+
+  for (i = 0; i < sizeof(bench_attrs) / sizeof(*bench_attrs); i++)
+    if (!strcmp(bench_attrs[i].name, name))
+      return &bench_attrs[i];
+  return NULL;
+}
+
+static int suite(const char *const *attrs, int nattrs, const int *threads,
+                 int nthreads, long iterations, bool writes) {
+  char saved[64], mode[64], buf[64];
+  const struct bench_attr *a;
+  int i, t, err = 0;
+
+  for (i = 0; i < nattrs; i++) {
+    // not every model has every attribute
+    if (attr_get(attrs[i], buf, sizeof(buf)) < 0) {
+      fprintf(stderr, "asus_fan_bench: %s not available, skipped\n",
+              attrs[i]);
+      continue;
+    }
+    for (t = 0; t < nthreads; t++)
+      err |= bench(attrs[i], false, NULL, threads[t], iterations);
+
+    a = bench_attr_find(attrs[i]);
+    if (!writes || !a || !a->values[0])
+      continue;
+    // measure and restore: the value itself and the mode it belongs to
+    snprintf(saved, sizeof(saved), "%s", buf);
+    if (a->mode && attr_get(a->mode, mode, sizeof(mode)) < 0)
+      continue;
+    if (a->mode)
+      attr_set(a->mode, "1");
+    for (t = 0; t < nthreads; t++)
+      err |= bench(attrs[i], true, a->values, threads[t], iterations);
+    attr_set(attrs[i], saved);
+    if (a->mode)
+      attr_set(a->mode, mode);
+  }
+  return err;
+}
+
+static int parse_list(char *arg, const char **out, int max) {
+  char *tok;
+  int n = 0;
+
+  for (tok = strtok(arg, ","); tok && n < max; tok = strtok(NULL, ","))
+    out[n++] = tok;
+  return n;
+}
+
+static int hwmon_find(void) {
+  glob_t g;
+
+  if (glob(HWMON_GLOB, 0, NULL, &g) || !g.gl_pathc) {
+    fprintf(stderr, "asus_fan_bench: no %s, module not loaded?\n",
+            HWMON_GLOB);
+    globfree(&g);
+    return -1;
+  }
+  snprintf(dir, sizeof(dir), "%s", g.gl_pathv[0]);
+  globfree(&g);
+  return 0;
+}
+
+static void usage(const char *exe) {
+  fprintf(stderr,
+          "usage: %s [-d hwmon dir] [-n iterations] [-t threads,...] "
+          "[-a attr,...] [-w] [-f json|csv]"
+#ifdef BENCH_SIM
+          " [-l aml latency (us)] [-p param=value]"
+#endif
+          "\n",
+          exe);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *attrs[ATTRS_MAX], *thread_args[THREADS_MAX];
+  int threads[THREADS_MAX], nattrs = 0, nthreads, i, opt, ret;
+  char default_threads[] = "1,4";
+  char *thread_list = default_threads;
+  long iterations = 1000;
+  bool writes = false;
+#ifdef BENCH_SIM
+  char path[PATH_MAX], *slash, *eq;
+
+  sim_ec_reset();
+#endif
+
+  while ((opt = getopt(argc, argv, "d:n:t:a:wf:l:p:")) != -1) {
+    switch (opt) {
+      case 'd':
+        snprintf(dir, sizeof(dir), "%s", optarg);
+        break;
+      case 'n':
+        iterations = atol(optarg);
+        break;
+      case 't':
+        thread_list = optarg;
+        break;
+      case 'a':
+        nattrs = parse_list(optarg, attrs, ATTRS_MAX);
+        break;
+      case 'w':
+        writes = true;
+        break;
+      case 'f':
+        format = optarg;
+        break;
+#ifdef BENCH_SIM
+      case 'l':
+        sim_ec_set("latency_us", atof(optarg));
+        break;
+      case 'p':
+        eq = strchr(optarg, '=');
+        if (!eq)
+          usage(argv[0]);
+        *eq = '\0';
+        if (sim_param_set(optarg, eq + 1))
+          usage(argv[0]);
+        break;
+#endif
+      default:
+        usage(argv[0]);
+    }
+  }
+  nthreads = parse_list(thread_list, thread_args, THREADS_MAX);
+  for (i = 0; i < nthreads; i++) {
+    threads[i] = atoi(thread_args[i]);
+    if (threads[i] < 1 || threads[i] > THREADS_MAX)
+      usage(argv[0]);
+  }
+  if (iterations < 1 || !nthreads ||
+      (strcmp(format, "json") && strcmp(format, "csv")))
+    usage(argv[0]);
+  if (!nattrs)
+    for (i = 0; i < (int)(sizeof(bench_attrs) / sizeof(*bench_attrs)); i++)
+      attrs[nattrs++] = bench_attrs[i].name;
+
+#ifdef BENCH_SIM
+  // the module is built next to the simulator
+  snprintf(path, sizeof(path), "%s", argv[0]);
+  slash = strrchr(path, '/');
+  snprintf(slash ? slash + 1 : path,
+           sizeof(path) - (slash ? slash + 1 - path : 0), "asus_fan.so");
+  sim_quiet = 1;
+  sim_set_module(path);
+  ret = sim_load();
+  if (ret) {
+    fprintf(stderr, "asus_fan_bench: loading %s failed: %d\n", path, ret);
+    return 1;
+  }
+  sim_probe_settle();
+#else
+  if (!dir[0] && hwmon_find())
+    return 1;
+#endif
+
+  if (!strcmp(format, "csv"))
+    printf("backend,attr,op,threads,ops,ops_per_s,p50_us,p99_us,max_us,"
+           "errors\n");
+  ret = suite(attrs, nattrs, threads, nthreads, iterations, writes);
+
+#ifdef BENCH_SIM
+  sim_unload();
+#endif
+  return ret ? 1 : 0;
+}
@@ -0,0 +1,412 @@
+/**
+ *  asus-fand - small fan control daemon for the asus_fan hwmon interface
+ *
+ *  usage: asus_fand [-c config] [-d hwmon dir] [-s stats interval (s)] [-v]
+ *
+ *  A native replacement for the generic 'fancontrol' script: all attribute
+ *  files are opened once and read with pread(), the temperature sources are
+ *  poll()ed for POLLPRI (the module notifies temp1_input on every noticeable
+ *  change), so the daemon sleeps until something happened - or at the latest
+ *  'interval' ms for sources without notification. pwmX is only written if
+ *  the curve yields a new value.
+ *
+ *  Config (default: /etc/asus-fand.conf), one setting per line, '#' starts a
+ *  comment:
+ *
+ *    interval <ms>                 longest sleep without notification
+ *                                  (default: 5000)
+ *    hysteresis <millidegree>      temperature drop before a fan slows down
+ *                                  again (default: 3000)
+ *    pwm1|pwm2 <source> <temp>:<pwm> ...
+ *                                  curve of a fan, up to 8 points with the
+ *                                  temperature (millidegree) ascending and
+ *                                  linear interpolation in between; source is
+ *                                  a temperature file, relative to the hwmon
+ *                                  directory unless absolute
+ *
+ *  On exit (SIGINT/SIGTERM) the fans are handed back to auto-mode. Its own
+ *  cost (cpu time, wakeups and writes per minute) is logged every 'stats'
+ *  seconds (default: 600, 0: off), on exit and on SIGUSR1.
+ *
+**/
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HWMON_GLOB "/sys/devices/platform/asus_fan/hwmon/hwmon*"
+#define CONFIG_DEFAULT "/etc/asus-fand.conf"
+
+#define FANS 2
+#define CURVE_POINTS 8
+#define SOURCES FANS
+// 'pwmX', the source and the points
+#define ARGS_MAX (CURVE_POINTS + 2)
+
+// one temperature file, shared by all fans using it
+struct source {
+  char path[PATH_MAX];
+  int fd;
+  long temp;  // millidegree, last read
+};
+
+struct fan {
+  bool used;
+  struct source *source;
+  int count;
+  long temp[CURVE_POINTS];
+  int pwm[CURVE_POINTS];
+  int pwm_fd;
+  int enable_fd;
+  int written;     // last pwm written, -1: none yet
+  long temp_ref;   // temperature 'written' was derived from (hysteresis)
+};
+
+static struct fan fans[FANS];
+static struct source sources[SOURCES];
+static int nsources;
+
+static long interval = 5000;
+static long hysteresis = 3000;
+static long stats_interval = 600;
+static bool verbose;
+
+//// own cost, for the comparison with fancontrol
+static unsigned long wakeups;
+static unsigned long notified;
+static unsigned long writes;
+static struct timespec started;
+
+static volatile sig_atomic_t quit;
+static volatile sig_atomic_t dump_stats;
+
+static void on_signal(int sig) {
+  if (sig == SIGUSR1)
+    dump_stats = 1;
+  else
+    quit = 1;
+}
+
+static double elapsed_s(const struct timespec *since) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+static void stats_print(void) {
+  double minutes = elapsed_s(&started) / 60;
+  struct rusage ru;
+  double cpu_ms;
+
+  getrusage(RUSAGE_SELF, &ru);
+  cpu_ms = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3 +
+           (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+  if (minutes <= 0)
+    minutes = 1.0 / 60;
+  fprintf(stderr,
+          "asus-fand: %.1f min, cpu %.1f ms (%.3f ms/min), wakeups %lu "
+          "(%.1f/min, %lu notified), writes %lu (%.1f/min)\n",
+          minutes, cpu_ms, cpu_ms / minutes, wakeups, wakeups / minutes,
+          notified, writes, writes / minutes);
+}
+
+// read a decimal value from an open attribute, re-arms its notification
+static int attr_read(int fd, long *value) {
+  char buf[32];
+  ssize_t len;
+
+  len = pread(fd, buf, sizeof(buf) - 1, 0);
+  if (len <= 0)
+    return -1;
+  buf[len] = '\0';
+  *value = strtol(buf, NULL, 10);
+  return 0;
+}
+
+static int attr_write(int fd, long value) {
+  char buf[32];
+  int len;
+
+  len = snprintf(buf, sizeof(buf), "%ld\n", value);
+  return pwrite(fd, buf, len, 0) == len ? 0 : -1;
+}
+
+static int attr_open(const char *dir, const char *name, int flags) {
+  char path[PATH_MAX];
+  int fd;
+
+  if (name[0] == '/')
+    snprintf(path, sizeof(path), "%s", name);
+  else
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+  fd = open(path, flags | O_CLOEXEC);
+  if (fd < 0)
+    fprintf(stderr, "asus-fand: %s: %s\n", path, strerror(errno));
+  return fd;
+}
+
+static struct source *source_get(const char *path) {
+  int i;
+
+  for (i = 0; i < nsources; i++)
+    if (!strcmp(sources[i].path, path))
+      return &sources[i];
+  if (nsources == SOURCES)
+    return NULL;
+  snprintf(sources[nsources].path, PATH_MAX, "%s", path);
+  sources[nsources].fd = -1;
+  return &sources[nsources++];
+}
+
+static int config_curve(struct fan *fan, char **argv, int argc) {
+  char *end;
+  int i;
+
+  if (argc < 2 || argc - 1 > CURVE_POINTS)
+    return -1;
+  fan->source = source_get(argv[0]);
+  if (!fan->source)
+    return -1;
+  for (i = 1; i < argc; i++) {
+    fan->temp[i - 1] = strtol(argv[i], &end, 10);
+    if (*end != ':')
+      return -1;
+    fan->pwm[i - 1] = (int)strtol(end + 1, &end, 10);
+    if (*end || fan->pwm[i - 1] < 0 || fan->pwm[i - 1] > 255)
+      return -1;
+    if (i > 1 && fan->temp[i - 1] <= fan->temp[i - 2])
+      return -1;
+  }
+  fan->count = argc - 1;
+  fan->used = true;
+  return 0;
+}
+
+static int config_read(const char *path) {
+  char line[512], *argv[ARGS_MAX], *tok;
+  int argc, lineno = 0, fan, err;
+  FILE *f;
+
+  f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "asus-fand: %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    lineno++;
+    if ((tok = strchr(line, '#')))
+      *tok = '\0';
+    argc = 0;
+    for (tok = strtok(line, " \t\r\n"); tok && argc < ARGS_MAX;
+         tok = strtok(NULL, " \t\r\n"))
+      argv[argc++] = tok;
+    if (!argc)
+      continue;
+    if (tok)
+      err = -1;
+    else if (!strcmp(argv[0], "interval") && argc == 2)
+      err = (interval = atol(argv[1])) <= 0;
+    else if (!strcmp(argv[0], "hysteresis") && argc == 2)
+      err = (hysteresis = atol(argv[1])) < 0;
+    else if (!strcmp(argv[0], "pwm1") || !strcmp(argv[0], "pwm2"))
+      err = config_curve(&fans[argv[0][3] - '1'], argv + 1, argc - 1);
+    else
+      err = -1;
+    if (err) {
+      fprintf(stderr, "asus-fand: %s:%d: invalid line\n", path, lineno);
+      fclose(f);
+      return -1;
+    }
+  }
+  fclose(f);
+  for (fan = 0; fan < FANS; fan++)
+    if (fans[fan].used)
+      return 0;
+  fprintf(stderr, "asus-fand: %s: no fan configured\n", path);
+  return -1;
+}
+
+// same interpolation as the module's included controller
+static int curve_eval(const struct fan *fan, long temp) {
+  int i;
+
+  if (temp <= fan->temp[0])
+    return fan->pwm[0];
+  for (i = 1; i < fan->count; i++)
+    if (temp < fan->temp[i])
+      return fan->pwm[i - 1] +
+             (int)((fan->pwm[i] - fan->pwm[i - 1]) *
+                   (temp - fan->temp[i - 1]) /
+                   (fan->temp[i] - fan->temp[i - 1]));
+  return fan->pwm[fan->count - 1];
+}
+
+static int fan_update(int idx) {
+  struct fan *fan = &fans[idx];
+  long temp = fan->source->temp;
+  int pwm = curve_eval(fan, temp);
+
+  if (pwm == fan->written)
+    return 0;
+  // slow down only after the temperature dropped noticeably
+  if (fan->written >= 0 && pwm < fan->written &&
+      temp > fan->temp_ref - hysteresis)
+    return 0;
+  if (attr_write(fan->pwm_fd, pwm)) {
+    fprintf(stderr, "asus-fand: writing pwm%d failed: %s\n", idx + 1,
+            strerror(errno));
+    return -1;
+  }
+  if (verbose)
+    fprintf(stderr, "asus-fand: pwm%d %d -> %d (%ld)\n", idx + 1,
+            fan->written, pwm, temp);
+  fan->written = pwm;
+  fan->temp_ref = temp;
+  writes++;
+  return 0;
+}
+
+static void fans_release(void) {
+  int fan;
+
+  // auto-mode always applies to all fans, once is enough
+  for (fan = 0; fan < FANS; fan++)
+    if (fans[fan].used && fans[fan].enable_fd >= 0) {
+      attr_write(fans[fan].enable_fd, 0);
+      break;
+    }
+}
+
+static int hwmon_find(char *dir, size_t size) {
+  glob_t g;
+
+  if (glob(HWMON_GLOB, 0, NULL, &g) || !g.gl_pathc) {
+    fprintf(stderr, "asus-fand: no %s, module not loaded?\n", HWMON_GLOB);
+    globfree(&g);
+    return -1;
+  }
+  snprintf(dir, size, "%s", g.gl_pathv[0]);
+  globfree(&g);
+  return 0;
+}
+
+static void usage(const char *exe) {
+  fprintf(stderr,
+          "usage: %s [-c config] [-d hwmon dir] [-s stats interval (s)] "
+          "[-v]\n",
+          exe);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *config = CONFIG_DEFAULT;
+  struct pollfd pfd[SOURCES];
+  struct timespec last_stats;
+  char name[16], dir[PATH_MAX] = "";
+  struct sigaction sa;
+  int opt, i, fan, n, ret = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  while ((opt = getopt(argc, argv, "c:d:s:v")) != -1) {
+    switch (opt) {
+      case 'c':
+        config = optarg;
+        break;
+      case 'd':
+        snprintf(dir, sizeof(dir), "%s", optarg);
+        break;
+      case 's':
+        stats_interval = atol(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (config_read(config))
+    return 1;
+  if (!dir[0] && hwmon_find(dir, sizeof(dir)))
+    return 1;
+
+  // everything is opened once, each cycle is just pread()/pwrite()
+  for (i = 0; i < nsources; i++) {
+    sources[i].fd = attr_open(dir, sources[i].path, O_RDONLY);
+    if (sources[i].fd < 0 || attr_read(sources[i].fd, &sources[i].temp))
+      return 1;
+    pfd[i].fd = sources[i].fd;
+    pfd[i].events = POLLPRI;
+  }
+  for (fan = 0; fan < FANS; fan++) {
+    fans[fan].pwm_fd = fans[fan].enable_fd = -1;
+    fans[fan].written = -1;
+    if (!fans[fan].used)
+      continue;
+    snprintf(name, sizeof(name), "pwm%d", fan + 1);
+    fans[fan].pwm_fd = attr_open(dir, name, O_WRONLY);
+    snprintf(name, sizeof(name), "pwm%d_enable", fan + 1);
+    fans[fan].enable_fd = attr_open(dir, name, O_WRONLY);
+    if (fans[fan].pwm_fd < 0 || fans[fan].enable_fd < 0 ||
+        attr_write(fans[fan].enable_fd, 1))
+      goto out;
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGUSR1, &sa, NULL);
+
+  last_stats = started;
+  fprintf(stderr, "asus-fand: controlling %s, %d source(s)\n", dir,
+          nsources);
+
+  while (!quit) {
+    for (fan = 0; fan < FANS; fan++)
+      if (fans[fan].used && fan_update(fan)) {
+        ret = 1;
+        goto out;
+      }
+
+    n = poll(pfd, nsources, (int)interval);
+    if (n < 0 && errno != EINTR) {
+      perror("asus-fand: poll");
+      ret = 1;
+      break;
+    }
+    if (n >= 0)
+      wakeups++;
+    if (n > 0)
+      notified++;
+    // all sources are re-read, a notified one must be anyway (re-arm)
+    for (i = 0; i < nsources && n >= 0; i++)
+      if (attr_read(sources[i].fd, &sources[i].temp)) {
+        fprintf(stderr, "asus-fand: reading %s failed\n", sources[i].path);
+        ret = 1;
+        goto out;
+      }
+
+    if (dump_stats ||
+        (stats_interval > 0 && elapsed_s(&last_stats) >= stats_interval)) {
+      dump_stats = 0;
+      clock_gettime(CLOCK_MONOTONIC, &last_stats);
+      stats_print();
+    }
+  }
+
+out:
+  fans_release();
+  stats_print();
+  return ret;
+}
@@ -0,0 +1,1149 @@
+/**
+ *  asus-fan userspace simulation - kernel api shim
+ *
+ *  Just enough of the kernel api to compile asus_fan.c unmodified as a
+ *  userspace program. Everything 'hardware' ends up in the simulated EC
+ *  (sim_ec.c), everything 'sysfs/debugfs' in a registry the simulator can
+ *  read from and write to by name (sim_kernel.c).
+ *
+**/
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+//////
+////// BASICS
+//////
+
+// the kernel api simulated, 'make SIM_KERNEL=0x060900' for an older one
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + (c))
+#ifndef LINUX_VERSION_CODE
+#define LINUX_VERSION_CODE KERNEL_VERSION(6, 14, 0)
+#endif
+
+// the kconfig options of the simulated kernel, 'make SIM_NO_PROFILE=1' for one
+// without the platform_profile core
+#ifndef SIM_NO_PROFILE
+#define CONFIG_ACPI_PLATFORM_PROFILE 1
+#endif
+// linux/kconfig.h
+#define __ARG_PLACEHOLDER_1 0,
+#define __take_second_arg(__ignored, val, ...) val
+#define __is_defined(x) ___is_defined(x)
+#define ___is_defined(val) ____is_defined(__ARG_PLACEHOLDER_##val)
+#define ____is_defined(arg1_or_junk) __take_second_arg(arg1_or_junk 1, 0)
+#define IS_BUILTIN(option) __is_defined(option)
+#define IS_MODULE(option) __is_defined(option##_MODULE)
+#define IS_REACHABLE(option) \
+  (IS_BUILTIN(option) || (IS_MODULE(option) && __is_defined(MODULE)))
+#define IS_ENABLED(option) (IS_BUILTIN(option) || IS_MODULE(option))
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef long long s64;
+typedef uint8_t __u8;
+typedef uint16_t __u16;
+typedef uint32_t __u32;
+typedef unsigned long long __u64;
+typedef int16_t __s16;
+typedef int32_t __s32;
+typedef uint16_t __le16;
+typedef uint32_t __le32;
+typedef uint64_t __le64;
+typedef unsigned short umode_t;
+typedef unsigned int gfp_t;
+typedef unsigned int fmode_t;
+
+#define __user
+#define __rcu
+#define __init
+#define __exit
+#define __init_or_module
+#define __packed __attribute__((packed))
+#define __always_unused __attribute__((unused))
+#define __maybe_unused __attribute__((unused))
+
+#define __stringify_1(x) #x
+#define __stringify(x) __stringify_1(x)
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) \
+  ((type *)((char *)(ptr)-offsetof(type, member)))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b) min((t)(a), (t)(b))
+#define DIV_ROUND_UP(n, d) (((n) + (d)-1) / (d))
+#define ilog2(n) (63 - __builtin_clzll((unsigned long long)(n)))
+#define div_u64(a, b) ((u64)(a) / (u32)(b))
+#define div64_u64(a, b) ((u64)(a) / (u64)(b))
+#define roundup_pow_of_two(n) \
+  ((n) <= 1 ? 1UL : 1UL << (64 - __builtin_clzl((unsigned long)(n)-1)))
+#define max_t(t, a, b) max((t)(a), (t)(b))
+#define clamp_val(v, lo, hi) min(max((v), (lo)), (hi))
+#define clamp(v, lo, hi) clamp_val(v, lo, hi)
+#define abs(x) ((x) < 0 ? -(x) : (x))
+#define DIV_ROUND_CLOSEST(x, d) (((x) + ((d) / 2)) / (d))
+#define BIT(n) (1UL << (n))
+#define U32_MAX ((u32)~0U)
+#define BITS_PER_LONG (sizeof(long) * 8)
+#define BITS_TO_LONGS(n) (((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define BUILD_BUG_ON(cond) _Static_assert(!(cond), #cond)
+
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v) (*(volatile __typeof__(x) *)&(x) = (v))
+#define smp_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_mb__after_atomic() smp_mb()
+#define smp_mb__before_atomic() smp_mb()
+#define barrier() __asm__ __volatile__("" ::: "memory")
+
+#define cpu_to_le16(x) ((u16)(x))
+#define cpu_to_le32(x) ((u32)(x))
+#define cpu_to_le64(x) ((u64)(x))
+#define le16_to_cpu(x) ((u16)(x))
+#define le32_to_cpu(x) ((u32)(x))
+#define le64_to_cpu(x) ((u64)(x))
+
+#define GFP_KERNEL 0
+#define kzalloc(size, gfp) calloc(1, (size))
+#define kmalloc(size, gfp) malloc(size)
+#define kcalloc(n, size, gfp) calloc((n), (size))
+#define kfree(p) free((void *)(p))
+#define kvcalloc(n, size, gfp) calloc((n), (size))
+#define kvfree(p) free((void *)(p))
+
+//// errors
+#define MAX_ERRNO 4095
+#define IS_ERR_VALUE(x) ((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+static inline void *ERR_PTR(long error) { return (void *)error; }
+static inline long PTR_ERR(const void *ptr) { return (long)ptr; }
+static inline bool IS_ERR(const void *ptr) { return IS_ERR_VALUE(ptr); }
+static inline bool IS_ERR_OR_NULL(const void *ptr) {
+  return !ptr || IS_ERR_VALUE(ptr);
+}
+#define ENOTSUPP 524
+
+//// printk
+#define KERN_EMERG ""
+#define KERN_ALERT ""
+#define KERN_CRIT ""
+#define KERN_ERR ""
+#define KERN_WARNING ""
+#define KERN_NOTICE ""
+#define KERN_INFO ""
+#define KERN_DEBUG ""
+int printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+#define pr_err(fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...) \
+  do {                     \
+  } while (0)
+
+//// strings
+int kstrtouint(const char *s, unsigned int base, unsigned int *res);
+int kstrtoint(const char *s, unsigned int base, int *res);
+int kstrtol(const char *s, unsigned int base, long *res);
+int kstrtoul(const char *s, unsigned int base, unsigned long *res);
+int kstrtobool(const char *s, bool *res);
+char *strim(char *s);
+bool sysfs_streq(const char *s1, const char *s2);
+int sysfs_emit(char *buf, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+#define scnprintf(buf, size, fmt, ...) \
+  min_t(int, snprintf(buf, size, fmt, ##__VA_ARGS__), (int)(size)-1)
+
+//////
+////// MODULE
+//////
+
+struct module {
+  int dummy;
+};
+#define THIS_MODULE ((struct module *)NULL)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_LICENSE(x)
+#define MODULE_VERSION(x)
+#define MODULE_PARM_DESC(name, desc)
+#define MODULE_DEVICE_TABLE(type, name)
+
+// module parameters are registered by name, so the simulator can set them
+enum sim_param_type { SIM_PARAM_UINT, SIM_PARAM_INT, SIM_PARAM_BOOL };
+void sim_param_register(const char *name, void *ptr, enum sim_param_type type);
+#define sim_param_type_uint SIM_PARAM_UINT
+#define sim_param_type_int SIM_PARAM_INT
+#define sim_param_type_bool SIM_PARAM_BOOL
+#define module_param(name, type, perm)                           \
+  static void __attribute__((constructor)) __sim_param_##name(void) { \
+    sim_param_register(#name, &name, sim_param_type_##type);     \
+  }
+
+#define module_init(fn) \
+  int sim_module_init(void) { return fn(); }
+#define module_exit(fn) \
+  void sim_module_exit(void) { fn(); }
+
+//////
+////// ATOMICS, BITOPS, LOCKING
+//////
+
+typedef struct {
+  long counter;
+} atomic_long_t;
+typedef struct {
+  int counter;
+} atomic_t;
+typedef struct {
+  long long counter;
+} atomic64_t;
+#define ATOMIC_INIT(i) \
+  { (i) }
+#define atomic_long_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_long_set(v, i) \
+  __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic_long_inc(v) __atomic_fetch_add(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_long_add(i, v) \
+  __atomic_fetch_add(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic64_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic64_set(v, i) \
+  __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic64_add(i, v) \
+  __atomic_fetch_add(&(v)->counter, (i), __ATOMIC_RELAXED)
+static inline long long atomic64_cmpxchg(atomic64_t *v, long long old,
+                                         long long new) {
+  __atomic_compare_exchange_n(&v->counter, &old, new, false, __ATOMIC_SEQ_CST,
+                              __ATOMIC_SEQ_CST);
+  return old;
+}
+#define atomic_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_set(v, i) __atomic_store_n(&(v)->counter, (i), __ATOMIC_RELAXED)
+#define atomic_inc(v) __atomic_fetch_add(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_dec(v) __atomic_fetch_sub(&(v)->counter, 1, __ATOMIC_RELAXED)
+#define atomic_inc_return(v) \
+  __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+
+static inline bool test_bit(long nr, const volatile unsigned long *addr) {
+  return (__atomic_load_n(&addr[nr / BITS_PER_LONG], __ATOMIC_RELAXED) >>
+          (nr % BITS_PER_LONG)) &
+         1;
+}
+static inline void set_bit(long nr, volatile unsigned long *addr) {
+  __atomic_fetch_or(&addr[nr / BITS_PER_LONG], BIT(nr % BITS_PER_LONG),
+                    __ATOMIC_SEQ_CST);
+}
+static inline void clear_bit(long nr, volatile unsigned long *addr) {
+  __atomic_fetch_and(&addr[nr / BITS_PER_LONG], ~BIT(nr % BITS_PER_LONG),
+                     __ATOMIC_SEQ_CST);
+}
+static inline bool test_and_set_bit(long nr, volatile unsigned long *addr) {
+  return __atomic_fetch_or(&addr[nr / BITS_PER_LONG], BIT(nr % BITS_PER_LONG),
+                           __ATOMIC_SEQ_CST) &
+         BIT(nr % BITS_PER_LONG);
+}
+static inline bool test_and_clear_bit(long nr, volatile unsigned long *addr) {
+  return __atomic_fetch_and(&addr[nr / BITS_PER_LONG],
+                            ~BIT(nr % BITS_PER_LONG), __ATOMIC_SEQ_CST) &
+         BIT(nr % BITS_PER_LONG);
+}
+
+//// mutex / spinlock
+struct mutex {
+  pthread_mutex_t lock;
+};
+#define DEFINE_MUTEX(name) struct mutex name = {PTHREAD_MUTEX_INITIALIZER}
+#define mutex_init(m) pthread_mutex_init(&(m)->lock, NULL)
+#define mutex_lock(m) pthread_mutex_lock(&(m)->lock)
+#define mutex_unlock(m) pthread_mutex_unlock(&(m)->lock)
+#define mutex_trylock(m) (pthread_mutex_trylock(&(m)->lock) == 0)
+#define mutex_destroy(m) pthread_mutex_destroy(&(m)->lock)
+#define lockdep_is_held(l) 1
+#define lockdep_assert_held(l) \
+  do {                         \
+  } while (0)
+
+typedef struct {
+  pthread_mutex_t lock;
+} spinlock_t;
+#define DEFINE_SPINLOCK(name) spinlock_t name = {PTHREAD_MUTEX_INITIALIZER}
+#define spin_lock_init(s) pthread_mutex_init(&(s)->lock, NULL)
+#define spin_lock(s) pthread_mutex_lock(&(s)->lock)
+#define spin_unlock(s) pthread_mutex_unlock(&(s)->lock)
+#define spin_lock_irqsave(s, flags) \
+  do {                              \
+    (void)(flags);                  \
+    pthread_mutex_lock(&(s)->lock); \
+  } while (0)
+#define spin_unlock_irqrestore(s, flags) \
+  do {                                   \
+    (void)(flags);                       \
+    pthread_mutex_unlock(&(s)->lock);    \
+  } while (0)
+
+//// seqlock / seqcount
+typedef struct {
+  unsigned int sequence;
+} seqcount_t;
+typedef struct {
+  seqcount_t seqcount;
+  spinlock_t lock;
+} seqlock_t;
+#define SEQCNT_ZERO(name) \
+  { 0 }
+#define seqcount_init(s) ((s)->sequence = 0)
+#define DEFINE_SEQLOCK(name) \
+  seqlock_t name = {{0}, {PTHREAD_MUTEX_INITIALIZER}}
+#define seqlock_init(s)             \
+  do {                              \
+    (s)->seqcount.sequence = 0;     \
+    spin_lock_init(&(s)->lock);     \
+  } while (0)
+
+static inline unsigned int read_seqcount_begin(const seqcount_t *s) {
+  unsigned int seq;
+
+  while ((seq = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE)) & 1)
+    ;
+  return seq;
+}
+static inline int read_seqcount_retry(const seqcount_t *s, unsigned int seq) {
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != seq;
+}
+static inline void write_seqcount_begin(seqcount_t *s) {
+  __atomic_fetch_add(&s->sequence, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+static inline void write_seqcount_end(seqcount_t *s) {
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_fetch_add(&s->sequence, 1, __ATOMIC_RELAXED);
+}
+#define raw_read_seqcount_begin read_seqcount_begin
+#define raw_write_seqcount_begin write_seqcount_begin
+#define raw_write_seqcount_end write_seqcount_end
+#define read_seqbegin(sl) read_seqcount_begin(&(sl)->seqcount)
+#define read_seqretry(sl, seq) read_seqcount_retry(&(sl)->seqcount, (seq))
+#define write_seqlock(sl)                   \
+  do {                                      \
+    spin_lock(&(sl)->lock);                 \
+    write_seqcount_begin(&(sl)->seqcount);  \
+  } while (0)
+#define write_sequnlock(sl)                 \
+  do {                                      \
+    write_seqcount_end(&(sl)->seqcount);    \
+    spin_unlock(&(sl)->lock);               \
+  } while (0)
+
+//// rcu (readers share, synchronize waits for all of them)
+extern pthread_rwlock_t sim_rcu_lock;
+#define rcu_read_lock() pthread_rwlock_rdlock(&sim_rcu_lock)
+#define rcu_read_unlock() pthread_rwlock_unlock(&sim_rcu_lock)
+#define synchronize_rcu()                      \
+  do {                                         \
+    pthread_rwlock_wrlock(&sim_rcu_lock);      \
+    pthread_rwlock_unlock(&sim_rcu_lock);      \
+  } while (0)
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define rcu_dereference_protected(p, c) (p)
+#define rcu_access_pointer(p) READ_ONCE(p)
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define RCU_INIT_POINTER(p, v) ((p) = (v))
+
+//////
+////// TIME
+//////
+
+#define HZ 1000
+// simulated time, scaled against real time by sim_time_scale
+extern double sim_time_scale;
+unsigned long sim_jiffies(void);
+u64 sim_ktime_ns(void);
+#define jiffies sim_jiffies()
+#define time_after(a, b) ((long)((b) - (a)) < 0)
+#define time_before(a, b) time_after(b, a)
+#define time_after_eq(a, b) ((long)((a) - (b)) >= 0)
+#define time_before_eq(a, b) time_after_eq(b, a)
+#define msecs_to_jiffies(m) ((unsigned long)(m))
+#define jiffies_to_msecs(j) ((unsigned int)(j))
+#define NSEC_PER_USEC 1000L
+#define NSEC_PER_MSEC 1000000L
+#define NSEC_PER_SEC 1000000000L
+#define USEC_PER_MSEC 1000L
+
+typedef s64 ktime_t;
+#define ktime_get() ((ktime_t)sim_ktime_ns())
+#define ktime_get_ns() sim_ktime_ns()
+#define ktime_get_boottime_ns() sim_ktime_ns()
+#define ktime_sub(a, b) ((a) - (b))
+#define ktime_to_ns(t) ((s64)(t))
+#define ktime_to_us(t) ((s64)(t) / 1000)
+#define ktime_us_delta(a, b) (((a) - (b)) / 1000)
+void msleep(unsigned int ms);
+void usleep_range(unsigned long min, unsigned long max);
+
+//////
+////// WORKQUEUE
+//////
+
+struct workqueue_struct;
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+  work_func_t func;
+  // simulation bookkeeping
+  struct workqueue_struct *wq;
+  struct work_struct *next;
+  unsigned long due;
+  bool pending;
+  bool running;
+  bool canceling;
+  unsigned long queued_seq;
+  unsigned long started_seq;
+  unsigned long done_seq;
+};
+
+struct delayed_work {
+  struct work_struct work;
+};
+
+#define __WORK_INITIALIZER(n, f) \
+  { .func = (f) }
+#define DECLARE_WORK(n, f) struct work_struct n = __WORK_INITIALIZER(n, f)
+#define DECLARE_DELAYED_WORK(n, f) \
+  struct delayed_work n = {.work = __WORK_INITIALIZER(n.work, f)}
+#define INIT_WORK(w, f)                  \
+  do {                                   \
+    memset((w), 0, sizeof(*(w)));        \
+    (w)->func = (f);                     \
+  } while (0)
+#define INIT_DELAYED_WORK(dw, f) INIT_WORK(&(dw)->work, f)
+#define to_delayed_work(w) container_of(w, struct delayed_work, work)
+
+extern struct workqueue_struct *system_wq;
+#define WQ_MEM_RECLAIM 0
+#define WQ_HIGHPRI 0
+#define WQ_FREEZABLE 0
+struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags,
+                                         int max_active, ...);
+#define alloc_ordered_workqueue(fmt, flags, ...) \
+  alloc_workqueue(fmt, flags, 1, ##__VA_ARGS__)
+void destroy_workqueue(struct workqueue_struct *wq);
+void flush_workqueue(struct workqueue_struct *wq);
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dw,
+                        unsigned long delay);
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dw,
+                      unsigned long delay);
+bool flush_work(struct work_struct *work);
+bool flush_delayed_work(struct delayed_work *dw);
+bool cancel_work_sync(struct work_struct *work);
+bool cancel_delayed_work_sync(struct delayed_work *dw);
+bool cancel_delayed_work(struct delayed_work *dw);
+#define schedule_work(w) queue_work(system_wq, (w))
+#define schedule_delayed_work(dw, d) queue_delayed_work(system_wq, (dw), (d))
+static inline bool delayed_work_pending(struct delayed_work *dw) {
+  return READ_ONCE(dw->work.pending);
+}
+#define work_pending(w) READ_ONCE((w)->pending)
+
+//////
+////// DEVICE MODEL / SYSFS
+//////
+
+struct kobject {
+  const char *name;
+};
+
+struct attribute {
+  const char *name;
+  umode_t mode;
+};
+
+struct device;
+struct device_attribute {
+  struct attribute attr;
+  ssize_t (*show)(struct device *dev, struct device_attribute *attr,
+                  char *buf);
+  ssize_t (*store)(struct device *dev, struct device_attribute *attr,
+                   const char *buf, size_t count);
+};
+
+struct file;
+struct bin_attribute {
+  struct attribute attr;
+  size_t size;
+  void *private;
+  ssize_t (*read)(struct file *filp, struct kobject *kobj,
+                  struct bin_attribute *attr, char *buf, loff_t off,
+                  size_t count);
+  ssize_t (*write)(struct file *filp, struct kobject *kobj,
+                   struct bin_attribute *attr, char *buf, loff_t off,
+                   size_t count);
+};
+
+struct attribute_group {
+  const char *name;
+  umode_t (*is_visible)(struct kobject *kobj, struct attribute *attr, int n);
+  umode_t (*is_bin_visible)(struct kobject *kobj, struct bin_attribute *attr,
+                            int n);
+  struct attribute **attrs;
+  struct bin_attribute **bin_attrs;
+};
+
+#define S_IRUGO (S_IRUSR | S_IRGRP | S_IROTH)
+#define S_IWUGO (S_IWUSR | S_IWGRP | S_IWOTH)
+#define __ATTR(_name, _mode, _show, _store) \
+  {                                         \
+    .attr = {.name = __stringify(_name),    \
+             .mode = (_mode)},              \
+    .show = (_show), .store = (_store)      \
+  }
+#define __ATTR_RO(_name) __ATTR(_name, S_IRUGO, _name##_show, NULL)
+#define __ATTR_RW(_name) \
+  __ATTR(_name, S_IWUSR | S_IRUGO, _name##_show, _name##_store)
+#define DEVICE_ATTR(_name, _mode, _show, _store) \
+  struct device_attribute dev_attr_##_name = __ATTR(_name, _mode, _show, _store)
+#define DEVICE_ATTR_RO(_name) \
+  struct device_attribute dev_attr_##_name = __ATTR_RO(_name)
+#define DEVICE_ATTR_RW(_name) \
+  struct device_attribute dev_attr_##_name = __ATTR_RW(_name)
+#define __ATTRIBUTE_GROUPS(_name)                          \
+  static const struct attribute_group *_name##_groups[] = { \
+      &_name##_group,                                       \
+      NULL,                                                 \
+  }
+#define ATTRIBUTE_GROUPS(_name)                                      \
+  static const struct attribute_group _name##_group = {              \
+      .attrs = _name##_attrs,                                        \
+  };                                                                 \
+  __ATTRIBUTE_GROUPS(_name)
+
+enum probe_type {
+  PROBE_DEFAULT_STRATEGY,
+  PROBE_PREFER_ASYNCHRONOUS,
+  PROBE_FORCE_SYNCHRONOUS,
+};
+
+// system sleep only
+struct dev_pm_ops {
+  int (*suspend)(struct device *dev);
+  int (*resume)(struct device *dev);
+};
+#define SIMPLE_DEV_PM_OPS(name, suspend_fn, resume_fn) \
+  const struct dev_pm_ops __maybe_unused name = {      \
+      .suspend = suspend_fn, .resume = resume_fn}
+
+struct device_driver {
+  const char *name;
+  struct module *owner;
+  int probe_type;
+  bool suppress_bind_attrs;
+  const struct dev_pm_ops *pm;
+};
+
+struct device {
+  struct kobject kobj;
+  struct device *parent;
+  struct device_driver *driver;
+  void *driver_data;
+  const struct attribute_group **groups;
+};
+
+static inline void *dev_get_drvdata(const struct device *dev) {
+  return dev->driver_data;
+}
+static inline void dev_set_drvdata(struct device *dev, void *data) {
+  dev->driver_data = data;
+}
+#define kobj_to_dev(k) container_of(k, struct device, kobj)
+#define dev_name(dev) ((dev)->kobj.name)
+#define dev_err(dev, fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define dev_warn(dev, fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define dev_info(dev, fmt, ...) printk(fmt, ##__VA_ARGS__)
+#define dev_dbg(dev, fmt, ...) \
+  do {                         \
+  } while (0)
+
+int sysfs_create_group(struct kobject *kobj, const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj,
+                        const struct attribute_group *grp);
+void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr);
+ssize_t memory_read_from_buffer(void *to, size_t count, loff_t *ppos,
+                                const void *from, size_t available);
+
+//// platform device
+struct platform_device {
+  const char *name;
+  int id;
+  struct device dev;
+  // probe succeeded, so remove() is due on unregister
+  bool bound;
+};
+
+struct platform_driver {
+  int (*probe)(struct platform_device *pdev);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+  void (*remove)(struct platform_device *pdev);
+#else
+  int (*remove)(struct platform_device *pdev);
+#endif
+  struct device_driver driver;
+};
+
+#define platform_get_drvdata(pdev) dev_get_drvdata(&(pdev)->dev)
+#define platform_set_drvdata(pdev, data) dev_set_drvdata(&(pdev)->dev, (data))
+struct resource;
+struct platform_device *platform_create_bundle(
+    struct platform_driver *driver, int (*probe)(struct platform_device *),
+    struct resource *res, unsigned int n_res, const void *data, size_t size);
+int platform_driver_register(struct platform_driver *drv);
+struct platform_device *platform_device_register_simple(
+    const char *name, int id, const struct resource *res, unsigned int num);
+void platform_device_unregister(struct platform_device *pdev);
+void platform_driver_unregister(struct platform_driver *drv);
+
+//// hwmon
+enum hwmon_sensor_types {
+  hwmon_chip,
+  hwmon_temp,
+  hwmon_in,
+  hwmon_curr,
+  hwmon_power,
+  hwmon_energy,
+  hwmon_energy64,
+  hwmon_humidity,
+  hwmon_fan,
+  hwmon_pwm,
+  hwmon_intrusion,
+  hwmon_max,
+};
+
+enum hwmon_chip_attributes {
+  hwmon_chip_temp_reset_history,
+  hwmon_chip_in_reset_history,
+  hwmon_chip_curr_reset_history,
+  hwmon_chip_power_reset_history,
+  hwmon_chip_register_tz,
+  hwmon_chip_update_interval,
+  hwmon_chip_alarms,
+  hwmon_chip_samples,
+  hwmon_chip_curr_samples,
+  hwmon_chip_in_samples,
+  hwmon_chip_power_samples,
+  hwmon_chip_temp_samples,
+  hwmon_chip_beep_enable,
+  hwmon_chip_pec,
+};
+#define HWMON_C_REGISTER_TZ BIT(hwmon_chip_register_tz)
+#define HWMON_C_UPDATE_INTERVAL BIT(hwmon_chip_update_interval)
+#define HWMON_C_ALARMS BIT(hwmon_chip_alarms)
+
+enum hwmon_temp_attributes {
+  hwmon_temp_enable,
+  hwmon_temp_input,
+  hwmon_temp_type,
+  hwmon_temp_lcrit,
+  hwmon_temp_lcrit_hyst,
+  hwmon_temp_min,
+  hwmon_temp_min_hyst,
+  hwmon_temp_max,
+  hwmon_temp_max_hyst,
+  hwmon_temp_crit,
+  hwmon_temp_crit_hyst,
+  hwmon_temp_emergency,
+  hwmon_temp_emergency_hyst,
+  hwmon_temp_alarm,
+  hwmon_temp_lcrit_alarm,
+  hwmon_temp_min_alarm,
+  hwmon_temp_max_alarm,
+  hwmon_temp_crit_alarm,
+  hwmon_temp_emergency_alarm,
+  hwmon_temp_fault,
+  hwmon_temp_offset,
+  hwmon_temp_label,
+  hwmon_temp_lowest,
+  hwmon_temp_highest,
+  hwmon_temp_reset_history,
+  hwmon_temp_rated_min,
+  hwmon_temp_rated_max,
+  hwmon_temp_beep,
+};
+#define HWMON_T_INPUT BIT(hwmon_temp_input)
+#define HWMON_T_MAX BIT(hwmon_temp_max)
+#define HWMON_T_MAX_HYST BIT(hwmon_temp_max_hyst)
+#define HWMON_T_CRIT BIT(hwmon_temp_crit)
+#define HWMON_T_CRIT_HYST BIT(hwmon_temp_crit_hyst)
+#define HWMON_T_ALARM BIT(hwmon_temp_alarm)
+#define HWMON_T_MAX_ALARM BIT(hwmon_temp_max_alarm)
+#define HWMON_T_CRIT_ALARM BIT(hwmon_temp_crit_alarm)
+#define HWMON_T_FAULT BIT(hwmon_temp_fault)
+#define HWMON_T_LABEL BIT(hwmon_temp_label)
+
+enum hwmon_fan_attributes {
+  hwmon_fan_enable,
+  hwmon_fan_input,
+  hwmon_fan_label,
+  hwmon_fan_min,
+  hwmon_fan_max,
+  hwmon_fan_div,
+  hwmon_fan_pulses,
+  hwmon_fan_target,
+  hwmon_fan_alarm,
+  hwmon_fan_min_alarm,
+  hwmon_fan_max_alarm,
+  hwmon_fan_fault,
+  hwmon_fan_beep,
+};
+#define HWMON_F_INPUT BIT(hwmon_fan_input)
+#define HWMON_F_LABEL BIT(hwmon_fan_label)
+#define HWMON_F_MIN BIT(hwmon_fan_min)
+#define HWMON_F_MAX BIT(hwmon_fan_max)
+#define HWMON_F_TARGET BIT(hwmon_fan_target)
+#define HWMON_F_ALARM BIT(hwmon_fan_alarm)
+#define HWMON_F_MIN_ALARM BIT(hwmon_fan_min_alarm)
+#define HWMON_F_FAULT BIT(hwmon_fan_fault)
+
+enum hwmon_pwm_attributes {
+  hwmon_pwm_input,
+  hwmon_pwm_enable,
+  hwmon_pwm_mode,
+  hwmon_pwm_freq,
+  hwmon_pwm_auto_channels_temp,
+};
+#define HWMON_PWM_INPUT BIT(hwmon_pwm_input)
+#define HWMON_PWM_ENABLE BIT(hwmon_pwm_enable)
+#define HWMON_PWM_MODE BIT(hwmon_pwm_mode)
+#define HWMON_PWM_FREQ BIT(hwmon_pwm_freq)
+
+struct hwmon_ops {
+  umode_t (*is_visible)(const void *drvdata, enum hwmon_sensor_types type,
+                        u32 attr, int channel);
+  int (*read)(struct device *dev, enum hwmon_sensor_types type, u32 attr,
+              int channel, long *val);
+  int (*read_string)(struct device *dev, enum hwmon_sensor_types type,
+                     u32 attr, int channel, const char **str);
+  int (*write)(struct device *dev, enum hwmon_sensor_types type, u32 attr,
+               int channel, long val);
+};
+
+struct hwmon_channel_info {
+  enum hwmon_sensor_types type;
+  const u32 *config;
+};
+#define HWMON_CHANNEL_INFO(stype, ...)                \
+  (&(const struct hwmon_channel_info){                \
+      .type = hwmon_##stype,                          \
+      .config = (const u32[]){__VA_ARGS__, 0},        \
+  })
+
+struct hwmon_chip_info {
+  const struct hwmon_ops *ops;
+  const struct hwmon_channel_info *const *info;
+};
+
+struct device *hwmon_device_register_with_groups(
+    struct device *dev, const char *name, void *drvdata,
+    const struct attribute_group **groups);
+struct device *hwmon_device_register_with_info(
+    struct device *dev, const char *name, void *drvdata,
+    const struct hwmon_chip_info *info,
+    const struct attribute_group **extra_groups);
+void hwmon_device_unregister(struct device *dev);
+int hwmon_notify_event(struct device *dev, enum hwmon_sensor_types type,
+                       u32 attr, int channel);
+
+struct sensor_device_attribute {
+  struct device_attribute dev_attr;
+  int index;
+};
+struct sensor_device_attribute_2 {
+  struct device_attribute dev_attr;
+  u8 index;
+  u8 nr;
+};
+#define to_sensor_dev_attr(_dev_attr) \
+  container_of(_dev_attr, struct sensor_device_attribute, dev_attr)
+#define to_sensor_dev_attr_2(_dev_attr) \
+  container_of(_dev_attr, struct sensor_device_attribute_2, dev_attr)
+#define SENSOR_ATTR(_name, _mode, _show, _store, _index) \
+  { .dev_attr = __ATTR(_name, _mode, _show, _store), .index = (_index) }
+#define SENSOR_ATTR_2(_name, _mode, _show, _store, _nr, _index)     \
+  {                                                                 \
+    .dev_attr = __ATTR(_name, _mode, _show, _store), .index = (_index), \
+    .nr = (_nr)                                                     \
+  }
+#define SENSOR_DEVICE_ATTR(_name, _mode, _show, _store, _index) \
+  struct sensor_device_attribute sensor_dev_attr_##_name =      \
+      SENSOR_ATTR(_name, _mode, _show, _store, _index)
+#define SENSOR_DEVICE_ATTR_2(_name, _mode, _show, _store, _nr, _index) \
+  struct sensor_device_attribute_2 sensor_dev_attr_##_name =           \
+      SENSOR_ATTR_2(_name, _mode, _show, _store, _nr, _index)
+
+//////
+////// DEBUGFS / SEQ_FILE
+//////
+
+struct inode {
+  void *i_private;
+};
+
+#define FMODE_READ 0x1
+#define FMODE_WRITE 0x2
+
+struct file {
+  void *private_data;
+  loff_t f_pos;
+  unsigned int f_flags;
+  fmode_t f_mode;
+};
+
+struct vm_area_struct;
+struct poll_table_struct;
+typedef struct poll_table_struct poll_table;
+
+struct file_operations {
+  struct module *owner;
+  int (*open)(struct inode *inode, struct file *file);
+  ssize_t (*read)(struct file *file, char __user *buf, size_t count,
+                  loff_t *ppos);
+  ssize_t (*write)(struct file *file, const char __user *buf, size_t count,
+                   loff_t *ppos);
+  loff_t (*llseek)(struct file *file, loff_t offset, int whence);
+  int (*release)(struct inode *inode, struct file *file);
+  long (*unlocked_ioctl)(struct file *file, unsigned int cmd,
+                         unsigned long arg);
+  long (*compat_ioctl)(struct file *file, unsigned int cmd,
+                       unsigned long arg);
+  int (*mmap)(struct file *file, struct vm_area_struct *vma);
+  unsigned int (*poll)(struct file *file, poll_table *wait);
+};
+
+struct seq_file {
+  char *buf;
+  size_t size;
+  size_t count;
+  int (*show)(struct seq_file *m, void *v);
+  void *private;
+};
+
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void seq_puts(struct seq_file *m, const char *s);
+void seq_putc(struct seq_file *m, char c);
+int single_open(struct file *file, int (*show)(struct seq_file *, void *),
+                void *data);
+int single_release(struct inode *inode, struct file *file);
+ssize_t seq_read(struct file *file, char __user *buf, size_t count,
+                 loff_t *ppos);
+loff_t seq_lseek(struct file *file, loff_t offset, int whence);
+loff_t default_llseek(struct file *file, loff_t offset, int whence);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 12, 0)
+loff_t no_llseek(struct file *file, loff_t offset, int whence);
+#endif
+int simple_open(struct inode *inode, struct file *file);
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos,
+                                const void *from, size_t available);
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos,
+                               const void __user *from, size_t count);
+#define copy_to_user(to, from, n) (memcpy((to), (from), (n)), 0UL)
+#define copy_from_user(to, from, n) (memcpy((to), (from), (n)), 0UL)
+
+#define DEFINE_SHOW_ATTRIBUTE(__name)                                   \
+  static int __name##_open(struct inode *inode, struct file *file) {   \
+    return single_open(file, __name##_show, inode->i_private);         \
+  }                                                                    \
+  static const struct file_operations __name##_fops = {                \
+      .owner = THIS_MODULE,                                            \
+      .open = __name##_open,                                           \
+      .read = seq_read,                                                \
+      .llseek = seq_lseek,                                             \
+      .release = single_release,                                       \
+  }
+
+struct dentry;
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, umode_t mode,
+                                   struct dentry *parent, void *data,
+                                   const struct file_operations *fops);
+void debugfs_create_u32(const char *name, umode_t mode, struct dentry *parent,
+                        u32 *value);
+void debugfs_create_bool(const char *name, umode_t mode,
+                         struct dentry *parent, bool *value);
+void debugfs_remove_recursive(struct dentry *dentry);
+
+//////
+////// MISC DEVICE / MM
+//////
+
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+
+// a page is its address, there is no memmap
+struct page;
+#define virt_to_page(addr) ((struct page *)(addr))
+unsigned long get_zeroed_page(gfp_t gfp);
+void free_page(unsigned long addr);
+
+#define VM_READ 0x1UL
+#define VM_WRITE 0x2UL
+#define VM_MAYREAD 0x10UL
+#define VM_MAYWRITE 0x20UL
+
+struct vm_area_struct {
+  unsigned long vm_start;
+  unsigned long vm_end;
+  unsigned long vm_pgoff;
+  unsigned long vm_flags;
+  // what vm_insert_page() mapped, the simulator reads through it
+  struct page *sim_page;
+};
+
+static inline void vm_flags_clear(struct vm_area_struct *vma,
+                                  unsigned long flags) {
+  vma->vm_flags &= ~flags;
+}
+int vm_insert_page(struct vm_area_struct *vma, unsigned long addr,
+                   struct page *page);
+
+#define MISC_DYNAMIC_MINOR 255
+
+// one device at a time, opened by sim_dev_open()
+struct miscdevice {
+  int minor;
+  const char *name;
+  const struct file_operations *fops;
+  struct device *parent;
+  umode_t mode;
+};
+
+int misc_register(struct miscdevice *misc);
+void misc_deregister(struct miscdevice *misc);
+long compat_ptr_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+loff_t noop_llseek(struct file *file, loff_t offset, int whence);
+
+//////
+////// THERMAL
+//////
+
+enum thermal_trip_type {
+  THERMAL_TRIP_ACTIVE,
+  THERMAL_TRIP_PASSIVE,
+  THERMAL_TRIP_HOT,
+  THERMAL_TRIP_CRITICAL,
+};
+
+struct thermal_trip {
+  int temperature;
+  int hysteresis;
+  int threshold;
+  enum thermal_trip_type type;
+  u8 flags;
+  void *priv;
+};
+
+struct thermal_cooling_device;
+struct thermal_zone_device;
+struct thermal_zone_params;
+
+struct thermal_cooling_device_ops {
+  int (*get_max_state)(struct thermal_cooling_device *, unsigned long *);
+  int (*get_cur_state)(struct thermal_cooling_device *, unsigned long *);
+  int (*set_cur_state)(struct thermal_cooling_device *, unsigned long);
+};
+
+struct thermal_cooling_device {
+  const char *type;
+  void *devdata;
+  const struct thermal_cooling_device_ops *ops;
+};
+
+#define THERMAL_NO_LIMIT (~0UL)
+#define THERMAL_WEIGHT_DEFAULT 0
+
+// what the core binds with, unless should_bind() changes it
+struct cooling_spec {
+  unsigned long upper;
+  unsigned long lower;
+  unsigned int weight;
+};
+
+struct thermal_zone_device_ops {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+  // asked by the core for every trip of the zone and cooling device
+  bool (*should_bind)(struct thermal_zone_device *,
+                      const struct thermal_trip *,
+                      struct thermal_cooling_device *, struct cooling_spec *);
+#else
+  int (*bind)(struct thermal_zone_device *, struct thermal_cooling_device *);
+  int (*unbind)(struct thermal_zone_device *,
+                struct thermal_cooling_device *);
+#endif
+  int (*get_temp)(struct thermal_zone_device *, int *);
+};
+
+struct thermal_cooling_device *thermal_cooling_device_register(
+    const char *type, void *devdata,
+    const struct thermal_cooling_device_ops *ops);
+void thermal_cooling_device_unregister(struct thermal_cooling_device *cdev);
+struct thermal_zone_device *thermal_zone_device_register_with_trips(
+    const char *type, const struct thermal_trip *trips, int num_trips,
+    void *devdata, const struct thermal_zone_device_ops *ops,
+    const struct thermal_zone_params *tzp, unsigned int passive_delay,
+    unsigned int polling_delay);
+int thermal_zone_device_enable(struct thermal_zone_device *tz);
+void thermal_zone_device_unregister(struct thermal_zone_device *tz);
+void *thermal_zone_device_priv(struct thermal_zone_device *tz);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 12, 0)
+int thermal_zone_bind_cooling_device(struct thermal_zone_device *tz,
+                                     int trip,
+                                     struct thermal_cooling_device *cdev,
+                                     unsigned long upper, unsigned long lower,
+                                     unsigned int weight);
+int thermal_zone_unbind_cooling_device(struct thermal_zone_device *tz,
+                                       int trip,
+                                       struct thermal_cooling_device *cdev);
+#endif
+
+//////
+////// PLATFORM PROFILE
+//////
+
+enum platform_profile_option {
+  PLATFORM_PROFILE_LOW_POWER,
+  PLATFORM_PROFILE_COOL,
+  PLATFORM_PROFILE_QUIET,
+  PLATFORM_PROFILE_BALANCED,
+  PLATFORM_PROFILE_BALANCED_PERFORMANCE,
+  PLATFORM_PROFILE_PERFORMANCE,
+  PLATFORM_PROFILE_LAST,
+};
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+struct platform_profile_ops {
+  int (*probe)(void *drvdata, unsigned long *choices);
+  int (*profile_get)(struct device *dev,
+                     enum platform_profile_option *profile);
+  int (*profile_set)(struct device *dev, enum platform_profile_option profile);
+};
+
+// one handler at most, the class device has 'drvdata' as its drvdata
+struct device *platform_profile_register(
+    struct device *dev, const char *name, void *drvdata,
+    const struct platform_profile_ops *ops);
+void platform_profile_remove(struct device *dev);
+void platform_profile_notify(struct device *dev);
+#else
+struct platform_profile_handler {
+  unsigned long choices[BITS_TO_LONGS(PLATFORM_PROFILE_LAST)];
+  int (*profile_get)(struct platform_profile_handler *pprof,
+                     enum platform_profile_option *profile);
+  int (*profile_set)(struct platform_profile_handler *pprof,
+                     enum platform_profile_option profile);
+};
+
+// one handler system wide, like the core before 6.14
+int platform_profile_register(struct platform_profile_handler *pprof);
+int platform_profile_remove(void);
+void platform_profile_notify(void);
+#endif
+
+//////
+////// TRACEPOINTS
+//////
+
+// every event is counted by name, the fields are ignored
+void sim_trace(const char *event);
+#define TP_PROTO(args...) args
+#define TP_ARGS(args...) args
+#define TRACE_EVENT(name, proto, args, tstruct, assign, print) \
+  static inline bool trace_##name##_enabled(void) { return true; } \
+  static inline void trace_##name(proto) { sim_trace(#name); }
+
+//////
+////// ACPI / DMI
+//////
+
+typedef u32 acpi_status;
+typedef void *acpi_handle;
+typedef char *acpi_string;
+typedef u32 acpi_object_type;
+#define AE_OK ((acpi_status)0x0000)
+#define AE_ERROR ((acpi_status)0x0001)
+#define AE_NOT_FOUND ((acpi_status)0x0005)
+#define AE_BAD_PARAMETER ((acpi_status)0x1001)
+#define ACPI_SUCCESS(a) (!(a))
+#define ACPI_FAILURE(a) (a)
+#define ACPI_TYPE_INTEGER 0x01
+
+union acpi_object {
+  acpi_object_type type;
+  struct {
+    acpi_object_type type;
+    u64 value;
+  } integer;
+};
+
+struct acpi_object_list {
+  u32 count;
+  union acpi_object *pointer;
+};
+
+acpi_status acpi_get_handle(acpi_handle parent, acpi_string pathname,
+                            acpi_handle *ret_handle);
+acpi_status acpi_evaluate_integer(acpi_handle handle, acpi_string pathname,
+                                  struct acpi_object_list *arguments,
+                                  unsigned long long *data);
+// embedded controller register space (drivers/acpi/ec.c), 0 or -errno
+int ec_read(u8 addr, u8 *val);
+
+enum dmi_field {
+  DMI_NONE,
+  DMI_BIOS_VENDOR,
+  DMI_SYS_VENDOR,
+  DMI_PRODUCT_NAME,
+  DMI_PRODUCT_VERSION,
+  DMI_BOARD_VENDOR,
+  DMI_BOARD_NAME,
+  DMI_STRING_MAX,
+};
+const char *dmi_get_system_info(int field);
+
+struct dmi_strmatch {
+  unsigned char slot : 7;
+  unsigned char exact_match : 1;
+  char substr[79];
+};
+struct dmi_system_id {
+  int (*callback)(const struct dmi_system_id *);
+  const char *ident;
+  struct dmi_strmatch matches[4];
+  void *driver_data;
+};
+#define DMI_MATCH(a, b) \
+  { .slot = a, .substr = b }
+#define DMI_EXACT_MATCH(a, b) \
+  { .slot = a, .substr = b, .exact_match = 1 }
+const struct dmi_system_id *dmi_first_match(const struct dmi_system_id *list);
+
+#endif
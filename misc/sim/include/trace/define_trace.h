@@ -0,0 +1 @@
+// nothing to create in userspace, see TRACE_EVENT in sim_kernel.h
@@ -0,0 +1,87 @@
+/**
+ *  asus-fan userspace simulation - access to the simulated kernel
+ *
+ *  Loading/unloading the module and reading/writing everything it exposes
+ *  (hwmon and platform attributes, debugfs files, module parameters) by
+ *  name, as a script or a benchmark would do through the filesystem.
+ *
+**/
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// module_init / module_exit of asus_fan.c, each load dlopen()s a fresh
+// copy of the module (see sim_set_module)
+void sim_set_module(const char *path);
+int sim_load(void);
+void sim_unload(void);
+// wait until no work item is queued or running (e.g. before unloading)
+void sim_wq_idle(void);
+// wait for asynchronous probes (like 'udevadm settle' after modprobe)
+void sim_probe_settle(void);
+
+// system sleep of the bound device: the driver's suspend callback / the ec
+// back at its defaults plus the driver's resume callback, 0 or -errno
+int sim_pm_suspend(void);
+int sim_pm_resume(void);
+
+// hwmon and platform attributes, return length / 0 or -errno
+ssize_t sim_attr_read(const char *name, char *buf, size_t size);
+ssize_t sim_attr_write(const char *name, const char *value);
+ssize_t sim_bin_read(const char *name, void *buf, size_t size);
+ssize_t sim_bin_write(const char *name, const void *buf, size_t size);
+// list all visible attributes (one per line)
+void sim_attr_list(void);
+// number of sysfs_notify() calls for 'name' so far
+unsigned long sim_attr_notified(const char *name);
+// number of hits of tracepoint 'event' so far
+unsigned long sim_traced(const char *event);
+
+// thermal framework: set a cooling device's state, read a cooling device's
+// state / a zone's temperature / "<zone>_bound", one step of a minimal
+// step_wise governor on a zone
+int sim_cdev_set(const char *type, unsigned long state);
+int sim_thermal_get(const char *name, long *value);
+int sim_thermal_update(const char *type);
+
+// platform profile by name ("quiet", ...), 0 or -errno (-ENODEV: no
+// handler), 'busy': another driver holds the one handler there is
+int sim_profile_set(const char *name);
+int sim_profile_get(char *buf, size_t size);
+void sim_profile_set_busy(bool busy);
+
+// the module's misc device (/dev/asus_fan), one file held open across
+// calls (closed on unload), 0 or -errno; 'arg' of an ioctl as the user
+// pointer; a mapping lasts until the file is closed (sim_dev_page())
+int sim_dev_open(bool write);
+long sim_dev_ioctl(unsigned int cmd, void *arg);
+int sim_dev_mmap(unsigned long pgoff, size_t size, bool write,
+                 const void **page);
+const void *sim_dev_page(void);
+void sim_dev_close(void);
+
+// debugfs files of the module (name relative to its directory)
+ssize_t sim_debugfs_read(const char *name, char *buf, size_t size);
+ssize_t sim_debugfs_write(const char *name, const void *buf, size_t size);
+// one file held open across calls (closed on unload), one read() each
+int sim_debugfs_open(const char *name);
+ssize_t sim_debugfs_read_held(void *buf, size_t size);
+void sim_debugfs_close(void);
+
+// module parameters, value as text
+int sim_param_set(const char *name, const char *value);
+int sim_param_get(const char *name, char *buf, size_t size);
+
+// dmi strings reported to the module
+void sim_dmi_set(int field, const char *value);
+
+// change the speed of simulated time (1.0 = real time) without a jump
+void sim_set_time_scale(double scale);
+
+// suppress printk output
+extern int sim_quiet;
+
+#endif
@@ -0,0 +1,346 @@
+/**
+ *  asus-fan userspace simulation - simulated embedded controller
+ *
+**/
+#include "sim_ec.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "include/sim_kernel.h"
+
+static const char *const method_names[SIM_METHOD_COUNT] = {
+    "SFNV", "TACH", "TH1R", "ST98", "QMOD"};
+static const char *const method_paths[SIM_METHOD_COUNT] = {
+    "\\_SB.PCI0.LPCB.EC0.SFNV", "\\_SB.PCI0.LPCB.EC0.TACH",
+    "\\_SB.PCI0.LPCB.EC0.TH1R", "\\_SB.PCI0.LPCB.EC0.ST98",
+    "\\_SB.ATKD.QMOD"};
+
+// fan response (pwm -> rpm), same shape as the UX32VD measurement
+static const double curve_pwm[] = {0,   40,  45,  50,  60,  70,  80,
+                                   90,  100, 110, 120, 130, 140, 150,
+                                   160, 170, 180, 190, 255};
+static const double curve_rpm[] = {0,    790,  950,  1110, 1410, 1660, 1890,
+                                   2090, 2290, 2470, 2640, 2800, 2960, 3110,
+                                   3240, 3370, 3500, 3640, 3910};
+
+static struct {
+  //// parameters
+  int fans;             // 1 or 2
+  double latency_us;    // time each AML evaluation takes
+  double ambient;       // degree celsius
+  double load;          // heat input in W
+  double capacity;      // thermal mass in J/K
+  double k_passive;     // cooling without fans in W/K
+  double k_fan;         // additional cooling per 1000 rpm in W/K
+  double fan_tau;       // fan inertia (time constant) in s
+  double fan_scale[2];  // rpm scale per fan (other models)
+  double qfan;          // max speed set by QMOD(1)
+  bool tach_manual;     // TACH reports while in manual mode
+  bool disabled[SIM_METHOD_COUNT];
+  bool disabled_regs;   // no ec register access (ec_read fails)
+
+  //// state
+  double temp;
+  double rpm[2];
+  bool manual[2];
+  int pwm[2];
+  int max_speed;
+  unsigned long long last_ns;
+  unsigned long calls[SIM_METHOD_COUNT];
+  unsigned long reg_reads;
+} ec;
+
+// the model itself and the serialization of all AML calls
+static pthread_mutex_t ec_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t interp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void sim_ec_reset(void) {
+  pthread_mutex_lock(&ec_lock);
+  memset(&ec, 0, sizeof(ec));
+  ec.fans = 2;
+  ec.latency_us = 0;
+  ec.ambient = 25;
+  ec.load = 10;
+  ec.capacity = 60;
+  ec.k_passive = 0.15;
+  ec.k_fan = 0.12;
+  ec.fan_tau = 1.5;
+  ec.fan_scale[0] = ec.fan_scale[1] = 1.0;
+  ec.qfan = 128;
+  ec.temp = 45;
+  ec.max_speed = 255;
+  ec.last_ns = sim_ktime_ns();
+  pthread_mutex_unlock(&ec_lock);
+}
+
+void sim_ec_resume(void) {
+  pthread_mutex_lock(&ec_lock);
+  ec.manual[0] = ec.manual[1] = false;
+  ec.max_speed = 255;
+  pthread_mutex_unlock(&ec_lock);
+}
+
+static double fan_response(int fan, double pwm) {
+  int i;
+
+  if (pwm <= 0)
+    return 0;
+  for (i = 1; i < (int)ARRAY_SIZE(curve_pwm); i++)
+    if (pwm <= curve_pwm[i])
+      return ec.fan_scale[fan] *
+             (curve_rpm[i - 1] + (curve_rpm[i] - curve_rpm[i - 1]) *
+                                     (pwm - curve_pwm[i - 1]) /
+                                     (curve_pwm[i] - curve_pwm[i - 1]));
+  return ec.fan_scale[fan] * curve_rpm[ARRAY_SIZE(curve_rpm) - 1];
+}
+
+// the firmware's own controller
+static int auto_pwm(void) {
+  if (ec.temp < 40)
+    return 0;
+  return (int)fmin(60 + (ec.temp - 40) * 6, 255);
+}
+
+static int effective_pwm(int fan) {
+  int pwm = ec.manual[fan] ? ec.pwm[fan] : auto_pwm();
+  return pwm < ec.max_speed ? pwm : ec.max_speed;
+}
+
+// integrate the model up to now (caller holds ec_lock)
+static void advance(void) {
+  unsigned long long now = sim_ktime_ns();
+  double dt, step, cooling, target;
+  int fan;
+
+  dt = (now - ec.last_ns) / 1e9;
+  ec.last_ns = now;
+  while (dt > 0) {
+    step = dt > 0.01 ? 0.01 : dt;
+    dt -= step;
+    for (fan = 0; fan < ec.fans; fan++) {
+      target = fan_response(fan, effective_pwm(fan));
+      ec.rpm[fan] += (target - ec.rpm[fan]) * (1 - exp(-step / ec.fan_tau));
+    }
+    cooling = ec.k_passive + ec.k_fan * (ec.rpm[0] + ec.rpm[1]) / 1000;
+    ec.temp += (ec.load - cooling * (ec.temp - ec.ambient)) * step /
+               ec.capacity;
+  }
+}
+
+#define KEY(name, field)                  \
+  if (!strcmp(key, name)) {               \
+    if (set)                              \
+      field = *value;                     \
+    else                                  \
+      *value = field;                     \
+    return 0;                             \
+  }
+
+static int access_key(const char *key, double *value, bool set) {
+  double tmp;
+  int i;
+
+  KEY("fans", ec.fans);
+  KEY("latency_us", ec.latency_us);
+  KEY("ambient", ec.ambient);
+  KEY("load", ec.load);
+  KEY("capacity", ec.capacity);
+  KEY("k_passive", ec.k_passive);
+  KEY("k_fan", ec.k_fan);
+  KEY("fan_tau", ec.fan_tau);
+  KEY("fan1_scale", ec.fan_scale[0]);
+  KEY("fan2_scale", ec.fan_scale[1]);
+  KEY("qfan", ec.qfan);
+  KEY("tach_manual", ec.tach_manual);
+  KEY("temp", ec.temp);
+  KEY("rpm1", ec.rpm[0]);
+  KEY("rpm2", ec.rpm[1]);
+  KEY("pwm1", ec.pwm[0]);
+  KEY("pwm2", ec.pwm[1]);
+  KEY("manual1", ec.manual[0]);
+  KEY("manual2", ec.manual[1]);
+  KEY("max_speed", ec.max_speed);
+  KEY("disable_regs", ec.disabled_regs);
+  if (!strcmp(key, "reg_reads") && !set) {
+    *value = ec.reg_reads;
+    return 0;
+  }
+  for (i = 0; i < SIM_METHOD_COUNT; i++) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "disable_%s", method_names[i]);
+    KEY(name, ec.disabled[i]);
+    snprintf(name, sizeof(name), "calls_%s", method_names[i]);
+    if (!strcmp(key, name) && !set) {
+      *value = ec.calls[i];
+      return 0;
+    }
+  }
+  if (!strcmp(key, "calls") && !set) {
+    for (tmp = 0, i = 0; i < SIM_METHOD_COUNT; i++)
+      tmp += ec.calls[i];
+    *value = tmp;
+    return 0;
+  }
+  return -1;
+}
+
+int sim_ec_set(const char *key, double value) {
+  int ret;
+
+  pthread_mutex_lock(&ec_lock);
+  advance();
+  ret = access_key(key, &value, true);
+  pthread_mutex_unlock(&ec_lock);
+  return ret;
+}
+
+int sim_ec_get(const char *key, double *value) {
+  int ret;
+
+  pthread_mutex_lock(&ec_lock);
+  advance();
+  ret = access_key(key, value, false);
+  pthread_mutex_unlock(&ec_lock);
+  return ret;
+}
+
+void sim_ec_dump(void) {
+  int i;
+
+  pthread_mutex_lock(&ec_lock);
+  advance();
+  printf("ec: temp %.2f load %.1f ambient %.1f max_speed %d\n", ec.temp,
+         ec.load, ec.ambient, ec.max_speed);
+  for (i = 0; i < ec.fans; i++)
+    printf("ec: fan%d %s pwm %d rpm %.0f\n", i + 1,
+           ec.manual[i] ? "manual" : "auto", effective_pwm(i), ec.rpm[i]);
+  for (i = 0; i < SIM_METHOD_COUNT; i++)
+    printf("ec: %s calls %lu%s\n", method_names[i], ec.calls[i],
+           ec.disabled[i] ? " (disabled)" : "");
+  pthread_mutex_unlock(&ec_lock);
+}
+
+int sim_ec_lookup(const char *path) {
+  int i;
+
+  for (i = 0; i < SIM_METHOD_COUNT; i++)
+    if (!strcmp(path, method_paths[i]))
+      return ec.disabled[i] ? -1 : i;
+  return -1;
+}
+
+static void aml_delay(void) {
+  struct timespec ts;
+  double us = ec.latency_us;
+
+  if (us <= 0)
+    return;
+  ts.tv_sec = (time_t)(us / 1e6);
+  ts.tv_nsec = (long)((us - ts.tv_sec * 1e6) * 1000);
+  nanosleep(&ts, NULL);
+}
+
+int sim_ec_call(int method, int argc, const unsigned long long *args,
+                unsigned long long *value) {
+  int ret = 0, fan, i;
+
+  if (method < 0 || method >= SIM_METHOD_COUNT || ec.disabled[method])
+    return -1;
+
+  pthread_mutex_lock(&interp_lock);
+  aml_delay();
+  pthread_mutex_lock(&ec_lock);
+  advance();
+  ec.calls[method]++;
+  *value = 0;
+  switch (method) {
+    case SIM_SFNV:
+      if (argc != 2) {
+        ret = -1;
+        break;
+      }
+      if (args[0] == 0) {
+        for (i = 0; i < 2; i++)
+          ec.manual[i] = false;
+      } else if (args[0] <= (unsigned long long)ec.fans && args[1] <= 255) {
+        ec.manual[args[0] - 1] = true;
+        ec.pwm[args[0] - 1] = (int)args[1];
+      } else {
+        ret = -1;
+      }
+      break;
+    case SIM_TACH:
+      fan = argc == 1 ? (int)args[0] : -1;
+      if (fan < 0 || fan >= ec.fans)
+        *value = (unsigned long long)-1;
+      else if (ec.manual[fan] && !ec.tach_manual)
+        *value = 0;
+      else
+        *value = (unsigned long long)ec.rpm[fan];
+      break;
+    case SIM_TH1R:
+      *value = (unsigned long long)ec.temp;
+      break;
+    case SIM_ST98:
+      if (argc != 1 || args[0] > 255)
+        ret = -1;
+      else
+        ec.max_speed = (int)args[0];
+      break;
+    case SIM_QMOD:
+      if (argc != 1)
+        ret = -1;
+      else if (args[0] == 1)
+        ec.max_speed = (int)ec.qfan;
+      else if (args[0] == 2)
+        ec.max_speed = 255;
+      break;
+  }
+  pthread_mutex_unlock(&ec_lock);
+  pthread_mutex_unlock(&interp_lock);
+  return ret;
+}
+
+int sim_ec_read_reg(unsigned char addr, unsigned char *value) {
+  unsigned int raw;
+  int fan;
+
+  if (ec.disabled_regs)
+    return -1;
+  if (addr < 0x93 || addr > 0x96) {
+    *value = 0;
+    return 0;
+  }
+  fan = (addr - 0x93) / 2;
+  pthread_mutex_lock(&ec_lock);
+  advance();
+  ec.reg_reads++;
+  // tach period counts, see misc/calc_fan_relation.py
+  if (fan >= ec.fans || ec.rpm[fan] < 1)
+    raw = 0xffff;
+  else
+    raw = (unsigned int)(0x0041CDB4 / (ec.rpm[fan] * 2));
+  if (raw > 0xffff)
+    raw = 0xffff;
+  pthread_mutex_unlock(&ec_lock);
+  *value = (addr - 0x93) % 2 ? raw >> 8 : raw & 0xff;
+  return 0;
+}
+
+double sim_ec_fan_rpm(int fan, int pwm) {
+  double rpm;
+
+  pthread_mutex_lock(&ec_lock);
+  rpm = fan_response(fan, pwm < ec.max_speed ? pwm : ec.max_speed);
+  pthread_mutex_unlock(&ec_lock);
+  return rpm;
+}
+
+unsigned long sim_ec_calls(int method) { return ec.calls[method]; }
+
+const char *sim_ec_method_name(int method) { return method_names[method]; }
@@ -0,0 +1,51 @@
+/**
+ *  asus-fan userspace simulation - simulated embedded controller
+ *
+ *  A small thermal model (heat load, thermal mass, fan cooling) plus fans
+ *  with inertia, driven by the same AML methods the module uses (SFNV,
+ *  TACH, TH1R, ST98, QMOD). Every method call takes the configured AML
+ *  latency while holding a global 'interpreter' lock, like the real thing.
+ *
+**/
+#ifndef SIM_EC_H
+#define SIM_EC_H
+
+#include <stdbool.h>
+
+enum sim_ec_method {
+  SIM_SFNV,
+  SIM_TACH,
+  SIM_TH1R,
+  SIM_ST98,
+  SIM_QMOD,
+  SIM_METHOD_COUNT
+};
+
+// reset the model to its defaults (cool machine, both fans in auto-mode)
+void sim_ec_reset(void);
+
+// firmware defaults after a resume: fans in auto-mode, full max speed
+void sim_ec_resume(void);
+
+// set/get a model parameter or state by name (see sim_ec.c for the keys)
+int sim_ec_set(const char *key, double value);
+int sim_ec_get(const char *key, double *value);
+// print all parameters and the current state
+void sim_ec_dump(void);
+
+// acpi path -> method, -1 if unknown or disabled ('ec disable_XXXX 1')
+int sim_ec_lookup(const char *path);
+// evaluate 'method' with 'argc' integer arguments, 0 on success
+int sim_ec_call(int method, int argc, const unsigned long long *args,
+                unsigned long long *value);
+// read an ec register (0x93 - 0x96 hold the raw tach counts)
+int sim_ec_read_reg(unsigned char addr, unsigned char *value);
+
+// steady state speed of 'fan' at 'pwm' (under the current max speed)
+double sim_ec_fan_rpm(int fan, int pwm);
+
+// number of calls per method since the last reset
+unsigned long sim_ec_calls(int method);
+const char *sim_ec_method_name(int method);
+
+#endif
@@ -0,0 +1,2302 @@
+/**
+ *  asus-fan userspace simulation - kernel api shim implementation
+ *
+ *  - time: jiffies/ktime run at 'sim_time_scale' times real time and start
+ *    at INITIAL_JIFFIES like the kernel, to catch wrap-around bugs early
+ *  - workqueues: a timer thread dispatches due work items to threads of
+ *    their own, keeping the kernel's non-reentrancy, flush and cancel rules
+ *  - sysfs/debugfs: registered groups and files are kept in lists and are
+ *    accessed by name through sim.h
+ *  - acpi/dmi: forwarded to the simulated EC
+ *
+**/
+#include "include/sim_kernel.h"
+
+#include <ctype.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include "sim.h"
+#include "sim_ec.h"
+
+int sim_quiet;
+
+//////
+////// PRINTK / STRINGS
+//////
+
+int printk(const char *fmt, ...) {
+  va_list ap;
+  int ret;
+
+  if (sim_quiet)
+    return 0;
+  va_start(ap, fmt);
+  fputs("[kernel] ", stderr);
+  ret = vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+static int parse_ull(const char *s, unsigned int base, unsigned long long *res,
+                     bool allow_sign, bool *neg) {
+  char *end;
+
+  *neg = false;
+  if (*s == '+') {
+    s++;
+  } else if (*s == '-' && allow_sign) {
+    *neg = true;
+    s++;
+  }
+  if (!isxdigit((unsigned char)*s))
+    return -EINVAL;
+  errno = 0;
+  *res = strtoull(s, &end, base);
+  if (errno == ERANGE)
+    return -ERANGE;
+  if (end == s)
+    return -EINVAL;
+  // a single trailing newline is fine (echo)
+  if (*end == '\n')
+    end++;
+  if (*end)
+    return -EINVAL;
+  return 0;
+}
+
+int kstrtoul(const char *s, unsigned int base, unsigned long *res) {
+  unsigned long long v;
+  bool neg;
+  int err = parse_ull(s, base, &v, false, &neg);
+
+  if (err)
+    return err;
+  if (v > ULONG_MAX)
+    return -ERANGE;
+  *res = v;
+  return 0;
+}
+
+int kstrtouint(const char *s, unsigned int base, unsigned int *res) {
+  unsigned long long v;
+  bool neg;
+  int err = parse_ull(s, base, &v, false, &neg);
+
+  if (err)
+    return err;
+  if (v > UINT_MAX)
+    return -ERANGE;
+  *res = (unsigned int)v;
+  return 0;
+}
+
+int kstrtol(const char *s, unsigned int base, long *res) {
+  unsigned long long v;
+  bool neg;
+  int err = parse_ull(s, base, &v, true, &neg);
+
+  if (err)
+    return err;
+  if (v > (unsigned long long)LONG_MAX + neg)
+    return -ERANGE;
+  *res = neg ? -(long long)v : (long)v;
+  return 0;
+}
+
+int kstrtoint(const char *s, unsigned int base, int *res) {
+  unsigned long long v;
+  bool neg;
+  int err = parse_ull(s, base, &v, true, &neg);
+
+  if (err)
+    return err;
+  if (v > (unsigned long long)INT_MAX + neg)
+    return -ERANGE;
+  *res = neg ? -(long long)v : (int)v;
+  return 0;
+}
+
+int kstrtobool(const char *s, bool *res) {
+  if (!s)
+    return -EINVAL;
+  switch (s[0]) {
+    case 'y':
+    case 'Y':
+    case '1':
+      *res = true;
+      return 0;
+    case 'n':
+    case 'N':
+    case '0':
+      *res = false;
+      return 0;
+    case 'o':
+    case 'O':
+      if (s[1] == 'n' || s[1] == 'N') {
+        *res = true;
+        return 0;
+      }
+      if (s[1] == 'f' || s[1] == 'F') {
+        *res = false;
+        return 0;
+      }
+  }
+  return -EINVAL;
+}
+
+char *strim(char *s) {
+  size_t len;
+  char *end;
+
+  while (isspace((unsigned char)*s))
+    s++;
+  len = strlen(s);
+  if (!len)
+    return s;
+  end = s + len - 1;
+  while (end >= s && isspace((unsigned char)*end))
+    *end-- = '\0';
+  return s;
+}
+
+bool sysfs_streq(const char *s1, const char *s2) {
+  while (*s1 && *s1 == *s2) {
+    s1++;
+    s2++;
+  }
+  if (*s1 == *s2)
+    return true;
+  if (!*s1 && *s2 == '\n' && !s2[1])
+    return true;
+  if (*s1 == '\n' && !s1[1] && !*s2)
+    return true;
+  return false;
+}
+
+int sysfs_emit(char *buf, const char *fmt, ...) {
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(buf, 4096, fmt, ap);
+  va_end(ap);
+  return len;
+}
+
+ssize_t memory_read_from_buffer(void *to, size_t count, loff_t *ppos,
+                                const void *from, size_t available) {
+  loff_t pos = *ppos;
+
+  if (pos < 0)
+    return -EINVAL;
+  if ((size_t)pos >= available)
+    return 0;
+  if (count > available - pos)
+    count = available - pos;
+  memcpy(to, (const char *)from + pos, count);
+  *ppos = pos + count;
+  return count;
+}
+
+ssize_t simple_read_from_buffer(void __user *to, size_t count, loff_t *ppos,
+                                const void *from, size_t available) {
+  return memory_read_from_buffer(to, count, ppos, from, available);
+}
+
+ssize_t simple_write_to_buffer(void *to, size_t available, loff_t *ppos,
+                               const void __user *from, size_t count) {
+  loff_t pos = *ppos;
+
+  if (pos < 0)
+    return -EINVAL;
+  if ((size_t)pos >= available || !count)
+    return 0;
+  if (count > available - pos)
+    count = available - pos;
+  memcpy((char *)to + pos, from, count);
+  *ppos = pos + count;
+  return count;
+}
+
+//////
+////// TIME
+//////
+
+#define INITIAL_JIFFIES ((unsigned long)(unsigned int)(-300 * HZ))
+
+double sim_time_scale = 1.0;
+static pthread_mutex_t time_lock = PTHREAD_MUTEX_INITIALIZER;
+static u64 time_base_real, time_base_virt;
+
+static u64 real_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+u64 sim_ktime_ns(void) {
+  u64 now = real_ns(), virt;
+
+  pthread_mutex_lock(&time_lock);
+  if (!time_base_real)
+    time_base_real = now;
+  virt = time_base_virt + (u64)((now - time_base_real) * sim_time_scale);
+  pthread_mutex_unlock(&time_lock);
+  return virt;
+}
+
+// change the scale without letting the simulated time jump
+void sim_set_time_scale(double scale) {
+  u64 virt = sim_ktime_ns();
+
+  pthread_mutex_lock(&time_lock);
+  time_base_real = real_ns();
+  time_base_virt = virt;
+  sim_time_scale = scale;
+  pthread_mutex_unlock(&time_lock);
+}
+
+unsigned long sim_jiffies(void) {
+  return INITIAL_JIFFIES + sim_ktime_ns() / NSEC_PER_MSEC;
+}
+
+static void sleep_virtual_ns(u64 ns) {
+  struct timespec ts;
+  u64 real = (u64)(ns / sim_time_scale);
+
+  ts.tv_sec = real / NSEC_PER_SEC;
+  ts.tv_nsec = real % NSEC_PER_SEC;
+  nanosleep(&ts, NULL);
+}
+
+void msleep(unsigned int ms) { sleep_virtual_ns((u64)ms * NSEC_PER_MSEC); }
+
+void usleep_range(unsigned long min, unsigned long max) {
+  sleep_virtual_ns((u64)min * NSEC_PER_USEC);
+}
+
+//////
+////// WORKQUEUE
+//////
+
+struct workqueue_struct {
+  char name[32];
+  int max_active;
+  int active;
+};
+
+static struct workqueue_struct system_wq_s = {"events", 256, 0};
+struct workqueue_struct *system_wq = &system_wq_s;
+
+static pthread_mutex_t wq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wq_cond = PTHREAD_COND_INITIALIZER;
+// pending (queued, not yet started) work items
+static struct work_struct *wq_pending;
+// running work items, on any queue
+static int wq_running;
+static pthread_t wq_timer;
+static bool wq_timer_started;
+
+pthread_rwlock_t sim_rcu_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void *wq_run(void *arg) {
+  struct work_struct *work = arg;
+
+  work->func(work);
+
+  pthread_mutex_lock(&wq_lock);
+  work->running = false;
+  work->done_seq = work->started_seq;
+  work->wq->active--;
+  wq_running--;
+  pthread_cond_broadcast(&wq_cond);
+  pthread_mutex_unlock(&wq_lock);
+  return NULL;
+}
+
+static void wq_unlink(struct work_struct *work) {
+  struct work_struct **p;
+
+  for (p = &wq_pending; *p; p = &(*p)->next) {
+    if (*p == work) {
+      *p = work->next;
+      break;
+    }
+  }
+  work->next = NULL;
+  work->pending = false;
+}
+
+// dispatches due work items, sleeps until the next one is due
+static void *wq_timer_fn(void *arg) {
+  struct work_struct *work, *next;
+  unsigned long now, earliest;
+  bool have_earliest;
+  pthread_attr_t attr;
+  pthread_t thread;
+  struct timespec ts;
+  u64 real;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  pthread_mutex_lock(&wq_lock);
+  for (;;) {
+    now = sim_jiffies();
+    have_earliest = false;
+    earliest = 0;
+    for (work = wq_pending; work; work = next) {
+      next = work->next;
+      if (time_after(work->due, now)) {
+        if (!have_earliest || time_before(work->due, earliest))
+          earliest = work->due;
+        have_earliest = true;
+        continue;
+      }
+      // non-reentrant and bounded by the queue's max_active
+      if (work->running || work->wq->active >= work->wq->max_active)
+        continue;
+      wq_unlink(work);
+      work->running = true;
+      work->started_seq = work->queued_seq;
+      work->wq->active++;
+      wq_running++;
+      pthread_create(&thread, &attr, wq_run, work);
+    }
+
+    if (have_earliest) {
+      real = (u64)((earliest - now) * NSEC_PER_MSEC / sim_time_scale);
+      clock_gettime(CLOCK_REALTIME, &ts);
+      real += ts.tv_nsec;
+      ts.tv_sec += real / NSEC_PER_SEC;
+      ts.tv_nsec = real % NSEC_PER_SEC;
+      pthread_cond_timedwait(&wq_cond, &wq_lock, &ts);
+    } else {
+      pthread_cond_wait(&wq_cond, &wq_lock);
+    }
+  }
+  return arg;
+}
+
+static bool wq_enqueue_locked(struct workqueue_struct *wq,
+                              struct work_struct *work, unsigned long delay) {
+  if (work->canceling || work->pending)
+    return false;
+  if (!wq_timer_started) {
+    pthread_create(&wq_timer, NULL, wq_timer_fn, NULL);
+    wq_timer_started = true;
+  }
+  work->wq = wq;
+  work->due = sim_jiffies() + delay;
+  work->pending = true;
+  work->queued_seq++;
+  work->next = wq_pending;
+  wq_pending = work;
+  pthread_cond_broadcast(&wq_cond);
+  return true;
+}
+
+struct workqueue_struct *alloc_workqueue(const char *fmt, unsigned int flags,
+                                         int max_active, ...) {
+  struct workqueue_struct *wq = calloc(1, sizeof(*wq));
+
+  snprintf(wq->name, sizeof(wq->name), "%s", fmt);
+  wq->max_active = max_active > 0 ? max_active : 256;
+  return wq;
+}
+
+void flush_workqueue(struct workqueue_struct *wq) {
+  struct work_struct *work;
+  bool busy;
+
+  pthread_mutex_lock(&wq_lock);
+  do {
+    busy = wq->active > 0;
+    for (work = wq_pending; work && !busy; work = work->next)
+      if (work->wq == wq && !time_after(work->due, sim_jiffies()))
+        busy = true;
+    if (busy)
+      pthread_cond_wait(&wq_cond, &wq_lock);
+  } while (busy);
+  pthread_mutex_unlock(&wq_lock);
+}
+
+void destroy_workqueue(struct workqueue_struct *wq) {
+  flush_workqueue(wq);
+  free(wq);
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work) {
+  bool ret;
+
+  pthread_mutex_lock(&wq_lock);
+  ret = wq_enqueue_locked(wq, work, 0);
+  pthread_mutex_unlock(&wq_lock);
+  return ret;
+}
+
+bool queue_delayed_work(struct workqueue_struct *wq, struct delayed_work *dw,
+                        unsigned long delay) {
+  bool ret;
+
+  pthread_mutex_lock(&wq_lock);
+  ret = wq_enqueue_locked(wq, &dw->work, delay);
+  pthread_mutex_unlock(&wq_lock);
+  return ret;
+}
+
+bool mod_delayed_work(struct workqueue_struct *wq, struct delayed_work *dw,
+                      unsigned long delay) {
+  bool ret;
+
+  pthread_mutex_lock(&wq_lock);
+  ret = dw->work.pending;
+  if (ret) {
+    dw->work.due = sim_jiffies() + delay;
+    pthread_cond_broadcast(&wq_cond);
+  } else {
+    wq_enqueue_locked(wq, &dw->work, delay);
+  }
+  pthread_mutex_unlock(&wq_lock);
+  return ret;
+}
+
+bool flush_work(struct work_struct *work) {
+  unsigned long target;
+
+  pthread_mutex_lock(&wq_lock);
+  if (work->pending) {
+    target = work->queued_seq;
+    work->due = sim_jiffies();
+    pthread_cond_broadcast(&wq_cond);
+  } else if (work->running) {
+    target = work->started_seq;
+  } else {
+    pthread_mutex_unlock(&wq_lock);
+    return false;
+  }
+  while ((long)(work->done_seq - target) < 0)
+    pthread_cond_wait(&wq_cond, &wq_lock);
+  pthread_mutex_unlock(&wq_lock);
+  return true;
+}
+
+bool flush_delayed_work(struct delayed_work *dw) {
+  return flush_work(&dw->work);
+}
+
+bool cancel_work_sync(struct work_struct *work) {
+  bool ret;
+
+  pthread_mutex_lock(&wq_lock);
+  ret = work->pending;
+  if (ret)
+    wq_unlink(work);
+  // a running instance must not re-queue itself meanwhile
+  work->canceling = true;
+  while (work->running)
+    pthread_cond_wait(&wq_cond, &wq_lock);
+  work->canceling = false;
+  pthread_mutex_unlock(&wq_lock);
+  return ret;
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dw) {
+  return cancel_work_sync(&dw->work);
+}
+
+bool cancel_delayed_work(struct delayed_work *dw) {
+  bool ret;
+
+  pthread_mutex_lock(&wq_lock);
+  ret = dw->work.pending;
+  if (ret)
+    wq_unlink(&dw->work);
+  pthread_mutex_unlock(&wq_lock);
+  return ret;
+}
+
+void sim_wq_idle(void) {
+  struct work_struct *work;
+  struct timespec ts;
+  bool busy;
+
+  pthread_mutex_lock(&wq_lock);
+  do {
+    busy = wq_running > 0;
+    for (work = wq_pending; work && !busy; work = work->next)
+      if (!time_after(work->due, sim_jiffies()))
+        busy = true;
+    if (busy) {
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += 10 * NSEC_PER_MSEC;
+      if (ts.tv_nsec >= NSEC_PER_SEC) {
+        ts.tv_sec++;
+        ts.tv_nsec -= NSEC_PER_SEC;
+      }
+      pthread_cond_timedwait(&wq_cond, &wq_lock, &ts);
+    }
+  } while (busy);
+  pthread_mutex_unlock(&wq_lock);
+}
+
+//////
+////// SYSFS / HWMON / PLATFORM
+//////
+
+struct sim_group {
+  struct kobject *kobj;
+  struct device *dev;
+  const struct attribute_group *grp;
+  struct sim_group *next;
+};
+
+static struct sim_group *groups;
+static pthread_rwlock_t groups_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void group_add(struct kobject *kobj, struct device *dev,
+                      const struct attribute_group *grp) {
+  struct sim_group *g = calloc(1, sizeof(*g));
+
+  g->kobj = kobj;
+  g->dev = dev;
+  g->grp = grp;
+  pthread_rwlock_wrlock(&groups_lock);
+  g->next = groups;
+  groups = g;
+  pthread_rwlock_unlock(&groups_lock);
+}
+
+static void group_remove(struct kobject *kobj,
+                         const struct attribute_group *grp) {
+  struct sim_group **p, *g;
+
+  pthread_rwlock_wrlock(&groups_lock);
+  for (p = &groups; (g = *p);) {
+    if (g->kobj == kobj && (!grp || g->grp == grp)) {
+      *p = g->next;
+      free(g);
+    } else {
+      p = &g->next;
+    }
+  }
+  pthread_rwlock_unlock(&groups_lock);
+}
+
+int sysfs_create_group(struct kobject *kobj,
+                       const struct attribute_group *grp) {
+  group_add(kobj, kobj_to_dev(kobj), grp);
+  return 0;
+}
+
+void sysfs_remove_group(struct kobject *kobj,
+                        const struct attribute_group *grp) {
+  group_remove(kobj, grp);
+}
+
+// sysfs_notify() counters per attribute name
+static struct {
+  char name[64];
+  unsigned long count;
+} notified[64];
+static pthread_mutex_t notified_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void sysfs_notify(struct kobject *kobj, const char *dir, const char *attr) {
+  int i;
+
+  pthread_mutex_lock(&notified_lock);
+  for (i = 0; i < (int)ARRAY_SIZE(notified); i++) {
+    if (!notified[i].name[0])
+      snprintf(notified[i].name, sizeof(notified[i].name), "%s", attr);
+    if (!strcmp(notified[i].name, attr)) {
+      notified[i].count++;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&notified_lock);
+}
+
+// tracepoint hits per event name
+static struct {
+  char name[64];
+  unsigned long count;
+} traced[16];
+
+void sim_trace(const char *event) {
+  int i;
+
+  pthread_mutex_lock(&notified_lock);
+  for (i = 0; i < (int)ARRAY_SIZE(traced); i++) {
+    if (!traced[i].name[0])
+      snprintf(traced[i].name, sizeof(traced[i].name), "%s", event);
+    if (!strcmp(traced[i].name, event)) {
+      traced[i].count++;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&notified_lock);
+}
+
+unsigned long sim_traced(const char *event) {
+  unsigned long count = 0;
+  int i;
+
+  pthread_mutex_lock(&notified_lock);
+  for (i = 0; i < (int)ARRAY_SIZE(traced); i++)
+    if (!strcmp(traced[i].name, event))
+      count = traced[i].count;
+  pthread_mutex_unlock(&notified_lock);
+  return count;
+}
+
+unsigned long sim_attr_notified(const char *name) {
+  unsigned long count = 0;
+  int i;
+
+  pthread_mutex_lock(&notified_lock);
+  for (i = 0; i < (int)ARRAY_SIZE(notified); i++)
+    if (!strcmp(notified[i].name, name))
+      count = notified[i].count;
+  pthread_mutex_unlock(&notified_lock);
+  return count;
+}
+
+// find a visible attribute by name (caller holds groups_lock)
+static struct attribute *attr_find(const char *name, struct sim_group **found,
+                                   umode_t *mode) {
+  struct sim_group *g;
+  struct attribute **a;
+  int i;
+
+  for (g = groups; g; g = g->next) {
+    if (!g->grp->attrs)
+      continue;
+    for (i = 0, a = g->grp->attrs; *a; a++, i++) {
+      if (strcmp((*a)->name, name))
+        continue;
+      *mode = g->grp->is_visible ? g->grp->is_visible(g->kobj, *a, i)
+                                 : (*a)->mode;
+      if (!*mode)
+        continue;
+      *found = g;
+      return *a;
+    }
+  }
+  return NULL;
+}
+
+static struct bin_attribute *bin_attr_find(const char *name,
+                                           struct sim_group **found,
+                                           umode_t *mode) {
+  struct bin_attribute **a;
+  struct sim_group *g;
+  int i;
+
+  for (g = groups; g; g = g->next) {
+    if (!g->grp->bin_attrs)
+      continue;
+    for (i = 0, a = g->grp->bin_attrs; *a; a++, i++) {
+      if (strcmp((*a)->attr.name, name))
+        continue;
+      *mode = g->grp->is_bin_visible ? g->grp->is_bin_visible(g->kobj, *a, i)
+                                     : (*a)->attr.mode;
+      if (!*mode)
+        continue;
+      *found = g;
+      return *a;
+    }
+  }
+  return NULL;
+}
+
+ssize_t sim_attr_read(const char *name, char *buf, size_t size) {
+  struct device_attribute *dattr;
+  struct attribute *attr;
+  struct sim_group *g;
+  char page[4096];
+  umode_t mode;
+  ssize_t ret;
+
+  pthread_rwlock_rdlock(&groups_lock);
+  attr = attr_find(name, &g, &mode);
+  if (!attr) {
+    pthread_rwlock_unlock(&groups_lock);
+    return -ENOENT;
+  }
+  dattr = container_of(attr, struct device_attribute, attr);
+  if (!(mode & S_IRUGO) || !dattr->show) {
+    pthread_rwlock_unlock(&groups_lock);
+    return -EACCES;
+  }
+  ret = dattr->show(g->dev, dattr, page);
+  pthread_rwlock_unlock(&groups_lock);
+  if (ret < 0)
+    return ret;
+  if ((size_t)ret >= size)
+    ret = size - 1;
+  memcpy(buf, page, ret);
+  buf[ret] = '\0';
+  return ret;
+}
+
+ssize_t sim_attr_write(const char *name, const char *value) {
+  struct device_attribute *dattr;
+  struct attribute *attr;
+  struct sim_group *g;
+  char page[4096];
+  umode_t mode;
+  ssize_t ret;
+
+  // like 'echo value > attr'
+  snprintf(page, sizeof(page), "%s\n", value);
+  pthread_rwlock_rdlock(&groups_lock);
+  attr = attr_find(name, &g, &mode);
+  if (!attr) {
+    pthread_rwlock_unlock(&groups_lock);
+    return -ENOENT;
+  }
+  dattr = container_of(attr, struct device_attribute, attr);
+  if (!(mode & S_IWUGO) || !dattr->store) {
+    pthread_rwlock_unlock(&groups_lock);
+    return -EACCES;
+  }
+  ret = dattr->store(g->dev, dattr, page, strlen(page));
+  pthread_rwlock_unlock(&groups_lock);
+  return ret < 0 ? ret : 0;
+}
+
+ssize_t sim_bin_read(const char *name, void *buf, size_t size) {
+  struct bin_attribute *attr;
+  struct sim_group *g;
+  umode_t mode;
+  ssize_t ret;
+
+  pthread_rwlock_rdlock(&groups_lock);
+  attr = bin_attr_find(name, &g, &mode);
+  if (!attr || !attr->read) {
+    pthread_rwlock_unlock(&groups_lock);
+    return attr ? -EACCES : -ENOENT;
+  }
+  ret = attr->read(NULL, g->kobj, attr, buf, 0, size);
+  pthread_rwlock_unlock(&groups_lock);
+  return ret;
+}
+
+ssize_t sim_bin_write(const char *name, const void *buf, size_t size) {
+  struct bin_attribute *attr;
+  struct sim_group *g;
+  char page[4096];
+  umode_t mode;
+  ssize_t ret;
+
+  if (size > sizeof(page))
+    return -EFBIG;
+  memcpy(page, buf, size);
+  pthread_rwlock_rdlock(&groups_lock);
+  attr = bin_attr_find(name, &g, &mode);
+  if (!attr || !attr->write) {
+    pthread_rwlock_unlock(&groups_lock);
+    return attr ? -EACCES : -ENOENT;
+  }
+  ret = attr->write(NULL, g->kobj, attr, page, 0, size);
+  pthread_rwlock_unlock(&groups_lock);
+  return ret;
+}
+
+void sim_attr_list(void) {
+  struct bin_attribute **b;
+  struct attribute **a;
+  struct sim_group *g;
+  umode_t mode;
+  int i;
+
+  pthread_rwlock_rdlock(&groups_lock);
+  for (g = groups; g; g = g->next) {
+    for (i = 0, a = g->grp->attrs; a && *a; a++, i++) {
+      mode = g->grp->is_visible ? g->grp->is_visible(g->kobj, *a, i)
+                                : (*a)->mode;
+      if (mode)
+        printf("%s/%s %o\n", g->kobj->name, (*a)->name, mode);
+    }
+    for (i = 0, b = g->grp->bin_attrs; b && *b; b++, i++) {
+      mode = g->grp->is_bin_visible ? g->grp->is_bin_visible(g->kobj, *b, i)
+                                    : (*b)->attr.mode;
+      if (mode)
+        printf("%s/%s %o (binary)\n", g->kobj->name, (*b)->attr.name, mode);
+    }
+  }
+  pthread_rwlock_unlock(&groups_lock);
+}
+
+// attribute names of the hwmon core, indexed by type and attribute
+static const char *const hwmon_chip_names[] = {
+    [hwmon_chip_update_interval] = "update_interval",
+    [hwmon_chip_alarms] = "alarms",
+};
+static const char *const hwmon_temp_names[] = {
+    [hwmon_temp_enable] = "temp%d_enable",
+    [hwmon_temp_input] = "temp%d_input",
+    [hwmon_temp_type] = "temp%d_type",
+    [hwmon_temp_lcrit] = "temp%d_lcrit",
+    [hwmon_temp_lcrit_hyst] = "temp%d_lcrit_hyst",
+    [hwmon_temp_min] = "temp%d_min",
+    [hwmon_temp_min_hyst] = "temp%d_min_hyst",
+    [hwmon_temp_max] = "temp%d_max",
+    [hwmon_temp_max_hyst] = "temp%d_max_hyst",
+    [hwmon_temp_crit] = "temp%d_crit",
+    [hwmon_temp_crit_hyst] = "temp%d_crit_hyst",
+    [hwmon_temp_emergency] = "temp%d_emergency",
+    [hwmon_temp_emergency_hyst] = "temp%d_emergency_hyst",
+    [hwmon_temp_alarm] = "temp%d_alarm",
+    [hwmon_temp_lcrit_alarm] = "temp%d_lcrit_alarm",
+    [hwmon_temp_min_alarm] = "temp%d_min_alarm",
+    [hwmon_temp_max_alarm] = "temp%d_max_alarm",
+    [hwmon_temp_crit_alarm] = "temp%d_crit_alarm",
+    [hwmon_temp_emergency_alarm] = "temp%d_emergency_alarm",
+    [hwmon_temp_fault] = "temp%d_fault",
+    [hwmon_temp_offset] = "temp%d_offset",
+    [hwmon_temp_label] = "temp%d_label",
+    [hwmon_temp_lowest] = "temp%d_lowest",
+    [hwmon_temp_highest] = "temp%d_highest",
+    [hwmon_temp_reset_history] = "temp%d_reset_history",
+    [hwmon_temp_rated_min] = "temp%d_rated_min",
+    [hwmon_temp_rated_max] = "temp%d_rated_max",
+    [hwmon_temp_beep] = "temp%d_beep",
+};
+static const char *const hwmon_fan_names[] = {
+    [hwmon_fan_enable] = "fan%d_enable",
+    [hwmon_fan_input] = "fan%d_input",
+    [hwmon_fan_label] = "fan%d_label",
+    [hwmon_fan_min] = "fan%d_min",
+    [hwmon_fan_max] = "fan%d_max",
+    [hwmon_fan_div] = "fan%d_div",
+    [hwmon_fan_pulses] = "fan%d_pulses",
+    [hwmon_fan_target] = "fan%d_target",
+    [hwmon_fan_alarm] = "fan%d_alarm",
+    [hwmon_fan_min_alarm] = "fan%d_min_alarm",
+    [hwmon_fan_max_alarm] = "fan%d_max_alarm",
+    [hwmon_fan_fault] = "fan%d_fault",
+    [hwmon_fan_beep] = "fan%d_beep",
+};
+static const char *const hwmon_pwm_names[] = {
+    [hwmon_pwm_input] = "pwm%d",
+    [hwmon_pwm_enable] = "pwm%d_enable",
+    [hwmon_pwm_mode] = "pwm%d_mode",
+    [hwmon_pwm_freq] = "pwm%d_freq",
+    [hwmon_pwm_auto_channels_temp] = "pwm%d_auto_channels_temp",
+};
+
+static const char *hwmon_attr_template(enum hwmon_sensor_types type,
+                                       u32 attr) {
+#define NAME(names) (attr < ARRAY_SIZE(names) ? names[attr] : NULL)
+  switch (type) {
+    case hwmon_chip:
+      return NAME(hwmon_chip_names);
+    case hwmon_temp:
+      return NAME(hwmon_temp_names);
+    case hwmon_fan:
+      return NAME(hwmon_fan_names);
+    case hwmon_pwm:
+      return NAME(hwmon_pwm_names);
+    default:
+      return NULL;
+  }
+#undef NAME
+}
+
+static bool hwmon_is_string(enum hwmon_sensor_types type, u32 attr) {
+  return (type == hwmon_temp && attr == hwmon_temp_label) ||
+         (type == hwmon_fan && attr == hwmon_fan_label);
+}
+
+// one attribute generated from the chip info, like the hwmon core does
+struct sim_hwmon_attr {
+  struct device_attribute dev_attr;
+  const struct hwmon_ops *ops;
+  enum hwmon_sensor_types type;
+  u32 attr;
+  int channel;
+  char name[48];
+};
+
+struct sim_hwmon {
+  struct device dev;
+  struct attribute_group grp;
+  struct attribute **attrs;
+  struct sim_hwmon_attr *hattrs;
+};
+
+static ssize_t hwmon_attr_show(struct device *dev,
+                               struct device_attribute *da, char *buf) {
+  struct sim_hwmon_attr *ha = container_of(da, struct sim_hwmon_attr, dev_attr);
+  const char *str;
+  long val;
+  int ret;
+
+  if (hwmon_is_string(ha->type, ha->attr)) {
+    ret = ha->ops->read_string(dev, ha->type, ha->attr, ha->channel, &str);
+    return ret < 0 ? ret : sprintf(buf, "%s\n", str);
+  }
+  ret = ha->ops->read(dev, ha->type, ha->attr, ha->channel, &val);
+  return ret < 0 ? ret : sprintf(buf, "%ld\n", val);
+}
+
+static ssize_t hwmon_attr_store(struct device *dev,
+                                struct device_attribute *da, const char *buf,
+                                size_t count) {
+  struct sim_hwmon_attr *ha = container_of(da, struct sim_hwmon_attr, dev_attr);
+  long val = 0;
+  int ret;
+
+  ret = kstrtol(buf, 10, &val);
+  if (ret < 0)
+    return ret;
+  ret = ha->ops->write(dev, ha->type, ha->attr, ha->channel, val);
+  return ret < 0 ? ret : (ssize_t)count;
+}
+
+static struct sim_hwmon *hwmon_alloc(struct device *parent, void *drvdata) {
+  struct sim_hwmon *hw = calloc(1, sizeof(*hw));
+
+  hw->dev.kobj.name = "hwmon0";
+  hw->dev.parent = parent;
+  hw->dev.driver_data = drvdata;
+  return hw;
+}
+
+struct device *hwmon_device_register_with_groups(
+    struct device *parent, const char *name, void *drvdata,
+    const struct attribute_group **grps) {
+  struct sim_hwmon *hw = hwmon_alloc(parent, drvdata);
+
+  hw->dev.groups = grps;
+  for (; grps && *grps; grps++)
+    group_add(&hw->dev.kobj, &hw->dev, *grps);
+  return &hw->dev;
+}
+
+struct device *hwmon_device_register_with_info(
+    struct device *parent, const char *name, void *drvdata,
+    const struct hwmon_chip_info *chip,
+    const struct attribute_group **extra_groups) {
+  const struct hwmon_channel_info *const *info;
+  struct sim_hwmon *hw;
+  struct sim_hwmon_attr *ha;
+  const char *template;
+  int n = 0, ch;
+  umode_t mode;
+  u32 bits, a;
+
+  if (!chip || !chip->ops || !chip->ops->is_visible || !chip->info)
+    return ERR_PTR(-EINVAL);
+  for (info = chip->info; *info; info++)
+    for (ch = 0; (*info)->config[ch]; ch++)
+      n += __builtin_popcount((*info)->config[ch]);
+
+  hw = hwmon_alloc(parent, drvdata);
+  hw->attrs = calloc(n + 1, sizeof(*hw->attrs));
+  hw->hattrs = calloc(n, sizeof(*hw->hattrs));
+  n = 0;
+  for (info = chip->info; *info; info++) {
+    for (ch = 0; (bits = (*info)->config[ch]); ch++) {
+      for (a = 0; a < 32; a++) {
+        if (!(bits & BIT(a)))
+          continue;
+        template = hwmon_attr_template((*info)->type, a);
+        mode = chip->ops->is_visible(drvdata, (*info)->type, a, ch);
+        if (!template || !mode)
+          continue;
+        // labels are read-only, everything else as the driver says
+        if (hwmon_is_string((*info)->type, a)) {
+          if (!chip->ops->read_string)
+            continue;
+          mode = 0444;
+        }
+        ha = &hw->hattrs[n];
+        snprintf(ha->name, sizeof(ha->name), template,
+                 ch + ((*info)->type != hwmon_in));
+        ha->ops = chip->ops;
+        ha->type = (*info)->type;
+        ha->attr = a;
+        ha->channel = ch;
+        ha->dev_attr.attr.name = ha->name;
+        ha->dev_attr.attr.mode = mode;
+        ha->dev_attr.show = (mode & 0444) ? hwmon_attr_show : NULL;
+        ha->dev_attr.store =
+            (mode & 0222) && chip->ops->write ? hwmon_attr_store : NULL;
+        hw->attrs[n++] = &ha->dev_attr.attr;
+      }
+    }
+  }
+  hw->grp.attrs = hw->attrs;
+  group_add(&hw->dev.kobj, &hw->dev, &hw->grp);
+  hw->dev.groups = extra_groups;
+  for (; extra_groups && *extra_groups; extra_groups++)
+    group_add(&hw->dev.kobj, &hw->dev, *extra_groups);
+  return &hw->dev;
+}
+
+// like the hwmon core: sysfs_notify() the attribute of that channel
+int hwmon_notify_event(struct device *dev, enum hwmon_sensor_types type,
+                       u32 attr, int channel) {
+  const char *template = hwmon_attr_template(type, attr);
+  char name[48];
+
+  if (!template)
+    return -EINVAL;
+  snprintf(name, sizeof(name), template, channel + (type != hwmon_in));
+  sysfs_notify(&dev->kobj, NULL, name);
+  return 0;
+}
+
+void hwmon_device_unregister(struct device *dev) {
+  struct sim_hwmon *hw;
+
+  if (IS_ERR_OR_NULL(dev))
+    return;
+  hw = container_of(dev, struct sim_hwmon, dev);
+  group_remove(&dev->kobj, NULL);
+  free(hw->attrs);
+  free(hw->hattrs);
+  free(hw);
+}
+
+// one driver and one device at most, bound as soon as both exist
+static struct platform_driver *platform_driver;
+static struct platform_device *platform_device;
+
+// asynchronous probes still running
+static pthread_mutex_t probe_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probe_cond = PTHREAD_COND_INITIALIZER;
+static int probes_running;
+
+static void platform_probe(struct platform_device *pdev) {
+  int err;
+
+  pdev->dev.driver = &platform_driver->driver;
+  err = platform_driver->probe(pdev);
+  if (err)
+    printk(KERN_INFO "%s: probe failed with error %d\n", pdev->name, err);
+  pdev->bound = !err;
+}
+
+static void *platform_probe_thread(void *arg) {
+  platform_probe(arg);
+  pthread_mutex_lock(&probe_lock);
+  probes_running--;
+  pthread_cond_broadcast(&probe_cond);
+  pthread_mutex_unlock(&probe_lock);
+  return NULL;
+}
+
+void sim_probe_settle(void) {
+  pthread_mutex_lock(&probe_lock);
+  while (probes_running)
+    pthread_cond_wait(&probe_cond, &probe_lock);
+  pthread_mutex_unlock(&probe_lock);
+}
+
+static void platform_bind(void) {
+  pthread_t tid;
+
+  if (!platform_driver || !platform_device ||
+      strcmp(platform_driver->driver.name, platform_device->name))
+    return;
+  if (platform_driver->driver.probe_type != PROBE_PREFER_ASYNCHRONOUS) {
+    platform_probe(platform_device);
+    return;
+  }
+  pthread_mutex_lock(&probe_lock);
+  probes_running++;
+  pthread_mutex_unlock(&probe_lock);
+  pthread_create(&tid, NULL, platform_probe_thread, platform_device);
+  pthread_detach(tid);
+}
+
+int platform_driver_register(struct platform_driver *drv) {
+  platform_driver = drv;
+  platform_bind();
+  return 0;
+}
+
+struct platform_device *platform_device_register_simple(
+    const char *name, int id, const struct resource *res, unsigned int num) {
+  struct platform_device *pdev = calloc(1, sizeof(*pdev));
+
+  pdev->name = name;
+  pdev->id = id;
+  pdev->dev.kobj.name = name;
+  platform_device = pdev;
+  platform_bind();
+  return pdev;
+}
+
+struct platform_device *platform_create_bundle(
+    struct platform_driver *driver, int (*probe)(struct platform_device *),
+    struct resource *res, unsigned int n_res, const void *data, size_t size) {
+  struct platform_device *pdev;
+
+  driver->probe = probe;
+  driver->driver.probe_type = PROBE_FORCE_SYNCHRONOUS;
+  platform_driver_register(driver);
+  pdev = platform_device_register_simple(driver->driver.name, -1, res, n_res);
+  if (!pdev->bound) {
+    platform_device = NULL;
+    platform_driver = NULL;
+    free(pdev);
+    return ERR_PTR(-ENODEV);
+  }
+  return pdev;
+}
+
+void platform_device_unregister(struct platform_device *pdev) {
+  if (IS_ERR_OR_NULL(pdev))
+    return;
+  // like the driver core, wait for a probe still in flight
+  sim_probe_settle();
+  if (pdev->bound && platform_driver && platform_driver->remove)
+    platform_driver->remove(pdev);
+  group_remove(&pdev->dev.kobj, NULL);
+  if (platform_device == pdev)
+    platform_device = NULL;
+  free(pdev);
+}
+
+int sim_pm_suspend(void) {
+  const struct dev_pm_ops *pm;
+
+  sim_probe_settle();
+  if (!platform_device || !platform_device->bound)
+    return -ENODEV;
+  pm = platform_driver->driver.pm;
+  return pm && pm->suspend ? pm->suspend(&platform_device->dev) : 0;
+}
+
+int sim_pm_resume(void) {
+  const struct dev_pm_ops *pm;
+
+  if (!platform_device || !platform_device->bound)
+    return -ENODEV;
+  // the firmware forgot everything the module told it
+  sim_ec_resume();
+  pm = platform_driver->driver.pm;
+  return pm && pm->resume ? pm->resume(&platform_device->dev) : 0;
+}
+
+void platform_driver_unregister(struct platform_driver *drv) {
+  sim_probe_settle();
+  if (platform_driver == drv)
+    platform_driver = NULL;
+}
+
+//////
+////// SEQ_FILE / DEBUGFS
+//////
+
+int seq_printf(struct seq_file *m, const char *fmt, ...) {
+  va_list ap;
+  int len;
+
+  if (m->count >= m->size)
+    return -1;
+  va_start(ap, fmt);
+  len = vsnprintf(m->buf + m->count, m->size - m->count, fmt, ap);
+  va_end(ap);
+  // overflow - seq_read retries with a bigger buffer
+  if ((size_t)len >= m->size - m->count)
+    m->count = m->size;
+  else
+    m->count += len;
+  return 0;
+}
+
+void seq_puts(struct seq_file *m, const char *s) { seq_printf(m, "%s", s); }
+
+void seq_putc(struct seq_file *m, char c) { seq_printf(m, "%c", c); }
+
+int single_open(struct file *file, int (*show)(struct seq_file *, void *),
+                void *data) {
+  struct seq_file *m = calloc(1, sizeof(*m));
+
+  m->show = show;
+  m->private = data;
+  file->private_data = m;
+  return 0;
+}
+
+int single_release(struct inode *inode, struct file *file) {
+  struct seq_file *m = file->private_data;
+
+  free(m->buf);
+  free(m);
+  return 0;
+}
+
+ssize_t seq_read(struct file *file, char __user *buf, size_t count,
+                 loff_t *ppos) {
+  struct seq_file *m = file->private_data;
+  int err;
+
+  if (!m->buf) {
+    for (m->size = 4096;; m->size *= 2) {
+      m->buf = malloc(m->size);
+      m->count = 0;
+      err = m->show(m, NULL);
+      if (err < 0) {
+        free(m->buf);
+        m->buf = NULL;
+        return err;
+      }
+      if (m->count < m->size)
+        break;
+      free(m->buf);
+    }
+  }
+  return simple_read_from_buffer(buf, count, ppos, m->buf, m->count);
+}
+
+loff_t seq_lseek(struct file *file, loff_t offset, int whence) {
+  file->f_pos = offset;
+  return offset;
+}
+
+loff_t default_llseek(struct file *file, loff_t offset, int whence) {
+  file->f_pos = offset;
+  return offset;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 12, 0)
+loff_t no_llseek(struct file *file, loff_t offset, int whence) {
+  return -ESPIPE;
+}
+#endif
+
+int simple_open(struct inode *inode, struct file *file) {
+  file->private_data = inode->i_private;
+  return 0;
+}
+
+struct dentry {
+  char name[64];
+  struct dentry *parent;
+  const struct file_operations *fops;
+  void *data;
+  struct dentry *next;
+};
+
+static struct dentry *dentries;
+static pthread_mutex_t dentries_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct dentry *dentry_add(const char *name, struct dentry *parent,
+                                 const struct file_operations *fops,
+                                 void *data) {
+  struct dentry *d = calloc(1, sizeof(*d));
+
+  snprintf(d->name, sizeof(d->name), "%s", name);
+  d->parent = parent;
+  d->fops = fops;
+  d->data = data;
+  pthread_mutex_lock(&dentries_lock);
+  d->next = dentries;
+  dentries = d;
+  pthread_mutex_unlock(&dentries_lock);
+  return d;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent) {
+  return dentry_add(name, parent, NULL, NULL);
+}
+
+struct dentry *debugfs_create_file(const char *name, umode_t mode,
+                                   struct dentry *parent, void *data,
+                                   const struct file_operations *fops) {
+  return dentry_add(name, parent, fops, data);
+}
+
+static ssize_t u32_read(struct file *file, char __user *buf, size_t count,
+                        loff_t *ppos) {
+  char tmp[32];
+  int len = snprintf(tmp, sizeof(tmp), "%u\n", *(u32 *)file->private_data);
+
+  return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+static ssize_t u32_write(struct file *file, const char __user *buf,
+                         size_t count, loff_t *ppos) {
+  char tmp[32];
+  unsigned int val;
+  int err;
+
+  if (count >= sizeof(tmp))
+    return -EINVAL;
+  memcpy(tmp, buf, count);
+  tmp[count] = '\0';
+  err = kstrtouint(strim(tmp), 0, &val);
+  if (err)
+    return err;
+  *(u32 *)file->private_data = val;
+  return count;
+}
+
+static const struct file_operations u32_fops = {
+    .open = simple_open, .read = u32_read, .write = u32_write};
+
+void debugfs_create_u32(const char *name, umode_t mode, struct dentry *parent,
+                        u32 *value) {
+  dentry_add(name, parent, &u32_fops, value);
+}
+
+static ssize_t bool_read(struct file *file, char __user *buf, size_t count,
+                         loff_t *ppos) {
+  char tmp[4];
+  int len = snprintf(tmp, sizeof(tmp), "%c\n",
+                     *(bool *)file->private_data ? 'Y' : 'N');
+
+  return simple_read_from_buffer(buf, count, ppos, tmp, len);
+}
+
+static ssize_t bool_write(struct file *file, const char __user *buf,
+                          size_t count, loff_t *ppos) {
+  char tmp[8];
+  int err;
+
+  if (count >= sizeof(tmp))
+    return -EINVAL;
+  memcpy(tmp, buf, count);
+  tmp[count] = '\0';
+  err = kstrtobool(tmp, (bool *)file->private_data);
+  return err ? err : (ssize_t)count;
+}
+
+static const struct file_operations bool_fops = {
+    .open = simple_open, .read = bool_read, .write = bool_write};
+
+void debugfs_create_bool(const char *name, umode_t mode,
+                         struct dentry *parent, bool *value) {
+  dentry_add(name, parent, &bool_fops, value);
+}
+
+static bool dentry_below(struct dentry *d, struct dentry *root) {
+  for (; d; d = d->parent)
+    if (d == root)
+      return true;
+  return false;
+}
+
+void debugfs_remove_recursive(struct dentry *root) {
+  struct dentry **p, *d;
+
+  if (IS_ERR_OR_NULL(root))
+    return;
+  pthread_mutex_lock(&dentries_lock);
+  // children first, they point to their parents
+  for (p = &dentries; (d = *p);) {
+    if (d != root && dentry_below(d, root)) {
+      *p = d->next;
+      free(d);
+    } else {
+      p = &d->next;
+    }
+  }
+  for (p = &dentries; (d = *p); p = &d->next) {
+    if (d == root) {
+      *p = d->next;
+      free(d);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&dentries_lock);
+}
+
+static struct dentry *dentry_find(const char *name) {
+  struct dentry *d;
+
+  pthread_mutex_lock(&dentries_lock);
+  for (d = dentries; d; d = d->next)
+    if (d->fops && !strcmp(d->name, name))
+      break;
+  pthread_mutex_unlock(&dentries_lock);
+  return d;
+}
+
+ssize_t sim_debugfs_read(const char *name, char *buf, size_t size) {
+  struct dentry *d = dentry_find(name);
+  struct inode inode;
+  struct file file;
+  ssize_t ret, total = 0;
+  loff_t pos = 0;
+
+  if (!d)
+    return -ENOENT;
+  if (!d->fops->read)
+    return -EACCES;
+  inode.i_private = d->data;
+  memset(&file, 0, sizeof(file));
+  if (d->fops->open && (ret = d->fops->open(&inode, &file)))
+    return ret;
+  while ((size_t)total < size - 1) {
+    ret = d->fops->read(&file, buf + total, size - 1 - total, &pos);
+    if (ret <= 0)
+      break;
+    total += ret;
+  }
+  if (d->fops->release)
+    d->fops->release(&inode, &file);
+  buf[total] = '\0';
+  // like a read() loop: an error after some data ends the data
+  return ret < 0 && !total ? ret : total;
+}
+
+// one debugfs file kept open across commands, for stream readers
+static struct {
+  struct dentry *d;
+  struct inode inode;
+  struct file file;
+  loff_t pos;
+} held;
+
+int sim_debugfs_open(const char *name) {
+  struct dentry *d = dentry_find(name);
+  int ret;
+
+  sim_debugfs_close();
+  if (!d)
+    return -ENOENT;
+  memset(&held, 0, sizeof(held));
+  held.inode.i_private = d->data;
+  if (d->fops->open && (ret = d->fops->open(&held.inode, &held.file)))
+    return ret;
+  held.d = d;
+  return 0;
+}
+
+ssize_t sim_debugfs_read_held(void *buf, size_t size) {
+  if (!held.d)
+    return -EBADF;
+  return held.d->fops->read(&held.file, buf, size, &held.pos);
+}
+
+void sim_debugfs_close(void) {
+  if (held.d && held.d->fops->release)
+    held.d->fops->release(&held.inode, &held.file);
+  held.d = NULL;
+}
+
+ssize_t sim_debugfs_write(const char *name, const void *buf, size_t size) {
+  struct dentry *d = dentry_find(name);
+  struct inode inode;
+  struct file file;
+  loff_t pos = 0;
+  ssize_t ret;
+
+  if (!d)
+    return -ENOENT;
+  if (!d->fops->write)
+    return -EACCES;
+  inode.i_private = d->data;
+  memset(&file, 0, sizeof(file));
+  if (d->fops->open && (ret = d->fops->open(&inode, &file)))
+    return ret;
+  ret = d->fops->write(&file, buf, size, &pos);
+  if (d->fops->release)
+    d->fops->release(&inode, &file);
+  return ret;
+}
+
+//////
+////// THERMAL
+//////
+
+#define SIM_CDEVS 4
+#define SIM_ZONES 2
+#define SIM_BINDINGS 4
+
+struct thermal_zone_device {
+  char type[32];
+  const struct thermal_trip *trips;
+  int num_trips;
+  void *devdata;
+  const struct thermal_zone_device_ops *ops;
+  bool enabled;
+  struct {
+    struct thermal_cooling_device *cdev;
+    int trip;
+  } bound[SIM_BINDINGS];
+};
+
+// everything registered, only changed by (un)register and (un)bind
+static struct thermal_cooling_device *cdevs[SIM_CDEVS];
+static struct thermal_zone_device *zones[SIM_ZONES];
+static pthread_mutex_t thermal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// offer 'cdev' to / take it from 'tz', the way the simulated kernel does
+static void zone_bind(struct thermal_zone_device *tz,
+                      struct thermal_cooling_device *cdev);
+static void zone_unbind(struct thermal_zone_device *tz,
+                        struct thermal_cooling_device *cdev);
+
+struct thermal_cooling_device *thermal_cooling_device_register(
+    const char *type, void *devdata,
+    const struct thermal_cooling_device_ops *ops) {
+  struct thermal_cooling_device *cdev;
+  int i, slot = -1;
+
+  pthread_mutex_lock(&thermal_lock);
+  for (i = 0; i < SIM_CDEVS && slot < 0; i++)
+    if (!cdevs[i])
+      slot = i;
+  if (slot < 0) {
+    pthread_mutex_unlock(&thermal_lock);
+    return ERR_PTR(-ENOSPC);
+  }
+  cdev = calloc(1, sizeof(*cdev));
+  cdev->type = type;
+  cdev->devdata = devdata;
+  cdev->ops = ops;
+  cdevs[slot] = cdev;
+  pthread_mutex_unlock(&thermal_lock);
+
+  // like the core: offer the new device to every zone
+  for (i = 0; i < SIM_ZONES; i++)
+    if (zones[i])
+      zone_bind(zones[i], cdev);
+  return cdev;
+}
+
+void thermal_cooling_device_unregister(struct thermal_cooling_device *cdev) {
+  int i;
+
+  for (i = 0; i < SIM_ZONES; i++)
+    if (zones[i])
+      zone_unbind(zones[i], cdev);
+  pthread_mutex_lock(&thermal_lock);
+  for (i = 0; i < SIM_CDEVS; i++)
+    if (cdevs[i] == cdev)
+      cdevs[i] = NULL;
+  pthread_mutex_unlock(&thermal_lock);
+  free(cdev);
+}
+
+struct thermal_zone_device *thermal_zone_device_register_with_trips(
+    const char *type, const struct thermal_trip *trips, int num_trips,
+    void *devdata, const struct thermal_zone_device_ops *ops,
+    const struct thermal_zone_params *tzp, unsigned int passive_delay,
+    unsigned int polling_delay) {
+  struct thermal_zone_device *tz;
+  int i, slot = -1;
+
+  if (!ops || !ops->get_temp)
+    return ERR_PTR(-EINVAL);
+  pthread_mutex_lock(&thermal_lock);
+  for (i = 0; i < SIM_ZONES && slot < 0; i++)
+    if (!zones[i])
+      slot = i;
+  if (slot < 0) {
+    pthread_mutex_unlock(&thermal_lock);
+    return ERR_PTR(-ENOSPC);
+  }
+  tz = calloc(1, sizeof(*tz));
+  snprintf(tz->type, sizeof(tz->type), "%s", type);
+  tz->trips = trips;
+  tz->num_trips = num_trips;
+  tz->devdata = devdata;
+  tz->ops = ops;
+  zones[slot] = tz;
+  pthread_mutex_unlock(&thermal_lock);
+
+  for (i = 0; i < SIM_CDEVS; i++)
+    if (cdevs[i])
+      zone_bind(tz, cdevs[i]);
+  return tz;
+}
+
+int thermal_zone_device_enable(struct thermal_zone_device *tz) {
+  tz->enabled = true;
+  return 0;
+}
+
+void thermal_zone_device_unregister(struct thermal_zone_device *tz) {
+  int i;
+
+  if (!tz)
+    return;
+  for (i = 0; i < SIM_CDEVS; i++)
+    if (cdevs[i])
+      zone_unbind(tz, cdevs[i]);
+  pthread_mutex_lock(&thermal_lock);
+  for (i = 0; i < SIM_ZONES; i++)
+    if (zones[i] == tz)
+      zones[i] = NULL;
+  pthread_mutex_unlock(&thermal_lock);
+  free(tz);
+}
+
+void *thermal_zone_device_priv(struct thermal_zone_device *tz) {
+  return tz->devdata;
+}
+
+static int bind_add(struct thermal_zone_device *tz, int trip,
+                    struct thermal_cooling_device *cdev) {
+  int i;
+
+  if (trip < 0 || trip >= tz->num_trips)
+    return -EINVAL;
+  for (i = 0; i < SIM_BINDINGS; i++) {
+    if (!tz->bound[i].cdev) {
+      tz->bound[i].cdev = cdev;
+      tz->bound[i].trip = trip;
+      return 0;
+    }
+  }
+  return -ENOSPC;
+}
+
+// 'trip' < 0: every binding of 'cdev'
+static int bind_del(struct thermal_zone_device *tz, int trip,
+                    struct thermal_cooling_device *cdev) {
+  int i, ret = -ENODEV;
+
+  for (i = 0; i < SIM_BINDINGS; i++) {
+    if (tz->bound[i].cdev == cdev && (trip < 0 || tz->bound[i].trip == trip)) {
+      tz->bound[i].cdev = NULL;
+      ret = 0;
+    }
+  }
+  return ret;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+// the core binds on its own, the driver only picks
+static void zone_bind(struct thermal_zone_device *tz,
+                      struct thermal_cooling_device *cdev) {
+  struct cooling_spec c;
+  int trip;
+
+  for (trip = 0; trip < tz->num_trips; trip++) {
+    c = (struct cooling_spec){THERMAL_NO_LIMIT, THERMAL_NO_LIMIT,
+                              THERMAL_WEIGHT_DEFAULT};
+    if (tz->ops->should_bind &&
+        tz->ops->should_bind(tz, &tz->trips[trip], cdev, &c))
+      bind_add(tz, trip, cdev);
+  }
+}
+
+static void zone_unbind(struct thermal_zone_device *tz,
+                        struct thermal_cooling_device *cdev) {
+  bind_del(tz, -1, cdev);
+}
+#else
+static void zone_bind(struct thermal_zone_device *tz,
+                      struct thermal_cooling_device *cdev) {
+  if (tz->ops->bind)
+    tz->ops->bind(tz, cdev);
+}
+
+static void zone_unbind(struct thermal_zone_device *tz,
+                        struct thermal_cooling_device *cdev) {
+  if (tz->ops->unbind)
+    tz->ops->unbind(tz, cdev);
+}
+
+int thermal_zone_bind_cooling_device(struct thermal_zone_device *tz,
+                                     int trip,
+                                     struct thermal_cooling_device *cdev,
+                                     unsigned long upper, unsigned long lower,
+                                     unsigned int weight) {
+  return bind_add(tz, trip, cdev);
+}
+
+int thermal_zone_unbind_cooling_device(struct thermal_zone_device *tz,
+                                       int trip,
+                                       struct thermal_cooling_device *cdev) {
+  return bind_del(tz, trip, cdev);
+}
+#endif
+
+static struct thermal_cooling_device *cdev_find(const char *type) {
+  int i;
+
+  for (i = 0; i < SIM_CDEVS; i++)
+    if (cdevs[i] && !strcmp(cdevs[i]->type, type))
+      return cdevs[i];
+  return NULL;
+}
+
+static struct thermal_zone_device *zone_find(const char *type) {
+  int i;
+
+  for (i = 0; i < SIM_ZONES; i++)
+    if (zones[i] && !strcmp(zones[i]->type, type))
+      return zones[i];
+  return NULL;
+}
+
+int sim_cdev_set(const char *type, unsigned long state) {
+  struct thermal_cooling_device *cdev = cdev_find(type);
+
+  if (!cdev)
+    return -ENODEV;
+  return cdev->ops->set_cur_state(cdev, state);
+}
+
+int sim_thermal_get(const char *name, long *value) {
+  struct thermal_cooling_device *cdev = cdev_find(name);
+  struct thermal_zone_device *tz = zone_find(name);
+  unsigned long state;
+  int ret, temp, i;
+
+  if (cdev) {
+    ret = cdev->ops->get_cur_state(cdev, &state);
+    *value = state;
+    return ret;
+  }
+  if (tz) {
+    ret = tz->ops->get_temp(tz, &temp);
+    *value = temp;
+    return ret;
+  }
+  // "<zone>_bound": number of bound cooling devices
+  for (i = 0; i < SIM_ZONES; i++) {
+    if (zones[i] && !strncmp(name, zones[i]->type, strlen(zones[i]->type)) &&
+        !strcmp(name + strlen(zones[i]->type), "_bound")) {
+      for (*value = 0, ret = 0; ret < SIM_BINDINGS; ret++)
+        *value += !!zones[i]->bound[ret].cdev;
+      return 0;
+    }
+  }
+  return -ENODEV;
+}
+
+// a minimal step_wise: one step up per bound device while the zone is at or
+// above the trip, one step down below it (minus its hysteresis)
+int sim_thermal_update(const char *type) {
+  struct thermal_zone_device *tz = zone_find(type);
+  struct thermal_cooling_device *cdev;
+  const struct thermal_trip *trip;
+  unsigned long cur, max;
+  int i, temp, ret;
+
+  if (!tz)
+    return -ENODEV;
+  if (!tz->enabled)
+    return -EAGAIN;
+  ret = tz->ops->get_temp(tz, &temp);
+  if (ret)
+    return ret;
+  for (i = 0; i < SIM_BINDINGS; i++) {
+    if (!(cdev = tz->bound[i].cdev))
+      continue;
+    trip = &tz->trips[tz->bound[i].trip];
+    cdev->ops->get_cur_state(cdev, &cur);
+    cdev->ops->get_max_state(cdev, &max);
+    if (temp >= trip->temperature && cur < max)
+      ret = cdev->ops->set_cur_state(cdev, cur + 1);
+    else if (temp < trip->temperature - trip->hysteresis && cur > 0)
+      ret = cdev->ops->set_cur_state(cdev, cur - 1);
+    if (ret)
+      return ret;
+  }
+  return 0;
+}
+
+//////
+////// MISC DEVICE / MM
+//////
+
+unsigned long get_zeroed_page(gfp_t gfp) {
+  void *page;
+
+  if (posix_memalign(&page, PAGE_SIZE, PAGE_SIZE))
+    return 0;
+  memset(page, 0, PAGE_SIZE);
+  return (unsigned long)page;
+}
+
+void free_page(unsigned long addr) {
+  free((void *)addr);
+}
+
+int vm_insert_page(struct vm_area_struct *vma, unsigned long addr,
+                   struct page *page) {
+  if (addr < vma->vm_start || addr + PAGE_SIZE > vma->vm_end)
+    return -EFAULT;
+  vma->sim_page = page;
+  return 0;
+}
+
+static struct miscdevice *misc_dev;
+// the one open file of it, and what is mapped through that file
+static struct {
+  struct inode inode;
+  struct file file;
+  bool open;
+  const void *page;
+} dev;
+
+int misc_register(struct miscdevice *misc) {
+  if (misc_dev)
+    return -EBUSY;
+  if (!misc->name || !misc->fops)
+    return -EINVAL;
+  misc_dev = misc;
+  return 0;
+}
+
+void misc_deregister(struct miscdevice *misc) {
+  if (misc_dev != misc) {
+    fprintf(stderr, "sim: misc_deregister of an unregistered device\n");
+    abort();
+  }
+  misc_dev = NULL;
+}
+
+long compat_ptr_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+  const struct miscdevice *misc = file->private_data;
+
+  return misc->fops->unlocked_ioctl(file, cmd, arg);
+}
+
+loff_t noop_llseek(struct file *file, loff_t offset, int whence) {
+  return file->f_pos;
+}
+
+int sim_dev_open(bool write) {
+  int ret;
+
+  sim_dev_close();
+  if (!misc_dev)
+    return -ENODEV;
+  memset(&dev, 0, sizeof(dev));
+  dev.file.f_mode = FMODE_READ | (write ? FMODE_WRITE : 0);
+  // like misc_open(): the driver finds itself through 'private_data'
+  dev.file.private_data = misc_dev;
+  if (misc_dev->fops->open &&
+      (ret = misc_dev->fops->open(&dev.inode, &dev.file)))
+    return ret;
+  dev.open = true;
+  return 0;
+}
+
+long sim_dev_ioctl(unsigned int cmd, void *arg) {
+  if (!dev.open)
+    return -EBADF;
+  if (!misc_dev->fops->unlocked_ioctl)
+    return -ENOTTY;
+  return misc_dev->fops->unlocked_ioctl(&dev.file, cmd, (unsigned long)arg);
+}
+
+int sim_dev_mmap(unsigned long pgoff, size_t size, bool write,
+                 const void **page) {
+  struct vm_area_struct vma = {
+      .vm_start = 0x10000,
+      .vm_end = 0x10000 + size,
+      .vm_pgoff = pgoff,
+      .vm_flags = VM_READ | VM_MAYREAD | VM_MAYWRITE | (write ? VM_WRITE : 0),
+  };
+  int ret;
+
+  if (!dev.open)
+    return -EBADF;
+  if (!misc_dev->fops->mmap)
+    return -ENODEV;
+  // a shared writable mapping needs a file opened for writing
+  if (write && !(dev.file.f_mode & FMODE_WRITE))
+    return -EACCES;
+  if ((ret = misc_dev->fops->mmap(&dev.file, &vma)))
+    return ret;
+  if (!vma.sim_page)
+    return -EFAULT;
+  dev.page = vma.sim_page;
+  if (page)
+    *page = dev.page;
+  return 0;
+}
+
+const void *sim_dev_page(void) {
+  return dev.page;
+}
+
+void sim_dev_close(void) {
+  if (dev.open && misc_dev && misc_dev->fops->release)
+    misc_dev->fops->release(&dev.inode, &dev.file);
+  dev.open = false;
+  dev.page = NULL;
+}
+
+//////
+////// PLATFORM PROFILE
+//////
+
+// names as in /sys/firmware/acpi/platform_profile
+static const char *const profile_names[PLATFORM_PROFILE_LAST] = {
+    [PLATFORM_PROFILE_LOW_POWER] = "low-power",
+    [PLATFORM_PROFILE_COOL] = "cool",
+    [PLATFORM_PROFILE_QUIET] = "quiet",
+    [PLATFORM_PROFILE_BALANCED] = "balanced",
+    [PLATFORM_PROFILE_BALANCED_PERFORMANCE] = "balanced-performance",
+    [PLATFORM_PROFILE_PERFORMANCE] = "performance",
+};
+
+static bool profile_busy;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+// the class device of the core, 'dev' first
+struct sim_profile {
+  struct device dev;
+  const struct platform_profile_ops *ops;
+  unsigned long choices[BITS_TO_LONGS(PLATFORM_PROFILE_LAST)];
+};
+
+static struct sim_profile *profile_handler;
+
+struct device *platform_profile_register(
+    struct device *dev, const char *name, void *drvdata,
+    const struct platform_profile_ops *ops) {
+  struct sim_profile *p;
+  int err;
+
+  if (!ops->probe || !ops->profile_get || !ops->profile_set)
+    return ERR_PTR(-EINVAL);
+  p = calloc(1, sizeof(*p));
+  if (!p)
+    return ERR_PTR(-ENOMEM);
+  p->dev.parent = dev;
+  p->dev.driver_data = drvdata;
+  p->ops = ops;
+  err = ops->probe(drvdata, p->choices);
+  if (!err && !p->choices[0])
+    err = -EINVAL;
+  pthread_mutex_lock(&profile_lock);
+  if (!err && (profile_handler || profile_busy))
+    err = -EEXIST;
+  if (!err)
+    profile_handler = p;
+  pthread_mutex_unlock(&profile_lock);
+  if (err) {
+    free(p);
+    return ERR_PTR(err);
+  }
+  return &p->dev;
+}
+
+void platform_profile_remove(struct device *dev) {
+  struct sim_profile *p = container_of(dev, struct sim_profile, dev);
+
+  pthread_mutex_lock(&profile_lock);
+  if (profile_handler == p)
+    profile_handler = NULL;
+  pthread_mutex_unlock(&profile_lock);
+  free(p);
+}
+
+void platform_profile_notify(struct device *dev) {
+  sim_trace("platform_profile_notify");
+}
+
+#define profile_call(op, ...) \
+  profile_handler->ops->op(&profile_handler->dev, __VA_ARGS__)
+#else
+static struct platform_profile_handler *profile_handler;
+
+int platform_profile_register(struct platform_profile_handler *pprof) {
+  int ret = 0;
+
+  pthread_mutex_lock(&profile_lock);
+  if (profile_handler || profile_busy)
+    ret = -EEXIST;
+  else if (!pprof->profile_get || !pprof->profile_set)
+    ret = -EINVAL;
+  else
+    profile_handler = pprof;
+  pthread_mutex_unlock(&profile_lock);
+  return ret;
+}
+
+int platform_profile_remove(void) {
+  pthread_mutex_lock(&profile_lock);
+  profile_handler = NULL;
+  pthread_mutex_unlock(&profile_lock);
+  return 0;
+}
+
+void platform_profile_notify(void) {
+  sim_trace("platform_profile_notify");
+}
+
+#define profile_call(op, ...) profile_handler->op(profile_handler, __VA_ARGS__)
+#endif
+
+void sim_profile_set_busy(bool busy) {
+  pthread_mutex_lock(&profile_lock);
+  profile_busy = busy;
+  pthread_mutex_unlock(&profile_lock);
+}
+
+int sim_profile_set(const char *name) {
+  int i, ret = -EINVAL;
+
+  pthread_mutex_lock(&profile_lock);
+  for (i = 0; i < PLATFORM_PROFILE_LAST; i++)
+    if (!strcmp(profile_names[i], name))
+      break;
+  if (!profile_handler)
+    ret = -ENODEV;
+  else if (i < PLATFORM_PROFILE_LAST && !test_bit(i, profile_handler->choices))
+    ret = -EOPNOTSUPP;
+  else if (i < PLATFORM_PROFILE_LAST)
+    ret = profile_call(profile_set, i);
+  pthread_mutex_unlock(&profile_lock);
+  return ret;
+}
+
+int sim_profile_get(char *buf, size_t size) {
+  enum platform_profile_option profile;
+  int ret = -ENODEV;
+
+  pthread_mutex_lock(&profile_lock);
+  if (profile_handler)
+    ret = profile_call(profile_get, &profile);
+  if (!ret)
+    snprintf(buf, size, "%s", profile_names[profile]);
+  pthread_mutex_unlock(&profile_lock);
+  return ret;
+}
+
+//////
+////// ACPI / DMI
+//////
+
+acpi_status acpi_get_handle(acpi_handle parent, acpi_string pathname,
+                            acpi_handle *ret_handle) {
+  int method = sim_ec_lookup(pathname);
+
+  if (method < 0)
+    return AE_NOT_FOUND;
+  *ret_handle = (acpi_handle)(long)(method + 1);
+  return AE_OK;
+}
+
+acpi_status acpi_evaluate_integer(acpi_handle handle, acpi_string pathname,
+                                  struct acpi_object_list *arguments,
+                                  unsigned long long *data) {
+  unsigned long long args[8];
+  int method, argc = 0, i;
+
+  if (handle)
+    method = (int)(long)handle - 1;
+  else
+    method = sim_ec_lookup(pathname);
+  if (method < 0)
+    return AE_NOT_FOUND;
+  if (arguments) {
+    argc = min((int)arguments->count, (int)ARRAY_SIZE(args));
+    for (i = 0; i < argc; i++) {
+      if (arguments->pointer[i].type != ACPI_TYPE_INTEGER)
+        return AE_BAD_PARAMETER;
+      args[i] = arguments->pointer[i].integer.value;
+    }
+  }
+  return sim_ec_call(method, argc, args, data) ? AE_ERROR : AE_OK;
+}
+
+int ec_read(u8 addr, u8 *val) {
+  return sim_ec_read_reg(addr, val) ? -ENODEV : 0;
+}
+
+static const char *dmi_strings[DMI_STRING_MAX] = {
+    [DMI_SYS_VENDOR] = "ASUSTeK COMPUTER INC.",
+    [DMI_PRODUCT_NAME] = "UX32VD",
+    [DMI_BOARD_VENDOR] = "ASUSTeK COMPUTER INC.",
+    [DMI_BOARD_NAME] = "UX32VD",
+};
+
+const char *dmi_get_system_info(int field) {
+  if (field <= DMI_NONE || field >= DMI_STRING_MAX)
+    return NULL;
+  return dmi_strings[field];
+}
+
+// same rules as the kernel: all set slots have to match, as substring
+// unless 'exact_match'
+static bool dmi_matches(const struct dmi_system_id *dmi) {
+  const struct dmi_strmatch *m;
+  const char *value;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE(dmi->matches); i++) {
+    m = &dmi->matches[i];
+    if (m->slot == DMI_NONE)
+      break;
+    value = dmi_get_system_info(m->slot);
+    if (!value)
+      return false;
+    if (m->exact_match ? strcmp(value, m->substr) : !strstr(value, m->substr))
+      return false;
+  }
+  return true;
+}
+
+const struct dmi_system_id *dmi_first_match(const struct dmi_system_id *list) {
+  const struct dmi_system_id *d;
+
+  for (d = list; d->matches[0].slot != DMI_NONE; d++)
+    if (dmi_matches(d))
+      return d;
+  return NULL;
+}
+
+void sim_dmi_set(int field, const char *value) {
+  if (field > DMI_NONE && field < DMI_STRING_MAX)
+    dmi_strings[field] = strdup(value);
+}
+
+//////
+////// MODULE
+//////
+
+static struct {
+  const char *name;
+  void *ptr;
+  enum sim_param_type type;
+} params[64];
+static int nparams;
+
+void sim_param_register(const char *name, void *ptr,
+                        enum sim_param_type type) {
+  if (nparams < (int)ARRAY_SIZE(params)) {
+    params[nparams].name = name;
+    params[nparams].ptr = ptr;
+    params[nparams].type = type;
+    nparams++;
+  }
+}
+
+static int param_parse(int i, const char *value) {
+  switch (params[i].type) {
+    case SIM_PARAM_UINT:
+      return kstrtouint(value, 0, params[i].ptr);
+    case SIM_PARAM_INT:
+      return kstrtoint(value, 0, params[i].ptr);
+    case SIM_PARAM_BOOL:
+      return kstrtobool(value, params[i].ptr);
+  }
+  return -EINVAL;
+}
+
+// parameters given before loading (like insmod arguments)
+static struct {
+  char name[64];
+  char value[64];
+} pending[64];
+static int npending;
+
+static void *module_handle;
+static char module_path[4096] = "./asus_fan.so";
+
+int sim_param_set(const char *name, const char *value) {
+  int i;
+
+  if (!module_handle) {
+    for (i = 0; i < npending; i++)
+      if (!strcmp(pending[i].name, name))
+        break;
+    if (i == (int)ARRAY_SIZE(pending))
+      return -ENOSPC;
+    snprintf(pending[i].name, sizeof(pending[i].name), "%s", name);
+    snprintf(pending[i].value, sizeof(pending[i].value), "%s", value);
+    if (i == npending)
+      npending++;
+    return 0;
+  }
+  for (i = 0; i < nparams; i++)
+    if (!strcmp(params[i].name, name))
+      return param_parse(i, value);
+  return -ENOENT;
+}
+
+int sim_param_get(const char *name, char *buf, size_t size) {
+  int i;
+
+  for (i = 0; i < nparams; i++) {
+    if (strcmp(params[i].name, name))
+      continue;
+    switch (params[i].type) {
+      case SIM_PARAM_UINT:
+        return snprintf(buf, size, "%u", *(unsigned int *)params[i].ptr);
+      case SIM_PARAM_INT:
+        return snprintf(buf, size, "%d", *(int *)params[i].ptr);
+      case SIM_PARAM_BOOL:
+        return snprintf(buf, size, "%c", *(bool *)params[i].ptr ? 'Y' : 'N');
+    }
+  }
+  return -ENOENT;
+}
+
+void sim_set_module(const char *path) {
+  snprintf(module_path, sizeof(module_path), "%s", path);
+}
+
+// every load starts from a fresh copy of the module (like insmod)
+int sim_load(void) {
+  int (*init)(void);
+  int i, err;
+
+  if (module_handle)
+    return -EEXIST;
+  nparams = 0;
+  module_handle = dlopen(module_path, RTLD_NOW | RTLD_LOCAL);
+  if (!module_handle) {
+    fprintf(stderr, "sim: %s\n", dlerror());
+    return -ENOENT;
+  }
+  for (i = 0; i < npending; i++) {
+    err = sim_param_set(pending[i].name, pending[i].value);
+    if (err) {
+      fprintf(stderr, "sim: bad parameter %s=%s\n", pending[i].name,
+              pending[i].value);
+      goto fail;
+    }
+  }
+  init = (int (*)(void))dlsym(module_handle, "sim_module_init");
+  err = init ? init() : -ENOEXEC;
+  if (!err)
+    return 0;
+fail:
+  sim_wq_idle();
+  dlclose(module_handle);
+  module_handle = NULL;
+  nparams = 0;
+  npending = 0;
+  return err;
+}
+
+void sim_unload(void) {
+  void (*exit_fn)(void);
+  struct work_struct *work;
+
+  if (!module_handle)
+    return;
+  sim_debugfs_close();
+  sim_dev_close();
+  exit_fn = (void (*)(void))dlsym(module_handle, "sim_module_exit");
+  if (exit_fn)
+    exit_fn();
+  sim_wq_idle();
+
+  // whatever is still queued would run after the module is gone
+  pthread_mutex_lock(&wq_lock);
+  for (work = wq_pending; work; work = work->next) {
+    fprintf(stderr, "sim: work item %p still queued after unload\n",
+            (void *)work);
+    abort();
+  }
+  pthread_mutex_unlock(&wq_lock);
+
+  dlclose(module_handle);
+  module_handle = NULL;
+  nparams = 0;
+  npending = 0;
+}
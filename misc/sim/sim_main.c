@@ -0,0 +1,884 @@
+/**
+ *  asus-fan userspace simulation - script interpreter
+ *
+ *  usage: asus_fan_sim [-v] [script ...]   (stdin without a script)
+ *
+ *  The module itself is asus_fan.so next to the simulator, every 'load'
+ *  starts from a fresh copy of it.
+ *
+ *  One command per line, '#' starts a comment:
+ *
+ *    ec <key> <value>              set a model parameter (see sim_ec.c)
+ *    ec dump                       print the model state
+ *    param <name> <value>          set a module parameter
+ *    dmi <vendor|product|board> <string>
+ *    time_scale <factor>           run simulated time faster than real time
+ *    load / unload                 module_init (and wait for the probe) /
+ *                                  module_exit
+ *    load nowait                   module_init only, the probe may still run
+ *    settle                        wait for the probe after 'load nowait'
+ *    suspend / resume              system sleep, the ec forgets the manual
+ *                                  speeds and the max speed meanwhile
+ *    list                          list all visible attributes
+ *    read <attr>                   print an attribute
+ *    write <attr> <value>
+ *    expect <attr> <value>         fail unless the attribute reads <value>
+ *    expect_range <attr> <lo> <hi>
+ *    expect_missing <attr>         fail if the attribute is visible
+ *    expect_error write <attr> <value>
+ *    expect_error load
+ *    expect_error debugfs read <file>
+ *    expect_error debugfs write <file> <value>
+ *    expect_error thermal <name>   (not registered)
+ *    expect_error profile <name>
+ *    expect_ec <key> <lo> <hi>     fail unless the model value is in range
+ *    expect_param <name> <value>
+ *    expect_notified <attr> <min>  fail unless sysfs_notify()d >= min times
+ *    expect_traced <event> <min>   fail unless the tracepoint was hit >= min
+ *                                  times
+ *    thermal set <cdev> <state>    set a cooling device's state
+ *    thermal update <zone>         one step of a minimal step_wise governor
+ *    expect_thermal <name> <lo> <hi>  cooling device state, zone temperature
+ *                                  or "<zone>_bound" (bound devices)
+ *    profile <name>                set the platform profile
+ *    expect_profile <name>         ("none" without a handler)
+ *    profile_busy <0|1>            another driver holds the platform profile
+ *    dev open [rw]                 open /dev/asus_fan (one file at a time,
+ *                                  read-only without 'rw') ...
+ *    dev set_pwm <fans> <pwm1> <pwm2>  ... ASUS_FAN_IOC_SET_PWM ('fans' as a
+ *                                  bit mask)
+ *    dev mmap [rw]                 ... map the status page
+ *    expect_dev <field> <lo> <hi>  ... value of ASUS_FAN_IOC_STATUS in range
+ *    expect_page <field> <lo> <hi> ... value on the mapped page in range
+ *                                  (fields: fans rpm1 rpm2 pwm1 pwm2 mode1
+ *                                  mode2 temp alarms max_speed)
+ *    dev close
+ *    expect_error dev <open|set_pwm|mmap> ...
+ *    sleep <ms>                    simulated milliseconds
+ *    idle                          wait until no work item is due or running
+ *    debugfs read <file>
+ *    debugfs write <file> <value>
+ *    debugfs open <file>           keep a file open (one at a time) ...
+ *    expect_stream <bytes> <lo> <hi>  ... one read() of it returns lo..hi
+ *                                  (-errno on errors)
+ *    debugfs close
+ *    debugfs save <file> <path>    copy a (stream) file to <path>
+ *    expect_debugfs <file> <substring>  (blanks collapsed)
+ *    expect_debugfs_range <file> <key> <lo> <hi>  value of the "key value"
+ *                                  line in range
+ *    replay <path> <threshold> [label]  play the heat load of a recording
+ *                                  of debugfs 'record' against the loaded
+ *                                  module and print its metrics (and those
+ *                                  of the recording), see sim_replay.c
+ *    expect_replay <metric> <lo> <hi>  metric of the last replay in range
+ *    calib_write <attr> <pwm:rpm> ...
+ *    calib_read <attr>
+ *    bench read|write <attr> <iterations> [threads] [value]
+ *    stress <ms> <threads>         random reads/writes of all attributes,
+ *                                  fails on errors or inconsistent states
+ *
+ *  The exit code is the number of failed expectations (0 = all passed).
+ *
+**/
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "include/sim_kernel.h"
+#include "sim.h"
+#include "sim_ec.h"
+#include "sim_replay.h"
+#include "../../asus_fan_uapi.h"
+
+#define MAX_ARGS 40
+
+static int failures;
+static struct sim_replay_metrics replayed;
+static const char *script_name = "<stdin>";
+static int script_line;
+
+static void fail(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void fail(const char *fmt, ...) {
+  va_list ap;
+
+  va_start(ap, fmt);
+  fprintf(stderr, "FAIL %s:%d: ", script_name, script_line);
+  vfprintf(stderr, fmt, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+  failures++;
+}
+
+static void strip_newline(char *s) {
+  size_t len = strlen(s);
+
+  while (len && (s[len - 1] == '\n' || s[len - 1] == ' '))
+    s[--len] = '\0';
+}
+
+//////
+////// BENCHMARK
+//////
+
+struct bench {
+  const char *attr;
+  const char *value;
+  bool write;
+  long iterations;
+  u64 *lat;
+  long errors;
+};
+
+static u64 now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *bench_thread(void *arg) {
+  struct bench *b = arg;
+  char buf[4096];
+  ssize_t ret;
+  u64 start;
+  long i;
+
+  for (i = 0; i < b->iterations; i++) {
+    start = now_ns();
+    if (b->write)
+      ret = sim_attr_write(b->attr, b->value);
+    else
+      ret = sim_attr_read(b->attr, buf, sizeof(buf));
+    b->lat[i] = now_ns() - start;
+    if (ret < 0)
+      b->errors++;
+  }
+  return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void bench(bool write, const char *attr, long iterations, int threads,
+                  const char *value) {
+  struct bench *b = calloc(threads, sizeof(*b));
+  pthread_t *tid = calloc(threads, sizeof(*tid));
+  u64 *all, start, elapsed;
+  long total = (long)threads * iterations, errors = 0, n = 0;
+  int t;
+
+  all = calloc(total, sizeof(*all));
+  start = now_ns();
+  for (t = 0; t < threads; t++) {
+    b[t].attr = attr;
+    b[t].value = value;
+    b[t].write = write;
+    b[t].iterations = iterations;
+    b[t].lat = calloc(iterations, sizeof(u64));
+    pthread_create(&tid[t], NULL, bench_thread, &b[t]);
+  }
+  for (t = 0; t < threads; t++) {
+    pthread_join(tid[t], NULL);
+    memcpy(all + n, b[t].lat, iterations * sizeof(u64));
+    n += iterations;
+    errors += b[t].errors;
+    free(b[t].lat);
+  }
+  elapsed = now_ns() - start;
+  qsort(all, total, sizeof(u64), cmp_u64);
+
+  printf("bench %s %s: %ld ops, %d threads, %.0f ops/s, "
+         "p50 %.1fus p99 %.1fus max %.1fus, %ld errors\n",
+         write ? "write" : "read", attr, total, threads,
+         total / (elapsed / 1e9), all[total / 2] / 1e3,
+         all[(long)(total * 0.99)] / 1e3, all[total - 1] / 1e3, errors);
+  if (errors)
+    fail("bench %s: %ld errors", attr, errors);
+  free(all);
+  free(tid);
+  free(b);
+}
+
+//////
+////// STRESS
+//////
+
+// attributes hammered by 'stress' - readers check every value for its range
+struct stress_attr {
+  const char *name;
+  long lo, hi;
+  bool writable;
+};
+
+static const struct stress_attr stress_attrs[] = {
+    {"pwm1", 0, 255, true},
+    {"pwm2", 0, 255, true},
+    {"pwm1_enable", 0, 3, true},
+    {"pwm2_enable", 0, 3, true},
+    {"fan1_input", 0, 10000, false},
+    {"fan2_input", 0, 10000, false},
+    {"temp1_input", 0, 150000, false},
+    {"fan1_speed_max", 0, 255, false},
+    {"update_interval", 100, 60000, true},
+    {"pwm1_auto_point3_pwm", 0, 255, true},
+    {"pwm2_auto_point3_temp", 0, 105000, true},
+};
+
+struct stress {
+  const struct stress_attr **attrs;
+  int nattrs;
+  u64 deadline;
+  unsigned int seed;
+  long reads, writes, errors, inconsistent;
+  u64 *lat;
+  long nlat, maxlat;
+};
+
+static void stress_value(const struct stress_attr *a, unsigned int *seed,
+                         char *buf, size_t size) {
+  static const int modes[] = {0, 1, 1, 3};
+
+  if (strstr(a->name, "_enable"))
+    snprintf(buf, size, "%d", modes[rand_r(seed) % 4]);
+  else if (!strcmp(a->name, "update_interval"))
+    snprintf(buf, size, "%d", 100 + rand_r(seed) % 1900);
+  else if (strstr(a->name, "_temp"))
+    snprintf(buf, size, "%d", 60000 + rand_r(seed) % 10000);
+  else
+    snprintf(buf, size, "%d", rand_r(seed) % 256);
+}
+
+static void *stress_thread(void *arg) {
+  struct stress *s = arg;
+  const struct stress_attr *a;
+  char buf[64], *end;
+  ssize_t ret;
+  long value;
+  u64 start;
+
+  while (now_ns() < s->deadline) {
+    a = s->attrs[rand_r(&s->seed) % s->nattrs];
+    // one write for every three reads
+    if (a->writable && rand_r(&s->seed) % 4 == 0) {
+      stress_value(a, &s->seed, buf, sizeof(buf));
+      if (sim_attr_write(a->name, buf) < 0)
+        s->errors++;
+      s->writes++;
+      continue;
+    }
+    start = now_ns();
+    ret = sim_attr_read(a->name, buf, sizeof(buf));
+    if (s->nlat < s->maxlat)
+      s->lat[s->nlat++] = now_ns() - start;
+    s->reads++;
+    if (ret < 0) {
+      s->errors++;
+      continue;
+    }
+    value = strtol(buf, &end, 10);
+    if (end == buf || value < a->lo || value > a->hi ||
+        (strstr(a->name, "_enable") && value == 2)) {
+      fprintf(stderr, "stress: %s read '%.*s'\n", a->name,
+              (int)strcspn(buf, "\n"), buf);
+      s->inconsistent++;
+    }
+  }
+  return NULL;
+}
+
+// once everything settled, the driver and the ec have to agree on each fan
+static long stress_check_ec(void) {
+  char name[32], buf[64];
+  long bad = 0;
+  double manual, pwm;
+  int fan, enable, i;
+
+  // leaving curve mode keeps the speed the controller has set last
+  for (fan = 1; fan <= 2; fan++) {
+    snprintf(name, sizeof(name), "pwm%d_enable", fan);
+    if (sim_attr_read(name, buf, sizeof(buf)) > 0 && atoi(buf) == 3)
+      sim_attr_write(name, "1");
+  }
+  // let coalesced writes reach the ec
+  for (i = 0; i < 3; i++) {
+    sim_wq_idle();
+    msleep(1000);
+  }
+  sim_wq_idle();
+
+  for (fan = 1; fan <= 2; fan++) {
+    snprintf(name, sizeof(name), "pwm%d_enable", fan);
+    if (sim_attr_read(name, buf, sizeof(buf)) < 0)
+      continue;
+    enable = atoi(buf);
+    snprintf(name, sizeof(name), "manual%d", fan);
+    sim_ec_get(name, &manual);
+    snprintf(name, sizeof(name), "pwm%d", fan);
+    sim_ec_get(name, &pwm);
+    sim_attr_read(name, buf, sizeof(buf));
+    if (enable != (int)manual || (enable == 1 && atoi(buf) != (int)pwm)) {
+      fprintf(stderr,
+              "stress: fan%d driver enable %d pwm %d, ec manual %d pwm %d\n",
+              fan, enable, atoi(buf), (int)manual, (int)pwm);
+      bad++;
+    }
+  }
+  return bad;
+}
+
+static void stress(long ms, int threads) {
+  const struct stress_attr **attrs = calloc(ARRAY_SIZE(stress_attrs),
+                                            sizeof(*attrs));
+  struct stress *s = calloc(threads, sizeof(*s));
+  pthread_t *tid = calloc(threads, sizeof(*tid));
+  long reads = 0, writes = 0, errors = 0, inconsistent = 0, n = 0;
+  char buf[64];
+  u64 *all, start, elapsed;
+  int nattrs = 0, t;
+  size_t i;
+
+  // only what this machine exposes
+  for (i = 0; i < ARRAY_SIZE(stress_attrs); i++)
+    if (sim_attr_read(stress_attrs[i].name, buf, sizeof(buf)) >= 0)
+      attrs[nattrs++] = &stress_attrs[i];
+
+  start = now_ns();
+  for (t = 0; t < threads; t++) {
+    s[t].attrs = attrs;
+    s[t].nattrs = nattrs;
+    s[t].deadline = start + ms * 1000000ULL;
+    s[t].seed = t + 1;
+    s[t].maxlat = 1000000;
+    s[t].lat = calloc(s[t].maxlat, sizeof(u64));
+    pthread_create(&tid[t], NULL, stress_thread, &s[t]);
+  }
+  for (t = 0; t < threads; t++)
+    pthread_join(tid[t], NULL);
+  elapsed = now_ns() - start;
+
+  all = calloc((size_t)threads * s[0].maxlat, sizeof(u64));
+  for (t = 0; t < threads; t++) {
+    memcpy(all + n, s[t].lat, s[t].nlat * sizeof(u64));
+    n += s[t].nlat;
+    reads += s[t].reads;
+    writes += s[t].writes;
+    errors += s[t].errors;
+    inconsistent += s[t].inconsistent;
+    free(s[t].lat);
+  }
+  qsort(all, n, sizeof(u64), cmp_u64);
+  inconsistent += stress_check_ec();
+
+  printf("stress: %ld reads, %ld writes, %d threads, %.0f ops/s, "
+         "read p50 %.1fus p99 %.1fus, %ld errors, %ld inconsistent\n",
+         reads, writes, threads, (reads + writes) / (elapsed / 1e9),
+         n ? all[n / 2] / 1e3 : 0, n ? all[(long)(n * 0.99)] / 1e3 : 0,
+         errors, inconsistent);
+  if (errors)
+    fail("stress: %ld errors", errors);
+  if (inconsistent)
+    fail("stress: %ld inconsistent states", inconsistent);
+  free(all);
+  free(tid);
+  free(s);
+  free(attrs);
+}
+
+//////
+////// COMMANDS
+//////
+
+static int parse_calib_points(int argc, char **argv, u8 *blob, size_t size) {
+  struct {
+    __le32 magic;
+    u8 version;
+    u8 count;
+    __le16 reserved;
+  } __packed *hdr = (void *)blob;
+  __le16 *points = (__le16 *)(blob + sizeof(*hdr));
+  unsigned int pwm, rpm;
+  int i;
+
+  if (sizeof(*hdr) + (size_t)argc * 4 > size)
+    return -1;
+  hdr->magic = 0x54434641;  // "AFCT"
+  hdr->version = 1;
+  hdr->count = argc;
+  hdr->reserved = 0;
+  for (i = 0; i < argc; i++) {
+    if (sscanf(argv[i], "%u:%u", &pwm, &rpm) != 2)
+      return -1;
+    points[2 * i] = pwm;
+    points[2 * i + 1] = rpm;
+  }
+  return sizeof(*hdr) + argc * 4;
+}
+
+static void calib_print(const char *attr) {
+  u8 blob[4096];
+  ssize_t len = sim_bin_read(attr, blob, sizeof(blob));
+  __le16 *points = (__le16 *)(blob + 8);
+  int i;
+
+  if (len < 8) {
+    fail("calib_read %s: %zd", attr, len);
+    return;
+  }
+  printf("%s:", attr);
+  for (i = 0; i < blob[5] && 8 + 4 * i < len; i++)
+    printf(" %u:%u", points[2 * i], points[2 * i + 1]);
+  printf("\n");
+}
+
+static int dmi_field(const char *name) {
+  if (!strcmp(name, "vendor"))
+    return DMI_SYS_VENDOR;
+  if (!strcmp(name, "product"))
+    return DMI_PRODUCT_NAME;
+  if (!strcmp(name, "board"))
+    return DMI_BOARD_NAME;
+  if (!strcmp(name, "board_vendor"))
+    return DMI_BOARD_VENDOR;
+  return DMI_NONE;
+}
+
+// collapse every run of blanks into a single space (tables in debugfs)
+static void squeeze(char *s) {
+  char *start = s, *out = s;
+
+  for (; *s; s++) {
+    if (*s != ' ' && *s != '\t')
+      *out++ = *s;
+    else if (out == start || out[-1] != ' ')
+      *out++ = ' ';
+  }
+  *out = '\0';
+}
+
+// join argv[from..] with single spaces
+static void join(char *out, size_t size, int argc, char **argv, int from) {
+  int i;
+
+  out[0] = '\0';
+  for (i = from; i < argc; i++) {
+    if (i > from)
+      strncat(out, " ", size - strlen(out) - 1);
+    strncat(out, argv[i], size - strlen(out) - 1);
+  }
+}
+
+// value of the "<key> <value>" line of a debugfs file
+static bool debugfs_value(const char *buf, const char *key, double *val) {
+  size_t len = strlen(key);
+  const char *line;
+
+  for (line = buf; line && *line; line = strchr(line, '\n'), line += !!line)
+    if (!strncmp(line, key, len) && isblank(line[len]))
+      return sscanf(line + len, "%lf", val) == 1;
+  return false;
+}
+
+// 'dev' commands, 0 or -errno
+static long dev_command(int argc, char **argv) {
+  struct asus_fan_pwm req;
+
+  if (argc >= 1 && argc <= 2 && !strcmp(argv[0], "open"))
+    return sim_dev_open(argc == 2 && !strcmp(argv[1], "rw"));
+  if (argc >= 1 && argc <= 2 && !strcmp(argv[0], "mmap"))
+    return sim_dev_mmap(0, PAGE_SIZE, argc == 2 && !strcmp(argv[1], "rw"),
+                        NULL);
+  if (argc == 4 && !strcmp(argv[0], "set_pwm")) {
+    req.fans = strtoul(argv[1], NULL, 0);
+    req.pwm[0] = strtoul(argv[2], NULL, 0);
+    req.pwm[1] = strtoul(argv[3], NULL, 0);
+    return sim_dev_ioctl(ASUS_FAN_IOC_SET_PWM, &req);
+  }
+  if (argc == 1 && !strcmp(argv[0], "close")) {
+    sim_dev_close();
+    return 0;
+  }
+  return -EINVAL;
+}
+
+static bool dev_field(const struct asus_fan_status *st, const char *name,
+                      double *val) {
+  if (!strcmp(name, "fans"))
+    *val = st->fans;
+  else if (!strcmp(name, "rpm1") || !strcmp(name, "rpm2"))
+    *val = st->rpm[name[3] - '1'];
+  else if (!strcmp(name, "pwm1") || !strcmp(name, "pwm2"))
+    *val = st->pwm[name[3] - '1'];
+  else if (!strcmp(name, "mode1") || !strcmp(name, "mode2"))
+    *val = st->mode[name[4] - '1'];
+  else if (!strcmp(name, "temp"))
+    *val = st->temp;
+  else if (!strcmp(name, "alarms"))
+    *val = st->alarms;
+  else if (!strcmp(name, "max_speed"))
+    *val = st->max_speed;
+  else
+    return false;
+  return true;
+}
+
+// the mapped page read like userspace would, 0 or -errno
+static int page_read(struct asus_fan_status *st) {
+  const struct asus_fan_status_page *page = sim_dev_page();
+  unsigned int seq;
+
+  if (!page)
+    return -EFAULT;
+  do {
+    while ((seq = READ_ONCE(page->seq)) & 1)
+      ;
+    smp_rmb();
+    *st = page->status;
+    smp_rmb();
+  } while (READ_ONCE(page->seq) != seq);
+  return 0;
+}
+
+static void run_command(int argc, char **argv) {
+  char buf[65536], value[1024];
+  double dval;
+  ssize_t ret;
+
+  if (!strcmp(argv[0], "ec") && argc == 2 && !strcmp(argv[1], "dump")) {
+    sim_ec_dump();
+  } else if (!strcmp(argv[0], "ec") && argc == 3) {
+    if (sim_ec_set(argv[1], atof(argv[2])))
+      fail("unknown ec key '%s'", argv[1]);
+  } else if (!strcmp(argv[0], "param") && argc == 3) {
+    if (sim_param_set(argv[1], argv[2]))
+      fail("cannot set parameter %s=%s", argv[1], argv[2]);
+  } else if (!strcmp(argv[0], "dmi") && argc >= 3) {
+    join(value, sizeof(value), argc, argv, 2);
+    if (dmi_field(argv[1]) == DMI_NONE)
+      fail("unknown dmi field '%s'", argv[1]);
+    else
+      sim_dmi_set(dmi_field(argv[1]), value);
+  } else if (!strcmp(argv[0], "time_scale") && argc == 2) {
+    sim_set_time_scale(atof(argv[1]));
+  } else if (!strcmp(argv[0], "load") && argc == 1) {
+    ret = sim_load();
+    if (ret)
+      fail("load: %zd", ret);
+    sim_probe_settle();
+  } else if (!strcmp(argv[0], "load") && argc == 2 &&
+             !strcmp(argv[1], "nowait")) {
+    ret = sim_load();
+    if (ret)
+      fail("load: %zd", ret);
+  } else if (!strcmp(argv[0], "settle") && argc == 1) {
+    sim_probe_settle();
+  } else if (!strcmp(argv[0], "suspend") && argc == 1) {
+    ret = sim_pm_suspend();
+    if (ret)
+      fail("suspend: %zd", ret);
+  } else if (!strcmp(argv[0], "resume") && argc == 1) {
+    ret = sim_pm_resume();
+    if (ret)
+      fail("resume: %zd", ret);
+  } else if (!strcmp(argv[0], "unload") && argc == 1) {
+    sim_unload();
+  } else if (!strcmp(argv[0], "list") && argc == 1) {
+    sim_attr_list();
+  } else if (!strcmp(argv[0], "idle") && argc == 1) {
+    sim_wq_idle();
+  } else if (!strcmp(argv[0], "read") && argc == 2) {
+    ret = sim_attr_read(argv[1], buf, sizeof(buf));
+    if (ret < 0)
+      fail("read %s: %s", argv[1], strerror(-ret));
+    else
+      printf("%s: %s", argv[1], buf);
+  } else if (!strcmp(argv[0], "write") && argc >= 3) {
+    join(value, sizeof(value), argc, argv, 2);
+    ret = sim_attr_write(argv[1], value);
+    if (ret < 0)
+      fail("write %s %s: %s", argv[1], value, strerror(-ret));
+  } else if (!strcmp(argv[0], "expect") && argc >= 3) {
+    join(value, sizeof(value), argc, argv, 2);
+    ret = sim_attr_read(argv[1], buf, sizeof(buf));
+    strip_newline(buf);
+    if (ret < 0)
+      fail("read %s: %s", argv[1], strerror(-ret));
+    else if (strcmp(buf, value))
+      fail("%s is '%s', expected '%s'", argv[1], buf, value);
+  } else if (!strcmp(argv[0], "expect_range") && argc == 4) {
+    ret = sim_attr_read(argv[1], buf, sizeof(buf));
+    if (ret < 0) {
+      fail("read %s: %s", argv[1], strerror(-ret));
+    } else {
+      dval = atof(buf);
+      if (dval < atof(argv[2]) || dval > atof(argv[3]))
+        fail("%s is %g, expected %s..%s", argv[1], dval, argv[2], argv[3]);
+    }
+  } else if (!strcmp(argv[0], "expect_missing") && argc == 2) {
+    ret = sim_attr_read(argv[1], buf, sizeof(buf));
+    if (ret != -ENOENT)
+      fail("%s exists", argv[1]);
+  } else if (!strcmp(argv[0], "expect_error") && argc >= 4 &&
+             !strcmp(argv[1], "write")) {
+    join(value, sizeof(value), argc, argv, 3);
+    ret = sim_attr_write(argv[2], value);
+    if (ret >= 0)
+      fail("write %s %s succeeded", argv[2], value);
+  } else if (!strcmp(argv[0], "expect_error") && argc == 4 &&
+             !strcmp(argv[1], "debugfs") && !strcmp(argv[2], "read")) {
+    if (sim_debugfs_read(argv[3], buf, sizeof(buf)) >= 0)
+      fail("debugfs read %s succeeded", argv[3]);
+  } else if (!strcmp(argv[0], "expect_error") && argc >= 5 &&
+             !strcmp(argv[1], "debugfs") && !strcmp(argv[2], "write")) {
+    join(value, sizeof(value), argc, argv, 4);
+    strncat(value, "\n", sizeof(value) - strlen(value) - 1);
+    if (sim_debugfs_write(argv[3], value, strlen(value)) >= 0)
+      fail("debugfs write %s %s succeeded", argv[3], value);
+  } else if (!strcmp(argv[0], "expect_error") && argc == 3 &&
+             !strcmp(argv[1], "thermal")) {
+    long lval;
+
+    if (sim_thermal_get(argv[2], &lval) >= 0)
+      fail("thermal %s exists", argv[2]);
+  } else if (!strcmp(argv[0], "expect_error") && argc == 2 &&
+             !strcmp(argv[1], "load")) {
+    if (!sim_load()) {
+      fail("load succeeded");
+      sim_unload();
+    }
+  } else if (!strcmp(argv[0], "expect_error") && argc == 3 &&
+             !strcmp(argv[1], "profile")) {
+    if (!sim_profile_set(argv[2]))
+      fail("profile %s succeeded", argv[2]);
+  } else if (!strcmp(argv[0], "expect_ec") && argc == 4) {
+    if (sim_ec_get(argv[1], &dval))
+      fail("unknown ec key '%s'", argv[1]);
+    else if (dval < atof(argv[2]) || dval > atof(argv[3]))
+      fail("ec %s is %g, expected %s..%s", argv[1], dval, argv[2], argv[3]);
+  } else if (!strcmp(argv[0], "expect_param") && argc == 3) {
+    if (sim_param_get(argv[1], buf, sizeof(buf)) < 0)
+      fail("unknown parameter '%s'", argv[1]);
+    else if (strcmp(buf, argv[2]))
+      fail("parameter %s is '%s', expected '%s'", argv[1], buf, argv[2]);
+  } else if (!strcmp(argv[0], "expect_notified") && argc == 3) {
+    if (sim_attr_notified(argv[1]) < strtoul(argv[2], NULL, 0))
+      fail("%s notified %lu times, expected >= %s", argv[1],
+           sim_attr_notified(argv[1]), argv[2]);
+  } else if (!strcmp(argv[0], "expect_traced") && argc == 3) {
+    if (sim_traced(argv[1]) < strtoul(argv[2], NULL, 0))
+      fail("%s traced %lu times, expected >= %s", argv[1],
+           sim_traced(argv[1]), argv[2]);
+  } else if (!strcmp(argv[0], "thermal") && argc == 4 &&
+             !strcmp(argv[1], "set")) {
+    ret = sim_cdev_set(argv[2], strtoul(argv[3], NULL, 0));
+    if (ret < 0)
+      fail("thermal set %s: %s", argv[2], strerror(-ret));
+  } else if (!strcmp(argv[0], "thermal") && argc == 3 &&
+             !strcmp(argv[1], "update")) {
+    ret = sim_thermal_update(argv[2]);
+    if (ret < 0)
+      fail("thermal update %s: %s", argv[2], strerror(-ret));
+  } else if (!strcmp(argv[0], "expect_thermal") && argc == 4) {
+    long lval;
+
+    ret = sim_thermal_get(argv[1], &lval);
+    if (ret < 0)
+      fail("thermal %s: %s", argv[1], strerror(-ret));
+    else if (lval < atol(argv[2]) || lval > atol(argv[3]))
+      fail("thermal %s is %ld, expected %s..%s", argv[1], lval, argv[2],
+           argv[3]);
+  } else if (!strcmp(argv[0], "profile") && argc == 2) {
+    ret = sim_profile_set(argv[1]);
+    if (ret < 0)
+      fail("profile %s: %s", argv[1], strerror(-ret));
+  } else if (!strcmp(argv[0], "expect_profile") && argc == 2) {
+    if (sim_profile_get(buf, sizeof(buf)) < 0)
+      snprintf(buf, sizeof(buf), "none");
+    if (strcmp(buf, argv[1]))
+      fail("profile is '%s', expected '%s'", buf, argv[1]);
+  } else if (!strcmp(argv[0], "profile_busy") && argc == 2) {
+    sim_profile_set_busy(atoi(argv[1]));
+  } else if (!strcmp(argv[0], "dev") && argc >= 2) {
+    ret = dev_command(argc - 1, argv + 1);
+    if (ret < 0)
+      fail("dev %s: %s", argv[1], strerror(-ret));
+  } else if (!strcmp(argv[0], "expect_error") && argc >= 3 &&
+             !strcmp(argv[1], "dev")) {
+    if (dev_command(argc - 2, argv + 2) >= 0)
+      fail("dev %s succeeded", argv[2]);
+  } else if ((!strcmp(argv[0], "expect_dev") ||
+              !strcmp(argv[0], "expect_page")) && argc == 4) {
+    struct asus_fan_status st;
+
+    if (!strcmp(argv[0], "expect_dev"))
+      ret = sim_dev_ioctl(ASUS_FAN_IOC_STATUS, &st);
+    else
+      ret = page_read(&st);
+    if (ret < 0)
+      fail("%s: %s", argv[0], strerror(-ret));
+    else if (!dev_field(&st, argv[1], &dval))
+      fail("%s: unknown field '%s'", argv[0], argv[1]);
+    else if (dval < atof(argv[2]) || dval > atof(argv[3]))
+      fail("%s %s is %g, expected %s..%s", argv[0], argv[1], dval, argv[2],
+           argv[3]);
+  } else if (!strcmp(argv[0], "sleep") && argc == 2) {
+    msleep(atoi(argv[1]));
+  } else if (!strcmp(argv[0], "debugfs") && argc == 3 &&
+             !strcmp(argv[1], "read")) {
+    ret = sim_debugfs_read(argv[2], buf, sizeof(buf));
+    if (ret < 0)
+      fail("debugfs read %s: %s", argv[2], strerror(-ret));
+    else
+      printf("%s", buf);
+  } else if (!strcmp(argv[0], "debugfs") && argc >= 4 &&
+             !strcmp(argv[1], "write")) {
+    join(value, sizeof(value), argc, argv, 3);
+    strncat(value, "\n", sizeof(value) - strlen(value) - 1);
+    ret = sim_debugfs_write(argv[2], value, strlen(value));
+    if (ret < 0)
+      fail("debugfs write %s: %s", argv[2], strerror(-ret));
+  } else if (!strcmp(argv[0], "debugfs") && argc == 3 &&
+             !strcmp(argv[1], "open")) {
+    ret = sim_debugfs_open(argv[2]);
+    if (ret < 0)
+      fail("debugfs open %s: %s", argv[2], strerror(-ret));
+  } else if (!strcmp(argv[0], "debugfs") && argc == 2 &&
+             !strcmp(argv[1], "close")) {
+    sim_debugfs_close();
+  } else if (!strcmp(argv[0], "debugfs") && argc == 4 &&
+             !strcmp(argv[1], "save")) {
+    FILE *f = fopen(argv[3], "wb");
+
+    ret = f ? sim_debugfs_open(argv[2]) : -errno;
+    while (ret >= 0 && (ret = sim_debugfs_read_held(buf, sizeof(buf))) > 0)
+      if (fwrite(buf, ret, 1, f) != 1)
+        ret = -EIO;
+    sim_debugfs_close();
+    if (f)
+      fclose(f);
+    if (ret < 0)
+      fail("debugfs save %s: %s", argv[2], strerror(-ret));
+  } else if (!strcmp(argv[0], "replay") && argc >= 3 && argc <= 4) {
+    struct sim_replay_metrics recorded;
+
+    ret = sim_replay(argv[1], atof(argv[2]), &recorded, &replayed);
+    if (ret < 0) {
+      fail("replay %s: %s", argv[1], strerror(-ret));
+    } else {
+      sim_replay_print("recorded", &recorded);
+      sim_replay_print(argc == 4 ? argv[3] : "replayed", &replayed);
+    }
+  } else if (!strcmp(argv[0], "expect_replay") && argc == 4) {
+    if (sim_replay_metric(&replayed, argv[1], &dval))
+      fail("unknown replay metric '%s'", argv[1]);
+    else if (dval < atof(argv[2]) || dval > atof(argv[3]))
+      fail("replay %s is %g, expected %s..%s", argv[1], dval, argv[2],
+           argv[3]);
+  } else if (!strcmp(argv[0], "expect_stream") && argc == 4) {
+    ret = sim_debugfs_read_held(
+        buf, min_t(size_t, strtoul(argv[1], NULL, 0), sizeof(buf)));
+    if (ret < atol(argv[2]) || ret > atol(argv[3]))
+      fail("debugfs stream read %d bytes, expected %s..%s", (int)ret,
+           argv[2], argv[3]);
+  } else if (!strcmp(argv[0], "expect_debugfs_range") && argc == 5) {
+    ret = sim_debugfs_read(argv[1], buf, sizeof(buf));
+    if (ret < 0) {
+      fail("debugfs read %s: %s", argv[1], strerror(-ret));
+    } else if (!debugfs_value(buf, argv[2], &dval)) {
+      fail("debugfs %s has no '%s':\n%s", argv[1], argv[2], buf);
+    } else if (dval < atof(argv[3]) || dval > atof(argv[4])) {
+      fail("debugfs %s %s is %g, expected %s..%s", argv[1], argv[2], dval,
+           argv[3], argv[4]);
+    }
+  } else if (!strcmp(argv[0], "expect_debugfs") && argc >= 3) {
+    join(value, sizeof(value), argc, argv, 2);
+    ret = sim_debugfs_read(argv[1], buf, sizeof(buf));
+    if (ret < 0)
+      fail("debugfs read %s: %s", argv[1], strerror(-ret));
+    else if (squeeze(buf), !strstr(buf, value))
+      fail("debugfs %s does not contain '%s':\n%s", argv[1], value, buf);
+  } else if (!strcmp(argv[0], "calib_write") && argc >= 3) {
+    ret = parse_calib_points(argc - 2, argv + 2, (u8 *)buf, sizeof(buf));
+    if (ret < 0)
+      fail("calib_write: bad points");
+    else if ((ret = sim_bin_write(argv[1], buf, ret)) < 0)
+      fail("calib_write %s: %s", argv[1], strerror(-ret));
+  } else if (!strcmp(argv[0], "expect_error") && argc >= 4 &&
+             !strcmp(argv[1], "calib_write")) {
+    ret = parse_calib_points(argc - 3, argv + 3, (u8 *)buf, sizeof(buf));
+    if (ret >= 0 && sim_bin_write(argv[2], buf, ret) >= 0)
+      fail("calib_write %s succeeded", argv[2]);
+  } else if (!strcmp(argv[0], "calib_read") && argc == 2) {
+    calib_print(argv[1]);
+  } else if (!strcmp(argv[0], "bench") && argc >= 4 &&
+             (!strcmp(argv[1], "read") || !strcmp(argv[1], "write"))) {
+    bench(!strcmp(argv[1], "write"), argv[2], atol(argv[3]),
+          argc > 4 ? atoi(argv[4]) : 1, argc > 5 ? argv[5] : "0");
+  } else if (!strcmp(argv[0], "stress") && argc == 3) {
+    stress(atol(argv[1]), atoi(argv[2]));
+  } else {
+    fail("unknown command '%s' (%d arguments)", argv[0], argc - 1);
+  }
+}
+
+static void run_script(FILE *f) {
+  char line[4096], *argv[MAX_ARGS], *tok, *save;
+  int argc;
+
+  script_line = 0;
+  while (fgets(line, sizeof(line), f)) {
+    script_line++;
+    if ((tok = strchr(line, '#')))
+      *tok = '\0';
+    argc = 0;
+    for (tok = strtok_r(line, " \t\n", &save); tok && argc < MAX_ARGS;
+         tok = strtok_r(NULL, " \t\n", &save))
+      argv[argc++] = tok;
+    if (argc)
+      run_command(argc, argv);
+  }
+}
+
+int main(int argc, char **argv) {
+  char path[4096], *slash;
+  FILE *f;
+  int i = 1;
+
+  sim_quiet = 1;
+  if (argc > 1 && !strcmp(argv[1], "-v")) {
+    sim_quiet = 0;
+    i++;
+  }
+  // the module is built next to the simulator
+  snprintf(path, sizeof(path), "%s", argv[0]);
+  slash = strrchr(path, '/');
+  slash = slash ? slash + 1 : path;
+  snprintf(slash, sizeof(path) - (slash - path), "asus_fan.so");
+  sim_set_module(path);
+  sim_ec_reset();
+
+  if (i == argc) {
+    run_script(stdin);
+  }
+  for (; i < argc; i++) {
+    f = fopen(argv[i], "r");
+    if (!f) {
+      perror(argv[i]);
+      return 1;
+    }
+    script_name = argv[i];
+    run_script(f);
+    fclose(f);
+  }
+  if (failures)
+    fprintf(stderr, "%d expectation(s) failed\n", failures);
+  return failures > 125 ? 125 : failures;
+}
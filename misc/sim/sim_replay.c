@@ -0,0 +1,269 @@
+/**
+ *  asus-fan userspace simulation - replay of recorded ec calls
+ *
+ *  The heat load of each window of the recording follows from the thermal
+ *  model of sim_ec.c solved for it:
+ *
+ *    load = capacity * dT/dt + (k_passive + k_fan * rpm / 1000) * (T - ambient)
+ *
+ *  with T from TH1R and rpm from TACH / the tach registers, or - while a
+ *  fan is in manual mode and TACH is silent - from the pwm set by SFNV.
+ *  The model parameters ('ec capacity', 'ec ambient', ...) are the ones set
+ *  when the replay starts, so a script can fit them to the machine first.
+ *
+**/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/sim_kernel.h"
+#include "sim_ec.h"
+#include "sim_replay.h"
+#include "../../asus_fan_uapi.h"
+
+// TH1R only has whole degrees, windows shorter than this are mostly noise
+#define WINDOW_NS 2000000000ULL
+// sampling period of the replayed run
+#define TICK_MS 100
+
+// one temperature readout of the recording, with the speeds at that time
+struct point {
+  u64 time_ns;
+  double temp;
+  double rpm[2];
+};
+
+// time weighted sums of one run
+struct acc {
+  double time, temp, peak, above;
+  double rpm[2], rpm_sq[2];
+  int fans;
+};
+
+static void acc_add(struct acc *a, double dt, double temp, const double *rpm,
+                    double threshold) {
+  int fan;
+
+  if (!a->time || temp > a->peak)
+    a->peak = temp;
+  a->time += dt;
+  a->temp += temp * dt;
+  if (temp > threshold)
+    a->above += dt;
+  for (fan = 0; fan < a->fans; fan++) {
+    a->rpm[fan] += rpm[fan] * dt;
+    a->rpm_sq[fan] += rpm[fan] * rpm[fan] * dt;
+  }
+}
+
+static void acc_done(const struct acc *a, unsigned long writes,
+                     struct sim_replay_metrics *m) {
+  double mean;
+  int fan;
+
+  memset(m, 0, sizeof(*m));
+  m->ec_writes = writes;
+  if (!a->time)
+    return;
+  m->duration_s = a->time;
+  m->peak_temp = a->peak;
+  m->mean_temp = a->temp / a->time;
+  m->above_s = a->above;
+  for (fan = 0; fan < a->fans; fan++) {
+    mean = a->rpm[fan] / a->time;
+    m->rpm_mean += mean / a->fans;
+    m->rpm_var += (a->rpm_sq[fan] / a->time - mean * mean) / a->fans;
+  }
+}
+
+static double ec_value(const char *key) {
+  double value = 0;
+
+  sim_ec_get(key, &value);
+  return value;
+}
+
+static unsigned long ec_writes(void) {
+  return sim_ec_calls(SIM_SFNV) + sim_ec_calls(SIM_ST98) +
+         sim_ec_calls(SIM_QMOD);
+}
+
+// all records of 'path', malloc()ed, count or -errno
+static long trace_load(const char *path, struct asus_fan_acpi_rec **recs) {
+  FILE *f = fopen(path, "rb");
+  long size;
+
+  if (!f)
+    return -errno;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  if (size <= 0 || size % sizeof(**recs)) {
+    fclose(f);
+    return -EINVAL;
+  }
+  *recs = malloc(size);
+  if (!*recs || fread(*recs, size, 1, f) != 1) {
+    free(*recs);
+    fclose(f);
+    return -EIO;
+  }
+  fclose(f);
+  return size / sizeof(**recs);
+}
+
+// the temperature readouts with the fan speeds of the moment, count
+static long trace_points(const struct asus_fan_acpi_rec *recs, long n,
+                         struct point *points, int *fans) {
+  bool manual[2] = {false, false}, observed[2] = {false, false};
+  double rpm[2] = {0, 0};
+  int pwm[2] = {0, 0};
+  long i, count = 0;
+  int fan;
+
+  *fans = 1;
+  for (i = 0; i < n; i++) {
+    const struct asus_fan_acpi_rec *r = &recs[i];
+
+    if (r->status)
+      continue;
+    switch (r->method) {
+      case ASUS_FAN_REC_SFNV:
+        if (!r->arg[0]) {
+          manual[0] = manual[1] = false;
+          break;
+        }
+        fan = r->arg[0] - 1;
+        if (fan > 1)
+          break;
+        manual[fan] = true;
+        observed[fan] = false;
+        pwm[fan] = r->arg[1];
+        *fans = max(*fans, fan + 1);
+        break;
+      case ASUS_FAN_REC_TACH:
+      case ASUS_FAN_REC_EC:
+        fan = r->method == ASUS_FAN_REC_EC ? r->arg[1] : r->arg[0];
+        if (fan > 1)
+          break;
+        // TACH reads 0 in manual mode, the registers always work
+        if (manual[fan] && !r->result && r->method == ASUS_FAN_REC_TACH)
+          break;
+        rpm[fan] = r->result;
+        observed[fan] = true;
+        *fans = max(*fans, fan + 1);
+        break;
+      case ASUS_FAN_REC_TH1R:
+        points[count].time_ns = r->time_ns;
+        // truncated by the firmware
+        points[count].temp = r->result + 0.5;
+        for (fan = 0; fan < 2; fan++)
+          points[count].rpm[fan] = manual[fan] && !observed[fan]
+                                       ? sim_ec_fan_rpm(fan, pwm[fan])
+                                       : rpm[fan];
+        count++;
+        break;
+    }
+  }
+  return count;
+}
+
+int sim_replay(const char *path, double threshold,
+               struct sim_replay_metrics *recorded,
+               struct sim_replay_metrics *replayed) {
+  double capacity = ec_value("capacity"), ambient = ec_value("ambient");
+  double k_passive = ec_value("k_passive"), k_fan = ec_value("k_fan");
+  struct asus_fan_acpi_rec *recs = NULL;
+  struct acc rec_acc = {}, run_acc = {};
+  unsigned long writes = 0, writes_start;
+  double dt, load, rpm, temp, speeds[2], carry = 0;
+  struct point *points;
+  long n, count, i, j;
+  int fans;
+
+  n = trace_load(path, &recs);
+  if (n < 0)
+    return n;
+  points = calloc(n, sizeof(*points));
+  if (!points) {
+    free(recs);
+    return -ENOMEM;
+  }
+  count = trace_points(recs, n, points, &fans);
+  for (i = 0; i < n; i++)
+    if (!recs[i].status && (recs[i].method == ASUS_FAN_REC_SFNV ||
+                            recs[i].method == ASUS_FAN_REC_ST98 ||
+                            recs[i].method == ASUS_FAN_REC_QMOD))
+      writes++;
+  free(recs);
+  if (count < 2) {
+    free(points);
+    return -ENODATA;
+  }
+
+  // what the machine did back then
+  rec_acc.fans = fans;
+  for (i = 0; i + 1 < count; i++)
+    acc_add(&rec_acc, (points[i + 1].time_ns - points[i].time_ns) / 1e9,
+            points[i].temp, points[i].rpm, threshold);
+  acc_done(&rec_acc, writes, recorded);
+
+  // and the module now, window by window
+  run_acc.fans = (int)ec_value("fans");
+  writes_start = ec_writes();
+  sim_ec_set("temp", points[0].temp);
+  for (i = 0; i + 1 < count; i = j) {
+    for (j = i + 1; j + 1 < count; j++)
+      if (points[j].time_ns - points[i].time_ns >= WINDOW_NS)
+        break;
+    dt = (points[j].time_ns - points[i].time_ns) / 1e9;
+    if (dt <= 0)
+      continue;
+    rpm = (points[i].rpm[0] + points[i].rpm[1] + points[j].rpm[0] +
+           points[j].rpm[1]) / 2;
+    load = capacity * (points[j].temp - points[i].temp) / dt +
+           (k_passive + k_fan * rpm / 1000) *
+               ((points[i].temp + points[j].temp) / 2 - ambient);
+    sim_ec_set("load", load > 0 ? load : 0);
+
+    for (carry += dt; carry >= TICK_MS / 1000.0; carry -= TICK_MS / 1000.0) {
+      msleep(TICK_MS);
+      temp = ec_value("temp");
+      speeds[0] = ec_value("rpm1");
+      speeds[1] = ec_value("rpm2");
+      acc_add(&run_acc, TICK_MS / 1000.0, temp, speeds, threshold);
+    }
+  }
+  acc_done(&run_acc, ec_writes() - writes_start, replayed);
+  free(points);
+  return 0;
+}
+
+void sim_replay_print(const char *label, const struct sim_replay_metrics *m) {
+  printf("%s: duration_s %.1f peak_temp %.1f mean_temp %.1f above_s %.1f "
+         "ec_writes %lu rpm_mean %.0f rpm_var %.0f\n",
+         label, m->duration_s, m->peak_temp, m->mean_temp, m->above_s,
+         m->ec_writes, m->rpm_mean, m->rpm_var);
+}
+
+int sim_replay_metric(const struct sim_replay_metrics *m, const char *key,
+                      double *value) {
+  if (!strcmp(key, "duration_s"))
+    *value = m->duration_s;
+  else if (!strcmp(key, "peak_temp"))
+    *value = m->peak_temp;
+  else if (!strcmp(key, "mean_temp"))
+    *value = m->mean_temp;
+  else if (!strcmp(key, "above_s"))
+    *value = m->above_s;
+  else if (!strcmp(key, "ec_writes"))
+    *value = m->ec_writes;
+  else if (!strcmp(key, "rpm_mean"))
+    *value = m->rpm_mean;
+  else if (!strcmp(key, "rpm_var"))
+    *value = m->rpm_var;
+  else
+    return -1;
+  return 0;
+}
@@ -0,0 +1,36 @@
+/**
+ *  asus-fan userspace simulation - replay of recorded ec calls
+ *
+ *  A recording of debugfs 'record' (made on the real machine) is turned
+ *  into the heat load the machine saw: from the recorded temperatures and
+ *  fan speeds, through the thermal model of the simulated EC. That load is
+ *  then played against the loaded module - with whatever strategy the
+ *  script configured - and the outcome measured.
+ *
+**/
+#ifndef SIM_REPLAY_H
+#define SIM_REPLAY_H
+
+struct sim_replay_metrics {
+  double duration_s;
+  double peak_temp;     // degree celsius
+  double mean_temp;
+  double above_s;       // time above the threshold
+  unsigned long ec_writes;  // SFNV, ST98 and QMOD calls
+  double rpm_mean;      // over all samples and fans
+  double rpm_var;       // variance of the speed of each fan, averaged
+};
+
+// replay 'path', 'recorded' gets the values the trace itself shows,
+// 'replayed' those of the module now, 0 or -errno
+int sim_replay(const char *path, double threshold,
+               struct sim_replay_metrics *recorded,
+               struct sim_replay_metrics *replayed);
+
+// one line of "key value" pairs
+void sim_replay_print(const char *label, const struct sim_replay_metrics *m);
+// a metric by its key, -1 if unknown
+int sim_replay_metric(const struct sim_replay_metrics *m, const char *key,
+                      double *value);
+
+#endif